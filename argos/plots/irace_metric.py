@@ -1,3 +1,4 @@
+import sys
 import pandas as pd
 import igraph as ig
 import numpy as np
@@ -12,7 +13,9 @@ def distance_between(pos1, pos2):
 boxplot_df = pd.DataFrame()
 
 
-data = pd.read_csv ("results/social_behavior/temp/seed#1" + "_kiloLOG.tsv", sep = '\t')
+# irace_launch.sh gives the log of its own run
+log_file = sys.argv[1] if len(sys.argv) > 1 else "results/social_behavior/temp/seed#1_kiloLOG.tsv"
+data = pd.read_csv (log_file, sep = '\t')
 columnsToDrop = []
 for i in range(25):
     columnsToDrop.append(4+i*4+i)
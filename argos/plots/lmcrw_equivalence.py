@@ -0,0 +1,156 @@
+"""Compares the trajectories of the LMCRW run as a kilolib behavior process and
+as the native kilobot_lmcrw controller.
+
+Usage (from the ARGoS folder):
+    python3 plots/lmcrw_equivalence.py <process_dir> <native_dir> [--output FILE]
+
+Each directory holds the seed#<n>_kiloLOG.tsv files of one configuration, as
+written by src/examples/experiments/batch/lmcrw_equivalence.sh. The random
+numbers of the two versions differ, so only the runs as a whole can be
+compared: every metric has one value per run, and the mean of the native runs
+is tested against the mean of the process runs.
+
+A test that fails to find a difference does not show that there is none, so
+every metric gets an equivalence test, the two one-sided Welch t-tests (TOST):
+the versions are equivalent for a metric if the difference of the means is
+shown to lie within +-margin times the mean of the process runs (10% by
+default). The script also prints the effect size (Hedges' g), the 1 - 2 alpha
+confidence interval of the relative difference, and the power the TOST had to
+conclude equivalence if the means were equal, with the variances observed. It
+exits with 1 unless every metric is shown equivalent: all the tests must
+succeed, so each is done at level alpha.
+
+lmcrw_equivalence_standin.txt holds its output on stand-in logs, not on
+ARGoS runs.
+"""
+
+import argparse
+import glob
+import os
+import sys
+
+import matplotlib.pyplot as plt
+import numpy as np
+import pandas as pd
+from scipy import stats
+
+# Columns of a robot in the KiloLOG: id, soc/env, x, y, orientation, light
+ROBOT_COLUMNS = 6
+# Lags of the mean squared displacement, in samples (1 sample = 1 s in lmcrw_equivalence.argos)
+MSD_LAGS = [10, 60]
+
+
+def read_kilolog(file_name):
+    data = pd.read_csv(file_name, sep='\t', header=None)
+    # Each row ends with a tab
+    data.drop(data.columns[-1], axis=1, inplace=True)
+    num_robots = (data.shape[1] - 1) // ROBOT_COLUMNS
+    # The time is in column 0
+    x = data.iloc[:, [3 + i * ROBOT_COLUMNS for i in range(num_robots)]].to_numpy(dtype='float64')
+    y = data.iloc[:, [4 + i * ROBOT_COLUMNS for i in range(num_robots)]].to_numpy(dtype='float64')
+    yaw = data.iloc[:, [5 + i * ROBOT_COLUMNS for i in range(num_robots)]].to_numpy(dtype='float64')
+    light = data.iloc[:, [6 + i * ROBOT_COLUMNS for i in range(num_robots)]].to_numpy(dtype='float64')
+    return x, y, yaw, light
+
+
+def run_metrics(file_name):
+    """Returns the metrics of a run, and the samples pooled for the plots"""
+    x, y, yaw, light = read_kilolog(file_name)
+    steps = np.hypot(np.diff(x, axis=0), np.diff(y, axis=0))
+    turns = np.abs(np.angle(np.exp(1j * np.diff(yaw, axis=0))))
+    metrics = {
+        'mean step': steps.mean(),
+        'moving fraction': (steps > 1e-4).mean(),
+        'mean turn': turns.mean(),
+        'final light': light[-1].mean(),
+        'mean light': light.mean(),
+    }
+    for lag in MSD_LAGS:
+        if lag < x.shape[0]:
+            metrics['msd %ds' % lag] = ((x[lag:] - x[:-lag]) ** 2 + (y[lag:] - y[:-lag]) ** 2).mean()
+    samples = {'step': steps.ravel(), 'turn': turns.ravel(), 'light': light[-1]}
+    return metrics, samples
+
+
+def tost(process, native, margin, alpha):
+    """Welch TOST of the difference of the means, within +-margin * mean(process).
+    Returns the relative difference, its confidence interval, the p-value, Hedges' g and the power."""
+    n1, n2 = len(process), len(native)
+    m1, m2 = process.mean(), native.mean()
+    v1, v2 = process.var(ddof=1), native.var(ddof=1)
+    delta = margin * abs(m1)
+    diff = m2 - m1
+    se = np.sqrt(v1 / n1 + v2 / n2)
+    if se == 0:
+        p = 0.0 if abs(diff) < delta else 1.0
+        return diff / m1, (diff / m1, diff / m1), p, 0.0, 1.0
+    df = (v1 / n1 + v2 / n2) ** 2 / ((v1 / n1) ** 2 / (n1 - 1) + (v2 / n2) ** 2 / (n2 - 1))
+    p_lower = stats.t.sf((diff + delta) / se, df)
+    p_upper = stats.t.cdf((diff - delta) / se, df)
+    t_crit = stats.t.ppf(1 - alpha, df)
+    low, high = diff - t_crit * se, diff + t_crit * se
+    sd = np.sqrt(((n1 - 1) * v1 + (n2 - 1) * v2) / (n1 + n2 - 2))
+    g = diff / sd * (1 - 3 / (4 * (n1 + n2) - 9)) if sd > 0 else 0.0
+    power = max(0.0, 2 * stats.t.cdf(delta / se - t_crit, df) - 1)
+    return diff / m1, (low / m1, high / m1), max(p_lower, p_upper), g, power
+
+
+def read_runs(directory):
+    files = sorted(glob.glob(os.path.join(directory, 'seed#*_kiloLOG.tsv')))
+    if not files:
+        sys.exit("No KiloLOG in '%s'" % directory)
+    metrics = []
+    samples = {}
+    for file_name in files:
+        run, run_samples = run_metrics(file_name)
+        metrics.append(run)
+        for key, values in run_samples.items():
+            samples.setdefault(key, []).append(values)
+    return pd.DataFrame(metrics), {key: np.concatenate(values) for key, values in samples.items()}
+
+
+parser = argparse.ArgumentParser(description='TOST equivalence test of the process and native LMCRW')
+parser.add_argument('process_dir')
+parser.add_argument('native_dir')
+parser.add_argument('--alpha', type=float, default=0.05)
+parser.add_argument('--margin', type=float, default=0.1,
+                    help='equivalence margin, relative to the mean of the process runs')
+parser.add_argument('--output', default='lmcrw_equivalence.pdf')
+args = parser.parse_args()
+
+process_metrics, process_samples = read_runs(args.process_dir)
+native_metrics, native_samples = read_runs(args.native_dir)
+print("%d process runs, %d native runs" % (len(process_metrics), len(native_metrics)))
+
+metrics = [m for m in process_metrics.columns if m in native_metrics.columns]
+not_shown = []
+print("Equivalence margin +-%.0f%% of the process mean, alpha %.3f" % (100 * args.margin, args.alpha))
+print("%-16s %12s %12s %8s %18s %8s %7s %6s" % ('metric', 'process', 'native', 'diff',
+                                               '%.0f%% CI' % (100 * (1 - 2 * args.alpha)), 'TOST p', 'g', 'power'))
+for metric in metrics:
+    diff, (low, high), p, g, power = tost(process_metrics[metric].to_numpy(),
+                                          native_metrics[metric].to_numpy(),
+                                          args.margin, args.alpha)
+    print("%-16s %12.6f %12.6f %+7.1f%% [%+6.1f%%, %+6.1f%%] %8.4f %+7.2f %6.2f%s" % (
+        metric, process_metrics[metric].mean(), native_metrics[metric].mean(),
+        100 * diff, 100 * low, 100 * high, p, g, power, '' if p < args.alpha else ' *'))
+    if p >= args.alpha:
+        not_shown.append(metric)
+
+fig, axes = plt.subplots(1, 3, figsize=(15, 4))
+for ax, (key, xlabel) in zip(axes, [('step', 'displacement in a sample [m]'),
+                                    ('turn', 'heading change in a sample [rad]'),
+                                    ('light', 'final gradient')]):
+    bins = np.histogram_bin_edges(np.concatenate([process_samples[key], native_samples[key]]), bins=50)
+    ax.hist(process_samples[key], bins=bins, density=True, histtype='step', label='process')
+    ax.hist(native_samples[key], bins=bins, density=True, histtype='step', label='native')
+    ax.set_xlabel(xlabel)
+    ax.set_yscale('log')
+    ax.legend()
+plt.tight_layout()
+plt.savefig(args.output)
+
+if not_shown:
+    print("Equivalence within +-%.0f%% not shown for: %s" % (100 * args.margin, ', '.join(not_shown)))
+    sys.exit(1)
+print("Equivalent within +-%.0f%% for all the metrics" % (100 * args.margin))
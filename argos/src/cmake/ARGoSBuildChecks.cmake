@@ -23,6 +23,11 @@ find_package(Lua53 REQUIRED)
 #
 find_package(RT)
 
+#
+# Look for the thread library, used by the kilobot communication medium
+#
+find_package(Threads)
+
 #
 # Set ARGoS include dir
 #
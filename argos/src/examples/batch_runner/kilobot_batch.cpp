@@ -0,0 +1,874 @@
+/**
+ * @file <kilobot_batch.cpp>
+ *
+ * @brief Runs a grid of experiments without starting argos3 for each run.
+ *
+ * The experiment is a template .argos file with placeholders, as in
+ * experiments/batch/heterogeneousswarm.argos. For each point of the grid
+ * (number of robots x arena size x fraction of social robots x seed), the
+ * placeholders are replaced, and the configuration is loaded in the
+ * simulator, run and destroyed. The plugins and the libraries of the loop
+ * functions and of the behaviors are loaded once per worker. Each run is a
+ * fork of its worker: CSimulator is a singleton, and its Destroy() also
+ * empties the factories of the plugins, so a process can run a single
+ * experiment.
+ *
+ * The placeholders are:
+ *
+ *   __SEED__            the seed of the run
+ *   __NUMROBOTS__       from --robots
+ *   __ARENASIZE__       from --arena-sizes
+ *   __POSDISTR__        half the arena size minus 2 cm, the range of the initial positions
+ *   __SOCIALROBOTS__    the fraction of social robots (--social) times the number of robots
+ *   __TIMEEXPERIMENT__  from --length
+ *   __ROBPOSOUTPUT__    the KiloLOG file of the run
+ *   __NAME__            from -D NAME=VALUE
+ *
+ * The runs of a configuration go in a directory of the results directory,
+ * named after the configuration as in the batch scripts, with the values
+ * the scripts got from bc (arenasize#70.0 for 0.7, socialRobots#5.0 for 0.2
+ * of 25 robots). A run writes
+ * seed#<seed>.argos, its configuration, and seed#<seed>_kiloLOG.tsv.
+ *
+ * With --jobs, the runs are shared by worker processes, each pinned to a
+ * core. The workers take the next run from a counter in shared memory, so a
+ * long run does not hold back the others.
+ *
+ * --run-memory caps the memory of a run as a whole: the simulator and all
+ * the behaviors it forks. A run is a process group, and while it runs its
+ * worker sums the proportional set size of the processes of the group every
+ * second, and kills the group when the sum goes over the cap. As a worker
+ * does one run at a time, this caps the memory of each worker.
+ * --process-memory limits the address space of every process of a run
+ * (RLIMIT_AS) separately, which stops a single process that runs away
+ * before it takes the memory of the others. To cap the memory of the whole
+ * batch, run it in a cgroup, for instance with
+ * 'systemd-run --user --scope -p MemoryMax=8G kilobot_batch ...'.
+ *
+ * Every completed run is appended to a manifest in the results directory.
+ * When the batch starts again, for instance after an interruption, it skips
+ * the runs in the manifest. The manifest also keeps the date in the names of
+ * the directories, so a batch resumed on another day goes on in the same
+ * directories. Delete the manifest to run everything again.
+ *
+ * Usage: kilobot_batch [options] <template.argos>, see Usage() below.
+ */
+
+#include <argos3/core/simulator/simulator.h>
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <argos3/core/utility/logging/argos_log.h>
+#include <argos3/core/utility/plugins/dynamic_loading.h>
+#include <argos3/core/utility/string_utilities.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace argos;
+
+/****************************************/
+/****************************************/
+
+/** The grid of the batch, from the command line */
+struct SBatch {
+   std::string TemplateFile;
+   std::vector<UInt32> Seeds;
+   std::vector<UInt32> Robots;
+   std::vector<std::string> ArenaSizes;
+   std::vector<std::string> SocialFractions;
+   std::string Length;
+   std::map<std::string, std::string> Placeholders;
+   std::string ResultsDir;
+   std::string Prefix;
+   std::string Date;
+   std::string Manifest;
+   /** Number of worker processes, 0 for one per core */
+   UInt32 Jobs;
+   /** Address space limit of each process of a run, in MiB, 0 for none */
+   UInt64 ProcessMemoryLimit;
+   /** Memory limit of a run, its simulator and its behaviors together, in MiB, 0 for none */
+   UInt64 RunMemoryLimit;
+   bool Pin;
+
+   SBatch() :
+      ResultsDir("results"),
+      Prefix("batch"),
+      Jobs(1),
+      ProcessMemoryLimit(0),
+      RunMemoryLimit(0),
+      Pin(true) {}
+};
+
+/** A run of the batch */
+struct SRun {
+   std::string Directory;
+   UInt32 Seed;
+   std::map<std::string, std::string> Placeholders;
+
+   /** The key of the run in the manifest */
+   std::string GetId() const {
+      return Directory + "\t" + ToString(Seed);
+   }
+};
+
+/** The state the workers share */
+struct SShared {
+   /** Index of the next run to take */
+   UInt32 NextRun;
+   UInt32 Completed;
+   UInt32 Failed;
+};
+
+/****************************************/
+/****************************************/
+
+static void Usage(const char* pch_name) {
+   std::cerr << "Usage: " << pch_name << " [options] <template.argos>" << std::endl
+             << std::endl
+             << "  -s, --seeds S           seeds of the runs, as a list of numbers and ranges (1-100,200)" << std::endl
+             << "  -n, --robots N,...      numbers of robots, for __NUMROBOTS__" << std::endl
+             << "  -a, --arena-sizes A,... arena sizes, for __ARENASIZE__ and __POSDISTR__" << std::endl
+             << "  -f, --social F,...      fractions of social robots, for __SOCIALROBOTS__ (needs --robots)" << std::endl
+             << "  -l, --length SECONDS    length of the experiments, for __TIMEEXPERIMENT__" << std::endl
+             << "  -D NAME=VALUE           value of the placeholder __NAME__" << std::endl
+             << "  -r, --results DIR       results directory (default: results)" << std::endl
+             << "  -p, --prefix NAME       prefix of the directories of the configurations (default: batch)" << std::endl
+             << "  -j, --jobs N            number of worker processes, 0 for one per core (default: 1)" << std::endl
+             << "  -m, --process-memory MIB address space limit of each process of a run, in MiB" << std::endl
+             << "  -M, --run-memory MIB    memory limit of each run, the simulator and its behaviors together, in MiB" << std::endl
+             << "      --no-pin            do not pin the workers to cores" << std::endl
+             << "      --manifest FILE     list of the completed runs (default: <results>/kilobot_batch.manifest)" << std::endl
+             << "      --date DATE         date in the names of the directories (default: from the manifest, or today)" << std::endl
+             << "  -h, --help              this help" << std::endl;
+}
+
+/****************************************/
+/****************************************/
+
+static std::vector<UInt32> ParseSeeds(const std::string& str_seeds) {
+   std::vector<UInt32> vecSeeds;
+   std::vector<std::string> vecTokens;
+   Tokenize(str_seeds, vecTokens, ",");
+   for(size_t i = 0; i < vecTokens.size(); ++i) {
+      size_t unDash = vecTokens[i].find('-');
+      if(unDash == std::string::npos) {
+         vecSeeds.push_back(FromString<UInt32>(vecTokens[i]));
+      }
+      else {
+         UInt32 unFirst = FromString<UInt32>(vecTokens[i].substr(0, unDash));
+         UInt32 unLast = FromString<UInt32>(vecTokens[i].substr(unDash + 1));
+         if(unFirst > unLast) {
+            THROW_ARGOSEXCEPTION("Empty range of seeds \"" << vecTokens[i] << "\"");
+         }
+         for(UInt32 unSeed = unFirst; unSeed <= unLast; ++unSeed) {
+            vecSeeds.push_back(unSeed);
+         }
+      }
+   }
+   for(size_t i = 0; i < vecSeeds.size(); ++i) {
+      if(vecSeeds[i] == 0) {
+         THROW_ARGOSEXCEPTION("The seeds must be positive: ARGoS takes 0 as a time-based seed");
+      }
+   }
+   return vecSeeds;
+}
+
+/****************************************/
+/****************************************/
+
+static std::string FormatReal(Real f_value) {
+   std::ostringstream cStream;
+   cStream << f_value;
+   return cStream.str();
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Multiplies two decimal numbers and formats the product as 'bc -l' does,
+ * so that the directories keep the names the batch scripts gave them.
+ * The product has as many decimals as the two factors together, and no 0
+ * before the point: 0.7 * 100 is "70.0", 25 * 0.2 is "5.0" and 1 * 0.2 is ".2".
+ */
+static std::string MultiplyAsBc(const std::string& str_a,
+                                const std::string& str_b) {
+   UInt64 unProduct = 1;
+   size_t unScale = 0;
+   const std::string* pstrFactors[2] = { &str_a, &str_b };
+   for(size_t i = 0; i < 2; ++i) {
+      UInt64 unFactor = 0;
+      bool bPoint = false;
+      for(size_t j = 0; j < pstrFactors[i]->size(); ++j) {
+         char chDigit = (*pstrFactors[i])[j];
+         if(chDigit == '.' && !bPoint) {
+            bPoint = true;
+         }
+         else if(::isdigit(chDigit)) {
+            unFactor = unFactor * 10 + (chDigit - '0');
+            if(bPoint) ++unScale;
+         }
+         else {
+            THROW_ARGOSEXCEPTION("Expected a positive decimal number, not \"" << *pstrFactors[i] << "\"");
+         }
+      }
+      unProduct *= unFactor;
+   }
+   if(unProduct == 0) return "0";
+   std::string strProduct = ToString(unProduct);
+   if(unScale == 0) return strProduct;
+   if(strProduct.size() <= unScale) {
+      return "." + std::string(unScale - strProduct.size(), '0') + strProduct;
+   }
+   return strProduct.insert(strProduct.size() - unScale, ".");
+}
+
+/****************************************/
+/****************************************/
+
+static std::string Today() {
+   char pchDate[16];
+   time_t tNow = ::time(NULL);
+   ::strftime(pchDate, sizeof(pchDate), "%Y-%m-%d", ::localtime(&tNow));
+   return pchDate;
+}
+
+/****************************************/
+/****************************************/
+
+static void MakeDirectories(const std::string& str_path) {
+   for(size_t unSlash = str_path.find('/', 1);
+       ;
+       unSlash = str_path.find('/', unSlash + 1)) {
+      std::string strPath = str_path.substr(0, unSlash);
+      if(::mkdir(strPath.c_str(), 0755) != 0 && errno != EEXIST) {
+         THROW_ARGOSEXCEPTION("Creating the directory \"" << strPath << "\": " << ::strerror(errno));
+      }
+      if(unSlash == std::string::npos) break;
+   }
+}
+
+/****************************************/
+/****************************************/
+
+static std::string ReadFile(const std::string& str_file) {
+   std::ifstream cInput(str_file.c_str());
+   if(!cInput) {
+      THROW_ARGOSEXCEPTION("Opening the template \"" << str_file << "\"");
+   }
+   std::ostringstream cContents;
+   cContents << cInput.rdbuf();
+   return cContents.str();
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Replaces the placeholders __NAME__ in the template.
+ * It fails if the result still contains a placeholder.
+ */
+static std::string Substitute(const std::string& str_template,
+                              const std::map<std::string, std::string>& map_placeholders) {
+   std::string strResult(str_template);
+   for(std::map<std::string, std::string>::const_iterator it = map_placeholders.begin();
+       it != map_placeholders.end();
+       ++it) {
+      std::string strPlaceholder = "__" + it->first + "__";
+      for(size_t unPos = strResult.find(strPlaceholder);
+          unPos != std::string::npos;
+          unPos = strResult.find(strPlaceholder, unPos + it->second.size())) {
+         strResult.replace(unPos, strPlaceholder.size(), it->second);
+      }
+   }
+   /* Look for the placeholders left */
+   for(size_t unPos = strResult.find("__");
+       unPos != std::string::npos;
+       unPos = strResult.find("__", unPos + 2)) {
+      size_t unEnd = unPos + 2;
+      while(unEnd < strResult.size() &&
+            (::isupper(strResult[unEnd]) || ::isdigit(strResult[unEnd]))) {
+         ++unEnd;
+      }
+      if(unEnd > unPos + 2 && strResult.compare(unEnd, 2, "__") == 0) {
+         THROW_ARGOSEXCEPTION("No value for the placeholder " << strResult.substr(unPos, unEnd + 2 - unPos)
+                              << ": give it with the options or with -D");
+      }
+   }
+   return strResult;
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Lists the runs of the grid, configuration by configuration.
+ */
+static std::vector<SRun> ExpandGrid(const SBatch& s_batch) {
+   /* An axis that is not given has a single, empty value */
+   std::vector<UInt32> vecRobots(s_batch.Robots);
+   if(vecRobots.empty()) vecRobots.push_back(0);
+   std::vector<std::string> vecArenaSizes(s_batch.ArenaSizes);
+   if(vecArenaSizes.empty()) vecArenaSizes.push_back("");
+   std::vector<std::string> vecSocialFractions(s_batch.SocialFractions);
+   if(vecSocialFractions.empty()) vecSocialFractions.push_back("");
+   std::vector<SRun> vecRuns;
+   for(size_t i = 0; i < vecRobots.size(); ++i) {
+      for(size_t j = 0; j < vecArenaSizes.size(); ++j) {
+         for(size_t k = 0; k < vecSocialFractions.size(); ++k) {
+            SRun sRun;
+            sRun.Placeholders = s_batch.Placeholders;
+            std::ostringstream cDirectory;
+            cDirectory << s_batch.ResultsDir << "/" << s_batch.Prefix << "#" << s_batch.Date;
+            if(!vecArenaSizes[j].empty()) {
+               Real fArenaSize = FromString<Real>(vecArenaSizes[j]);
+               sRun.Placeholders["ARENASIZE"] = vecArenaSizes[j];
+               sRun.Placeholders["POSDISTR"] = FormatReal(fArenaSize / 2.0 - 0.02);
+               cDirectory << "_arenasize#" << MultiplyAsBc(vecArenaSizes[j], "100");
+            }
+            if(!s_batch.Robots.empty()) {
+               sRun.Placeholders["NUMROBOTS"] = ToString(vecRobots[i]);
+               cDirectory << "_numrobots#" << vecRobots[i];
+            }
+            if(!vecSocialFractions[k].empty()) {
+               UInt32 unSocial = ::round(FromString<Real>(vecSocialFractions[k]) * vecRobots[i]);
+               sRun.Placeholders["SOCIALROBOTS"] = ToString(unSocial);
+               cDirectory << "_socialRobots#" << MultiplyAsBc(ToString(vecRobots[i]), vecSocialFractions[k]);
+            }
+            if(!s_batch.Length.empty()) {
+               sRun.Placeholders["TIMEEXPERIMENT"] = s_batch.Length;
+               cDirectory << "_seconds#" << s_batch.Length;
+            }
+            sRun.Directory = cDirectory.str();
+            for(size_t s = 0; s < s_batch.Seeds.size(); ++s) {
+               sRun.Seed = s_batch.Seeds[s];
+               sRun.Placeholders["SEED"] = ToString(sRun.Seed);
+               if(s_batch.Placeholders.find("ROBPOSOUTPUT") == s_batch.Placeholders.end()) {
+                  sRun.Placeholders["ROBPOSOUTPUT"] = sRun.Directory + "/seed#" + ToString(sRun.Seed) + "_kiloLOG.tsv";
+               }
+               vecRuns.push_back(sRun);
+            }
+         }
+      }
+   }
+   return vecRuns;
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Writes the configuration of a run, then loads it in the simulator, runs it and destroys it.
+ * A process can do it only once, see RunInChild().
+ */
+static void Run(const std::string& str_template,
+                const SRun& s_run) {
+   MakeDirectories(s_run.Directory);
+   std::string strConfigurationFile = s_run.Directory + "/seed#" + ToString(s_run.Seed) + ".argos";
+   {
+      std::ofstream cConfiguration(strConfigurationFile.c_str(), std::ios_base::trunc | std::ios_base::out);
+      cConfiguration << Substitute(str_template, s_run.Placeholders);
+      if(!cConfiguration) {
+         THROW_ARGOSEXCEPTION("Writing the configuration \"" << strConfigurationFile << "\"");
+      }
+   }
+   /*
+    * Reload the configuration rather than resetting the simulator: the loop
+    * functions place the robots in Init(), and Reset() would put them back
+    * where the previous run started. The libraries stay loaded.
+    */
+   CSimulator& cSimulator = CSimulator::GetInstance();
+   cSimulator.SetExperimentFileName(strConfigurationFile);
+   cSimulator.LoadExperiment();
+   cSimulator.Execute();
+   cSimulator.Destroy();
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Returns the memory of a process in KiB: its proportional set size, which
+ * splits the pages it shares with others, or its resident set size if the
+ * kernel does not give the former.
+ */
+static UInt64 GetProcessMemory(const std::string& str_pid) {
+   std::ifstream cRollup(("/proc/" + str_pid + "/smaps_rollup").c_str());
+   std::string strField;
+   UInt64 unKiB;
+   while(cRollup >> strField) {
+      if(strField == "Pss:" && cRollup >> unKiB) return unKiB;
+   }
+   std::ifstream cStatm(("/proc/" + str_pid + "/statm").c_str());
+   UInt64 unPages, unResident;
+   if(cStatm >> unPages >> unResident) return unResident * (::sysconf(_SC_PAGESIZE) / 1024);
+   return 0;
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Returns the memory of the processes of a group, in KiB.
+ * @see GetProcessMemory
+ */
+static UInt64 GetGroupMemory(pid_t t_group) {
+   UInt64 unKiB = 0;
+   DIR* ptProc = ::opendir("/proc");
+   if(ptProc == NULL) return 0;
+   struct dirent* ptEntry;
+   while((ptEntry = ::readdir(ptProc)) != NULL) {
+      if(!std::isdigit(ptEntry->d_name[0])) continue;
+      /* The group is the fifth field of stat, the third after the name, which may contain spaces */
+      std::ifstream cStat((std::string("/proc/") + ptEntry->d_name + "/stat").c_str());
+      std::string strStat;
+      std::getline(cStat, strStat);
+      size_t unNameEnd = strStat.rfind(')');
+      if(unNameEnd == std::string::npos) continue;
+      std::istringstream cFields(strStat.substr(unNameEnd + 1));
+      std::string strState;
+      pid_t tParent, tGroup;
+      if(cFields >> strState >> tParent >> tGroup && tGroup == t_group) {
+         unKiB += GetProcessMemory(ptEntry->d_name);
+      }
+   }
+   ::closedir(ptProc);
+   return unKiB;
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Does a run in a fork of the worker, and waits for it.
+ * The fork has the libraries of the worker already loaded, and its own
+ * simulator, which is destroyed with the run.
+ * The fork leads a process group, which the behaviors it starts join, so
+ * the run can be measured and killed as a whole.
+ * @param un_worker The index of the worker, for the log.
+ * @param un_run The index of the run, for the log.
+ * @param un_memory_limit The address space limit of the fork and of the behaviors it starts, each, in MiB, 0 for none.
+ * @param un_run_memory_limit The memory limit of the fork and of the behaviors it starts, together, in MiB, 0 for none.
+ * @return true if the run completed.
+ */
+static bool RunInChild(UInt32 un_worker,
+                       UInt32 un_run,
+                       UInt64 un_memory_limit,
+                       UInt64 un_run_memory_limit,
+                       const std::string& str_template,
+                       const SRun& s_run) {
+   /* Do not let the run print what is buffered here */
+   LOG.Flush();
+   LOGERR.Flush();
+   pid_t tWorker = ::getpid();
+   pid_t tPid = ::fork();
+   if(tPid < 0) {
+      THROW_ARGOSEXCEPTION("Starting run " << (un_run + 1) << ": " << ::strerror(errno));
+   }
+   if(tPid == 0) {
+      /* The run, which does not outlive its worker */
+      ::setpgid(0, 0);
+      ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+      if(::getppid() != tWorker) ::_exit(1);
+      if(un_memory_limit > 0) {
+         /* The behaviors inherit the limit, each for itself */
+         struct rlimit sLimit;
+         sLimit.rlim_cur = sLimit.rlim_max = un_memory_limit << 20;
+         if(::setrlimit(RLIMIT_AS, &sLimit) != 0) {
+            LOGERR << "[WARNING] Worker " << un_worker << ": cannot limit the memory of run " << (un_run + 1)
+                   << ": " << ::strerror(errno) << std::endl;
+         }
+      }
+      int nStatus = 0;
+      try {
+         Run(str_template, s_run);
+      }
+      catch(std::exception& ex) {
+         LOGERR << "[FATAL] Worker " << un_worker << ": run " << (un_run + 1) << " failed: " << ex.what() << std::endl;
+         nStatus = 1;
+      }
+      LOG.Flush();
+      LOGERR.Flush();
+      ::_exit(nStatus);
+   }
+   /* Set the group here too, so that it exists before the run forks */
+   ::setpgid(tPid, tPid);
+   int nStatus;
+   bool bOverLimit = false;
+   UInt32 unPolls = 0;
+   while(true) {
+      pid_t tDone = ::waitpid(tPid, &nStatus, un_run_memory_limit > 0 ? WNOHANG : 0);
+      if(tDone == tPid) break;
+      if(tDone < 0) {
+         if(errno == EINTR) continue;
+         THROW_ARGOSEXCEPTION("Waiting for run " << (un_run + 1) << ": " << ::strerror(errno));
+      }
+      /* Still running: check its memory every second, its end more often */
+      ::usleep(100000);
+      if(!bOverLimit && ++unPolls % 10 == 0) {
+         UInt64 unKiB = GetGroupMemory(tPid);
+         if(unKiB > (un_run_memory_limit << 10)) {
+            LOGERR << "[FATAL] Worker " << un_worker << ": run " << (un_run + 1)
+                   << " uses " << (unKiB >> 10) << " MiB, more than " << un_run_memory_limit
+                   << " MiB: killing it" << std::endl;
+            LOGERR.Flush();
+            ::kill(-tPid, SIGKILL);
+            bOverLimit = true;
+         }
+      }
+   }
+   /* Do not leave behind the behaviors of a run that crashed */
+   ::kill(-tPid, SIGKILL);
+   if(WIFSIGNALED(nStatus) && !bOverLimit) {
+      /* For instance out of memory */
+      LOGERR << "[FATAL] Worker " << un_worker << ": run " << (un_run + 1)
+             << " died with signal " << WTERMSIG(nStatus) << std::endl;
+      LOGERR.Flush();
+   }
+   return WIFEXITED(nStatus) && WEXITSTATUS(nStatus) == 0;
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Reads the completed runs and the date of the batch from the manifest, if it exists.
+ * @param str_date Set to the date of the batch, or left empty.
+ */
+static void ReadManifest(const std::string& str_manifest,
+                         std::string& str_date,
+                         std::set<std::string>& set_completed) {
+   std::ifstream cManifest(str_manifest.c_str());
+   std::string strLine;
+   while(std::getline(cManifest, strLine)) {
+      if(strLine.compare(0, 6, "#date\t") == 0) {
+         str_date = strLine.substr(6);
+      }
+      else if(!strLine.empty()) {
+         set_completed.insert(strLine);
+      }
+   }
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Appends a line to the manifest.
+ * The workers share the file: a single write() in append mode keeps the lines whole.
+ */
+static void AppendToManifest(int n_manifest,
+                             const std::string& str_line) {
+   std::string strLine = str_line + "\n";
+   if(::write(n_manifest, strLine.data(), strLine.size()) != static_cast<ssize_t>(strLine.size())) {
+      THROW_ARGOSEXCEPTION("Writing the manifest: " << ::strerror(errno));
+   }
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Returns the cores this process may run on.
+ */
+static std::vector<UInt32> GetCores() {
+   std::vector<UInt32> vecCores;
+#ifdef __linux__
+   cpu_set_t tCPUs;
+   CPU_ZERO(&tCPUs);
+   if(::sched_getaffinity(0, sizeof(tCPUs), &tCPUs) == 0) {
+      for(UInt32 i = 0; i < CPU_SETSIZE; ++i) {
+         if(CPU_ISSET(i, &tCPUs)) vecCores.push_back(i);
+      }
+   }
+#endif
+   if(vecCores.empty()) {
+      long nCores = ::sysconf(_SC_NPROCESSORS_ONLN);
+      for(long i = 0; i < nCores; ++i) {
+         vecCores.push_back(i);
+      }
+   }
+   return vecCores;
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Takes runs until there are none left, each in its own fork.
+ * @param un_worker The index of the worker, for the log.
+ */
+static void RunWorker(UInt32 un_worker,
+                      UInt64 un_memory_limit,
+                      UInt64 un_run_memory_limit,
+                      const std::string& str_template,
+                      const std::vector<SRun>& vec_runs,
+                      SShared& s_shared,
+                      int n_manifest) {
+   /* Load the plugins once, as the argos3 executable does */
+   CDynamicLoading::LoadAllLibraries();
+   for(UInt32 i = __atomic_fetch_add(&s_shared.NextRun, 1, __ATOMIC_RELAXED);
+       i < vec_runs.size();
+       i = __atomic_fetch_add(&s_shared.NextRun, 1, __ATOMIC_RELAXED)) {
+      LOG << "[INFO] Worker " << un_worker << ": run " << (i + 1) << "/" << vec_runs.size() << ": "
+          << vec_runs[i].Directory << ", seed " << vec_runs[i].Seed << std::endl;
+      LOG.Flush();
+      std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+      if(!RunInChild(un_worker, i, un_memory_limit, un_run_memory_limit, str_template, vec_runs[i])) {
+         /* Go on with the other runs */
+         __atomic_fetch_add(&s_shared.Failed, 1, __ATOMIC_RELAXED);
+         continue;
+      }
+      AppendToManifest(n_manifest, vec_runs[i].GetId());
+      __atomic_fetch_add(&s_shared.Completed, 1, __ATOMIC_RELAXED);
+      LOG << "[INFO] Worker " << un_worker << ": run " << (i + 1) << " took "
+          << std::chrono::duration<Real>(std::chrono::steady_clock::now() - tStart).count()
+          << " s" << std::endl;
+      LOG.Flush();
+   }
+   CDynamicLoading::UnloadAllLibraries();
+}
+
+/****************************************/
+/****************************************/
+
+/**
+ * Forks a worker, pinned to a core.
+ * @return The pid of the worker.
+ */
+static pid_t StartWorker(UInt32 un_worker,
+                         const SBatch& s_batch,
+                         const std::vector<UInt32>& vec_cores,
+                         const std::string& str_template,
+                         const std::vector<SRun>& vec_runs,
+                         SShared& s_shared,
+                         int n_manifest) {
+   /* Do not let the worker print what is buffered here */
+   LOG.Flush();
+   LOGERR.Flush();
+   pid_t tPid = ::fork();
+   if(tPid < 0) {
+      THROW_ARGOSEXCEPTION("Starting worker " << un_worker << ": " << ::strerror(errno));
+   }
+   if(tPid > 0) return tPid;
+   /* The worker */
+   if(s_batch.Pin) {
+#ifdef __linux__
+      /* The behaviors of the robots inherit the core */
+      cpu_set_t tCPUs;
+      CPU_ZERO(&tCPUs);
+      CPU_SET(vec_cores[un_worker % vec_cores.size()], &tCPUs);
+      if(::sched_setaffinity(0, sizeof(tCPUs), &tCPUs) != 0) {
+         LOGERR << "[WARNING] Worker " << un_worker << ": cannot pin to core "
+                << vec_cores[un_worker % vec_cores.size()] << ": " << ::strerror(errno) << std::endl;
+      }
+#endif
+   }
+   RunWorker(un_worker, s_batch.ProcessMemoryLimit, s_batch.RunMemoryLimit, str_template, vec_runs, s_shared, n_manifest);
+   LOG.Flush();
+   LOGERR.Flush();
+   ::_exit(0);
+}
+
+/****************************************/
+/****************************************/
+
+int main(int argc, char** argv) {
+   SBatch sBatch;
+   sBatch.Seeds.push_back(1);
+   try {
+      for(int i = 1; i < argc; ++i) {
+         std::string strArg(argv[i]);
+         if(strArg == "-h" || strArg == "--help") {
+            Usage(argv[0]);
+            return 0;
+         }
+         if(strArg == "--no-pin") {
+            sBatch.Pin = false;
+            continue;
+         }
+         if(strArg[0] != '-') {
+            if(!sBatch.TemplateFile.empty()) {
+               THROW_ARGOSEXCEPTION("More than one template: \"" << sBatch.TemplateFile << "\" and \"" << strArg << "\"");
+            }
+            sBatch.TemplateFile = strArg;
+            continue;
+         }
+         if(i + 1 >= argc) {
+            THROW_ARGOSEXCEPTION("Missing value for " << strArg);
+         }
+         std::string strValue(argv[++i]);
+         if(strArg == "-s" || strArg == "--seeds") {
+            sBatch.Seeds = ParseSeeds(strValue);
+         }
+         else if(strArg == "-n" || strArg == "--robots") {
+            std::vector<std::string> vecTokens;
+            Tokenize(strValue, vecTokens, ",");
+            sBatch.Robots.clear();
+            for(size_t j = 0; j < vecTokens.size(); ++j) {
+               sBatch.Robots.push_back(FromString<UInt32>(vecTokens[j]));
+            }
+         }
+         else if(strArg == "-a" || strArg == "--arena-sizes") {
+            sBatch.ArenaSizes.clear();
+            Tokenize(strValue, sBatch.ArenaSizes, ",");
+         }
+         else if(strArg == "-f" || strArg == "--social") {
+            sBatch.SocialFractions.clear();
+            Tokenize(strValue, sBatch.SocialFractions, ",");
+         }
+         else if(strArg == "-l" || strArg == "--length") {
+            sBatch.Length = strValue;
+         }
+         else if(strArg == "-D") {
+            size_t unEqual = strValue.find('=');
+            if(unEqual == std::string::npos || unEqual == 0) {
+               THROW_ARGOSEXCEPTION("Expected NAME=VALUE after -D, not \"" << strValue << "\"");
+            }
+            sBatch.Placeholders[strValue.substr(0, unEqual)] = strValue.substr(unEqual + 1);
+         }
+         else if(strArg == "-r" || strArg == "--results") {
+            sBatch.ResultsDir = strValue;
+         }
+         else if(strArg == "-p" || strArg == "--prefix") {
+            sBatch.Prefix = strValue;
+         }
+         else if(strArg == "-j" || strArg == "--jobs") {
+            sBatch.Jobs = FromString<UInt32>(strValue);
+         }
+         else if(strArg == "-m" || strArg == "--process-memory") {
+            sBatch.ProcessMemoryLimit = FromString<UInt64>(strValue);
+         }
+         else if(strArg == "-M" || strArg == "--run-memory") {
+            sBatch.RunMemoryLimit = FromString<UInt64>(strValue);
+         }
+         else if(strArg == "--manifest") {
+            sBatch.Manifest = strValue;
+         }
+         else if(strArg == "--date") {
+            sBatch.Date = strValue;
+         }
+         else {
+            THROW_ARGOSEXCEPTION("Unknown option " << strArg);
+         }
+      }
+      if(sBatch.TemplateFile.empty()) {
+         Usage(argv[0]);
+         return 1;
+      }
+      if(!sBatch.SocialFractions.empty() && sBatch.Robots.empty()) {
+         THROW_ARGOSEXCEPTION("--social needs --robots");
+      }
+   }
+   catch(CARGoSException& ex) {
+      LOGERR << "[FATAL] " << ex.what() << std::endl;
+      LOGERR.Flush();
+      return 1;
+   }
+   UInt32 unFailed = 0;
+   try {
+      std::string strTemplate = ReadFile(sBatch.TemplateFile);
+      /* Skip the runs completed by a previous, interrupted batch */
+      MakeDirectories(sBatch.ResultsDir);
+      if(sBatch.Manifest.empty()) {
+         sBatch.Manifest = sBatch.ResultsDir + "/kilobot_batch.manifest";
+      }
+      std::string strManifestDate;
+      std::set<std::string> setCompleted;
+      ReadManifest(sBatch.Manifest, strManifestDate, setCompleted);
+      if(sBatch.Date.empty()) {
+         sBatch.Date = strManifestDate.empty() ? Today() : strManifestDate;
+      }
+      std::vector<SRun> vecGrid = ExpandGrid(sBatch);
+      std::vector<SRun> vecRuns;
+      for(size_t i = 0; i < vecGrid.size(); ++i) {
+         if(setCompleted.find(vecGrid[i].GetId()) == setCompleted.end()) {
+            vecRuns.push_back(vecGrid[i]);
+         }
+      }
+      LOG << "[INFO] " << vecGrid.size() << " runs, "
+          << (vecGrid.size() - vecRuns.size()) << " already completed" << std::endl;
+      int nManifest = ::open(sBatch.Manifest.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+      if(nManifest < 0) {
+         THROW_ARGOSEXCEPTION("Opening the manifest \"" << sBatch.Manifest << "\": " << ::strerror(errno));
+      }
+      if(strManifestDate.empty()) {
+         AppendToManifest(nManifest, "#date\t" + sBatch.Date);
+      }
+      /* The counters live in shared memory, so that the workers can update them */
+      SShared* psShared = reinterpret_cast<SShared*>(
+         ::mmap(NULL, sizeof(SShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+      if(psShared == MAP_FAILED) {
+         THROW_ARGOSEXCEPTION("Allocating the shared counters: " << ::strerror(errno));
+      }
+      ::memset(psShared, 0, sizeof(SShared));
+      std::vector<UInt32> vecCores = GetCores();
+      UInt32 unJobs = (sBatch.Jobs == 0) ? vecCores.size() : sBatch.Jobs;
+      unJobs = std::min<size_t>(unJobs, vecRuns.size());
+      if(unJobs <= 1) {
+         /* A single worker: no need for another process */
+         RunWorker(0, sBatch.ProcessMemoryLimit, sBatch.RunMemoryLimit, strTemplate, vecRuns, *psShared, nManifest);
+      }
+      else {
+         std::map<pid_t, UInt32> mapWorkers;
+         for(UInt32 i = 0; i < unJobs; ++i) {
+            mapWorkers[StartWorker(i, sBatch, vecCores, strTemplate, vecRuns, *psShared, nManifest)] = i;
+         }
+         while(!mapWorkers.empty()) {
+            int nStatus;
+            pid_t tPid = ::waitpid(-1, &nStatus, 0);
+            if(tPid < 0) {
+               if(errno == EINTR) continue;
+               THROW_ARGOSEXCEPTION("Waiting for the workers: " << ::strerror(errno));
+            }
+            std::map<pid_t, UInt32>::iterator it = mapWorkers.find(tPid);
+            if(it == mapWorkers.end()) continue;
+            UInt32 unWorker = it->second;
+            mapWorkers.erase(it);
+            if(WIFEXITED(nStatus) && WEXITSTATUS(nStatus) == 0) continue;
+            /*
+             * The worker crashed outside of a run: the run it was taking may
+             * be lost, but not in the manifest. Replace the worker if there
+             * are runs left.
+             */
+            LOGERR << "[FATAL] Worker " << unWorker << " died";
+            if(WIFSIGNALED(nStatus)) LOGERR << " with signal " << WTERMSIG(nStatus);
+            LOGERR << std::endl;
+            __atomic_fetch_add(&psShared->Failed, 1, __ATOMIC_RELAXED);
+            if(__atomic_load_n(&psShared->NextRun, __ATOMIC_RELAXED) < vecRuns.size()) {
+               mapWorkers[StartWorker(unWorker, sBatch, vecCores, strTemplate, vecRuns, *psShared, nManifest)] = unWorker;
+            }
+         }
+      }
+      ::close(nManifest);
+      unFailed = psShared->Failed;
+      LOG << "[INFO] " << psShared->Completed << " runs completed, " << unFailed << " failed" << std::endl;
+      ::munmap(psShared, sizeof(SShared));
+   }
+   catch(CARGoSException& ex) {
+      LOGERR << "[FATAL] " << ex.what() << std::endl;
+      unFailed = 1;
+   }
+   LOG.Flush();
+   LOGERR.Flush();
+   return unFailed > 0 ? 1 : 0;
+}
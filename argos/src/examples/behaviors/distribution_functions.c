@@ -4,45 +4,56 @@
 #include <stdio.h>
 #include <math.h>
 #include "distribution_functions.h"
+#include "random_variates.h"
+
+/*
+ * The variates come from random_variates.c, which has its own generator:
+ * call rv_seed_hard() in setup().
+ */
 
 double uniform_distribution(double a, double b)
 {
-
-  return (rand() * (b - a) + a) / ((double)RAND_MAX + 1);
+  return a + (b - a) * rv_uniform();
 }
-// oppure
+
 /*
-double uniform_distribution()
-{
-  return rand()/(double)(RAND_MAX+1.0);
-  
+ * The behaviors switch among a few values of rho, so the tables of the last
+ * ones are kept, and replaced in turn.
+ */
+#define WRAPPED_CAUCHY_TABLES 4
 
-}*/
+static rv_wrapped_cauchy_table_t wrapped_cauchy_tables[WRAPPED_CAUCHY_TABLES];
+static int wrapped_cauchy_table_count = 0;
+static int wrapped_cauchy_table_next = 0;
 
 double wrapped_cauchy_ppf(const double c)
 {
-  double val, theta, u, q;
-  q = 0.5;
-  u = uniform_distribution(0.0, 1.0);
-  val = (1.0 - c) / (1.0 + c);
-  theta = 2 * atan(val * tan(M_PI * (u - q)));
-  return theta;
+  const rv_wrapped_cauchy_table_t *table = NULL;
+  int i;
+  for (i = 0; i < wrapped_cauchy_table_count; ++i)
+  {
+    if (wrapped_cauchy_tables[i].rho == c)
+    {
+      table = &wrapped_cauchy_tables[i];
+      break;
+    }
+  }
+  if (table == NULL)
+  {
+    rv_wrapped_cauchy_table_init(&wrapped_cauchy_tables[wrapped_cauchy_table_next], c);
+    table = &wrapped_cauchy_tables[wrapped_cauchy_table_next];
+    wrapped_cauchy_table_next = (wrapped_cauchy_table_next + 1) % WRAPPED_CAUCHY_TABLES;
+    if (wrapped_cauchy_table_count < WRAPPED_CAUCHY_TABLES)
+      ++wrapped_cauchy_table_count;
+  }
+  /* The table gives |theta|, and the distribution is symmetric */
+  double angle = rv_wrapped_cauchy_table_sample(table);
+  return (rv_next() & 1) ? angle : -angle;
 }
 
-/*double exponential_distribution (double lambda, double a, double b)
-{
-  double u,x;
-  u = uniform_distribution(a,b);
-  x=(-1/lambda)*log(u);
-  return(x);
-}*/
-
 double exponential_distribution(double lambda)
 {
-  double u, x;
-  u = uniform_distribution(0.0, 1.0);
-  x = (-lambda) * log(1 - u);
-  return (x);
+  return rv_exponential(lambda);
 }
 
 /* The stable Levy probability distributions have the form
@@ -56,33 +67,16 @@ double exponential_distribution(double lambda)
 
    */
 
+/* The constants of the sampler, computed again only when c or alpha change */
+static rv_levy_t levy_state;
+static int levy_state_ready = 0;
+
 int levy(const double c, const double alpha)
 {
-  double u, v, t, s;
-
-  u = M_PI * (uniform_distribution(0.0, 1.0) - 0.5); /*vedi uniform distribution */
-
-  if (alpha == 1) /* cauchy case */
+  if (!levy_state_ready || levy_state.c != c || levy_state.alpha != alpha)
   {
-    t = tan(u);
-    return (int)(c * t);
+    rv_levy_init(&levy_state, c, alpha);
+    levy_state_ready = 1;
   }
-
-  do
-  {
-    v = exponential_distribution(1.0); /*vedi esponential distribution */
-  } while (v == 0);
-
-  if (alpha == 2) /* gaussian case */
-  {
-    t = 2 * sin(u) * sqrt(v);
-    return (int)(c * t);
-  }
-
-  /* general case */
-
-  t = sin(alpha * u) / pow(cos(u), 1 / alpha);
-  s = pow(cos((1 - alpha) * u) / v, (1 - alpha) / alpha);
-
-  return (int)(c * t * s);
+  return (int)rv_levy_sample(&levy_state);
 }
@@ -363,6 +363,8 @@ void setup()
     rand_seed(seed);
     seed = rand_hard();
     srand(seed);
+    /* Generator of the random walk */
+    rv_seed_hard();
 
     if (rand_soft() % 2)
     {
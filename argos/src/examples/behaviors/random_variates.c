@@ -0,0 +1,142 @@
+#include "random_variates.h"
+#include "kilolib.h"
+#include <math.h>
+
+/* State of xoshiro128** */
+static uint32_t rv_state[4] = {1, 2, 3, 4};
+
+static inline uint32_t rotl(const uint32_t x, int k)
+{
+  return (x << k) | (x >> (32 - k));
+}
+
+/* splitmix32, to spread the seed over the state */
+static uint32_t splitmix32(uint32_t *x)
+{
+  uint32_t z = (*x += 0x9E3779B9);
+  z = (z ^ (z >> 16)) * 0x85EBCA6B;
+  z = (z ^ (z >> 13)) * 0xC2B2AE35;
+  return z ^ (z >> 16);
+}
+
+void rv_seed(uint32_t seed)
+{
+  int i;
+  for (i = 0; i < 4; ++i)
+  {
+    rv_state[i] = splitmix32(&seed);
+  }
+  /* The all-zero state is the only one that xoshiro cannot leave */
+  if ((rv_state[0] | rv_state[1] | rv_state[2] | rv_state[3]) == 0)
+  {
+    rv_state[0] = 1;
+  }
+}
+
+void rv_seed_hard()
+{
+  uint32_t seed = rand_hard();
+  seed = (seed << 8) | rand_hard();
+  seed = (seed << 8) | rand_hard();
+  seed = (seed << 8) | rand_hard();
+  rv_seed(seed);
+}
+
+uint32_t rv_next()
+{
+  const uint32_t result = rotl(rv_state[1] * 5, 7) * 9;
+  const uint32_t t = rv_state[1] << 9;
+  rv_state[2] ^= rv_state[0];
+  rv_state[3] ^= rv_state[1];
+  rv_state[1] ^= rv_state[2];
+  rv_state[0] ^= rv_state[3];
+  rv_state[2] ^= t;
+  rv_state[3] = rotl(rv_state[3], 11);
+  return result;
+}
+
+double rv_uniform()
+{
+  return rv_next() * (1.0 / 4294967296.0);
+}
+
+/* Uniform in (0, 1), for the logarithms and the tangents */
+static inline double rv_uniform_open()
+{
+  return (rv_next() + 0.5) * (1.0 / 4294967296.0);
+}
+
+double rv_exponential(double mean)
+{
+  return -mean * log(rv_uniform_open());
+}
+
+void rv_levy_init(rv_levy_t *levy, double c, double alpha)
+{
+  levy->c = c;
+  levy->alpha = alpha;
+  levy->inv_alpha = 1.0 / alpha;
+  levy->exponent = (1.0 - alpha) / alpha;
+}
+
+double rv_levy_sample(const rv_levy_t *levy)
+{
+  double u = M_PI * (rv_uniform_open() - 0.5);
+  if (levy->alpha == 1) /* cauchy case */
+  {
+    return levy->c * tan(u);
+  }
+  double v = rv_exponential(1.0);
+  if (levy->alpha == 2) /* gaussian case */
+  {
+    return levy->c * 2 * sin(u) * sqrt(v);
+  }
+  /*
+   * general case
+   *   sin(alpha u) / cos(u)^(1 / alpha) * (cos((1 - alpha) u) / v)^((1 - alpha) / alpha)
+   * with the two powers folded into a single exp()
+   */
+  return levy->c * sin(levy->alpha * u) *
+         exp(levy->exponent * (log(cos((1 - levy->alpha) * u)) - log(v)) -
+             levy->inv_alpha * log(cos(u)));
+}
+
+double rv_levy(double c, double alpha)
+{
+  rv_levy_t levy;
+  rv_levy_init(&levy, c, alpha);
+  return rv_levy_sample(&levy);
+}
+
+double rv_wrapped_cauchy(double rho)
+{
+  return 2 * atan((1.0 - rho) / (1.0 + rho) * tan(M_PI * (rv_uniform() - 0.5)));
+}
+
+void rv_wrapped_cauchy_table_init(rv_wrapped_cauchy_table_t *table, double rho)
+{
+  int i;
+  double k = (1.0 - rho) / (1.0 + rho);
+  table->rho = rho;
+  /* |theta| = 2 atan(k tan(pi v / 2)) for v uniform in [0, 1) */
+  for (i = 0; i < RV_TABLE_SIZE; ++i)
+  {
+    table->angle[i] = 2 * atan(k * tan(M_PI_2 * i / RV_TABLE_SIZE));
+  }
+  /* The limit for v -> 1, unless rho = 1 and the distribution is all on 0 */
+  table->angle[RV_TABLE_SIZE] = (k > 0) ? M_PI : 0;
+}
+
+double rv_wrapped_cauchy_table_sample(const rv_wrapped_cauchy_table_t *table)
+{
+  double v = rv_uniform();
+  double x = v * RV_TABLE_SIZE;
+  int i = (int)x;
+  if (i == RV_TABLE_SIZE - 1)
+  {
+    /* The last interval holds the tail, which is too steep to interpolate */
+    return 2 * atan((1.0 - table->rho) / (1.0 + table->rho) * tan(M_PI_2 * v));
+  }
+  double f = x - i;
+  return table->angle[i] + f * (table->angle[i + 1] - table->angle[i]);
+}
@@ -0,0 +1,200 @@
+/*
+ * Checks the accuracy and the speed of random_variates.c.
+ *
+ * For each case, it draws N samples (10^6 by default, or the first
+ * argument) and prints the time per sample and a Kolmogorov-Smirnov
+ * distance:
+ *   - the Levy sampler against the sampler of distribution_functions.c
+ *     before the module (two powers, rand()), and against the exact CDF
+ *     for alpha = 1 (Cauchy) and alpha = 2 (Gaussian);
+ *   - the wrapped Cauchy table against the exact CDF of |theta|, and its
+ *     time against the exact sampler.
+ * A distance above the critical value at the 1% level is marked with *,
+ * and the program then exits with 1.
+ *
+ * Usage: random_variates_check [N]
+ */
+
+#include "random_variates.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Coefficient of the critical value of the KS distance at the 1% level */
+#define KS_COEFFICIENT_1 1.628
+
+/* random_variates.c seeds from rand_hard(), which kilolib provides in a behavior */
+uint8_t rand_hard()
+{
+  return rand() & 0xFF;
+}
+
+static double now()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x < y) ? -1 : (x > y);
+}
+
+/* The Levy sampler of distribution_functions.c before random_variates.c */
+static double old_uniform()
+{
+  return rand() / ((double)RAND_MAX + 1);
+}
+
+static double old_levy(double c, double alpha)
+{
+  double u = M_PI * (old_uniform() - 0.5);
+  double v;
+  if (alpha == 1)
+  {
+    return c * tan(u);
+  }
+  do
+  {
+    v = -log(1 - old_uniform());
+  } while (v == 0);
+  if (alpha == 2)
+  {
+    return c * 2 * sin(u) * sqrt(v);
+  }
+  return c * sin(alpha * u) / pow(cos(u), 1 / alpha) *
+         pow(cos((1 - alpha) * u) / v, (1 - alpha) / alpha);
+}
+
+/* KS distance of sorted samples to a CDF */
+static double ks_distance(const double *x, int n, double (*cdf)(double, double), double param)
+{
+  double d = 0;
+  int i;
+  for (i = 0; i < n; ++i)
+  {
+    double f = cdf(x[i], param);
+    d = fmax(d, fmax(f - (double)i / n, (double)(i + 1) / n - f));
+  }
+  return d;
+}
+
+/* KS distance between two sorted samples of the same size */
+static double ks_distance_2(const double *x, const double *y, int n)
+{
+  double d = 0;
+  int i = 0, j = 0;
+  while (i < n && j < n)
+  {
+    if (x[i] <= y[j])
+      ++i;
+    else
+      ++j;
+    d = fmax(d, fabs((double)(i - j) / n));
+  }
+  return d;
+}
+
+/* CDF of |levy| for alpha = 1, of scale c */
+static double abs_cauchy_cdf(double x, double c)
+{
+  return 2 / M_PI * atan(x / c);
+}
+
+/* CDF of |levy| for alpha = 2, of scale c: a Gaussian of sigma sqrt(2) c */
+static double abs_gaussian_cdf(double x, double c)
+{
+  return erf(x / (2 * c));
+}
+
+/* CDF of |theta| for the wrapped Cauchy of concentration rho */
+static double abs_wrapped_cauchy_cdf(double theta, double rho)
+{
+  double k = (1 - rho) / (1 + rho);
+  return (k == 0) ? 1 : 2 / M_PI * atan(tan(theta / 2) / k);
+}
+
+int main(int argc, char *argv[])
+{
+  int n = (argc > 1) ? atoi(argv[1]) : 1000000;
+  double *a = malloc(n * sizeof(double));
+  double *b = malloc(n * sizeof(double));
+  double critical_1 = KS_COEFFICIENT_1 / sqrt(n);
+  double critical_2 = KS_COEFFICIENT_1 * sqrt(2.0 / n);
+  double alphas[] = {1, 1.13, 1.5, 1.93, 2};
+  double rhos[] = {0, 0.29, 0.9, 0.96, 0.99};
+  double c = 8;
+  int failed = 0;
+  int i, k;
+  if (n <= 0 || a == NULL || b == NULL)
+  {
+    fprintf(stderr, "Usage: %s [N]\n", argv[0]);
+    return 2;
+  }
+  srand(42);
+  rv_seed(42);
+
+  printf("%d samples per case, critical KS distances at 1%%: %.5f (CDF), %.5f (two samples)\n\n",
+         n, critical_1, critical_2);
+  printf("Levy, c = %g       old ns   new ns   KS old/new   KS exact   |x| q50/q90/q99 old, new\n", c);
+  for (k = 0; k < 5; ++k)
+  {
+    rv_levy_t levy;
+    double t_old, t_new, d_2, d_1 = -1;
+    rv_levy_init(&levy, c, alphas[k]);
+    t_old = now();
+    for (i = 0; i < n; ++i)
+      a[i] = fabs(old_levy(c, alphas[k]));
+    t_old = now() - t_old;
+    t_new = now();
+    for (i = 0; i < n; ++i)
+      b[i] = fabs(rv_levy_sample(&levy));
+    t_new = now() - t_new;
+    qsort(a, n, sizeof(double), compare_doubles);
+    qsort(b, n, sizeof(double), compare_doubles);
+    d_2 = ks_distance_2(a, b, n);
+    failed |= (d_2 > critical_2);
+    if (alphas[k] == 1 || alphas[k] == 2)
+    {
+      d_1 = ks_distance(b, n, (alphas[k] == 1) ? abs_cauchy_cdf : abs_gaussian_cdf, c);
+      failed |= (d_1 > critical_1);
+    }
+    printf("  alpha %-4g        %7.1f  %7.1f   %8.5f%s", alphas[k], t_old * 1e9 / n, t_new * 1e9 / n,
+           d_2, (d_2 > critical_2) ? "*" : " ");
+    if (d_1 >= 0)
+      printf("   %8.5f%s", d_1, (d_1 > critical_1) ? "*" : " ");
+    else
+      printf("   %8s ", "-");
+    printf("   %.3g/%.3g/%.3g, %.3g/%.3g/%.3g\n",
+           a[n / 2], a[n / 10 * 9], a[n / 100 * 99], b[n / 2], b[n / 10 * 9], b[n / 100 * 99]);
+  }
+
+  printf("\nWrapped Cauchy     exact ns table ns   KS table\n");
+  for (k = 0; k < 5; ++k)
+  {
+    rv_wrapped_cauchy_table_t table;
+    double t_exact, t_table, d;
+    rv_wrapped_cauchy_table_init(&table, rhos[k]);
+    t_exact = now();
+    for (i = 0; i < n; ++i)
+      a[i] = fabs(rv_wrapped_cauchy(rhos[k]));
+    t_exact = now() - t_exact;
+    t_table = now();
+    for (i = 0; i < n; ++i)
+      b[i] = rv_wrapped_cauchy_table_sample(&table);
+    t_table = now() - t_table;
+    qsort(b, n, sizeof(double), compare_doubles);
+    d = ks_distance(b, n, abs_wrapped_cauchy_cdf, rhos[k]);
+    failed |= (d > critical_1);
+    printf("  rho %-4g          %7.1f  %7.1f   %8.5f%s\n", rhos[k], t_exact * 1e9 / n, t_table * 1e9 / n,
+           d, (d > critical_1) ? "*" : "");
+  }
+
+  free(a);
+  free(b);
+  return failed;
+}
@@ -80,6 +80,27 @@ struct broadcasting_robot_info broadcasting_robots[25];
 // State of the robot (when using only 2 thresholds and 2 RW states)
 int state = 0;
 
+/* ---------------------------------------------- */
+// Social parameters, tuned by irace through the <behavior_params> of the .argos file
+// sampling 1: 3 RW states chosen by the neighbors count (sampling_neighbors)
+// sampling 2: 2 RW states with hysteresis (sampling_neighbors2)
+int sampling = 2;
+int threshold1 = 4;
+int threshold2 = 1;
+double alpha1 = 1.13;
+double alpha2 = 1.93;
+double alpha3 = 0.0;
+double rho1 = 0.99;
+double rho2 = 0.02;
+double rho3 = 0.0;
+// irace_semantics 1: follow the rules of the social_behavior_base*.c templates
+// the irace scenarios were tuned with: always turn left, by the drawn angle even
+// when it is small, leave state 1 at neighbors_count <= t1, and show the RW state
+// on the LED. The random numbers differ: levy() and wrapped_cauchy_ppf() draw
+// from random_variates.c, not from rand() as in the templates, so runs are
+// equivalent in distribution, not identical to the tuning runs
+int irace_semantics = 0;
+
 /*-------------------------------------------------------------------*/
 /* Function for setting the motor speed                              */
 /*-------------------------------------------------------------------*/
@@ -253,6 +274,14 @@ void random_walk()
             straight_ticks = (uint32_t)(fabs(levy(std_motion_steps, levy_exponent)));
             // printf("turning_ticks : %i\n", turning_ticks);
 
+            if (irace_semantics)
+            {
+                /* Keep the rand_soft() draw of the templates, whose two branches both turn left */
+                rand_soft();
+                set_motion(TURN_LEFT);
+                break;
+            }
+
             if(turning_ticks < turning_ticks_threshold)
             {
                 break;
@@ -298,13 +327,46 @@ void setup()
 #endif
     set_motors(0, 0);
 
+#ifdef ARGOS_SIMULATION
+    /* Read the walk and social parameters */
+    std_motion_steps = 8 * kilo_get_param_double("std", 1);
+    sampling = (int)kilo_get_param_double("sampling", 2);
+    irace_semantics = (int)kilo_get_param_double("irace_semantics", 0);
+    if (sampling == 1)
+    {
+        threshold1 = (int)kilo_get_param_double("t0", 2);
+        threshold2 = (int)kilo_get_param_double("t1", 10);
+        alpha1 = kilo_get_param_double("a0", 1.01);
+        alpha2 = kilo_get_param_double("a1", 1.98);
+        alpha3 = kilo_get_param_double("a2", 1.18);
+        rho1 = kilo_get_param_double("r0", 0.03);
+        rho2 = kilo_get_param_double("r1", 0.07);
+        rho3 = kilo_get_param_double("r2", 0.95);
+    }
+    else
+    {
+        threshold1 = (int)kilo_get_param_double("t0", 4);
+        threshold2 = (int)kilo_get_param_double("t1", 1);
+        alpha1 = kilo_get_param_double("a0", 1.13);
+        alpha2 = kilo_get_param_double("a1", 1.93);
+        rho1 = kilo_get_param_double("r0", 0.99);
+        rho2 = kilo_get_param_double("r1", 0.02);
+    }
+#endif
+
     /* Initialise random seed */
     uint8_t seed = rand_hard();
     rand_seed(seed);
     seed = rand_hard();
     srand(seed);
+    /* Generator of the random walk */
+    rv_seed_hard();
 
-    if (rand_soft() % 2)
+    if (irace_semantics)
+    {
+        pivot = TURN_LEFT;
+    }
+    else if (rand_soft() % 2)
     {
         pivot = TURN_LEFT;
     }
@@ -385,31 +447,23 @@ void sampling_neighbors()
     broadcasting_robots[i].id = 0;
   }
 
-  int threshold1 = 2;
-  int threshold2 = 10;
-  double alpha1 = 1.01;
-  double alpha2 = 1.98;
-  double alpha3 = 1.18;
-  double rho1 = 0.03;
-  double rho2 = 0.07;
-  double rho3 = 0.95;
   if(neighbors_count < threshold1)
   {
     levy_exponent = alpha1;
     crw_exponent = rho1;
-    // set_color(RGB(3, 0, 0));
+    if(irace_semantics) set_color(RGB(3, 0, 0));
   }
   else if(neighbors_count < threshold2)
   {
     levy_exponent = alpha2;
     crw_exponent = rho2;
-    // set_color(RGB(0, 0, 3));
+    if(irace_semantics) set_color(RGB(0, 0, 3));
   }
   else
   {
     levy_exponent = alpha3;
     crw_exponent = rho3;
-    // set_color(RGB(0, 3, 0));
+    if(irace_semantics) set_color(RGB(0, 3, 0));
   }
 
   neighbors_sampling_timer = kilo_ticks + neighbors_sampling_duration;
@@ -426,17 +480,11 @@ void sampling_neighbors2()
     }
     broadcasting_robots[i].id = 0;
   }
-  int threshold1 = 4;
-  int threshold2 = 1;
-  double alpha1 = 1.13;
-  double alpha2 = 1.93;
-  double rho1 = 0.99;
-  double rho2 = 0.02;
   if(state == 0)
   {
     levy_exponent = alpha1;
     crw_exponent = rho1;
-    // set_color(RGB(3, 0, 0));
+    if(irace_semantics) set_color(RGB(3, 0, 0));
     if(neighbors_count >= threshold1)
     {
       state = 1;
@@ -446,8 +494,8 @@ void sampling_neighbors2()
   {
     levy_exponent = alpha2;
     crw_exponent = rho2;
-    // set_color(RGB(0, 0, 3));
-    if(neighbors_count < threshold2)
+    if(irace_semantics) set_color(RGB(0, 0, 3));
+    if(neighbors_count < threshold2 || (irace_semantics && neighbors_count <= threshold2))
     {
       state = 0;
     }
@@ -472,7 +520,14 @@ void loop()
 #endif
     if(neighbors_sampling_timer <= kilo_ticks)
     {
-      sampling_neighbors2();
+      if(sampling == 1)
+      {
+        sampling_neighbors();
+      }
+      else
+      {
+        sampling_neighbors2();
+      }
     }
 
     if (wall_avoidance_start)
@@ -486,7 +541,10 @@ void loop()
         random_walk();
     }
 
-    set_color(RGB(3, 3, 0));
+    if (!irace_semantics)
+    {
+        set_color(RGB(3, 3, 0));
+    }
 }
 
 int main()
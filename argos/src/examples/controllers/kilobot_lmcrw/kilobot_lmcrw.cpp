@@ -0,0 +1,386 @@
+/* Include the controller definition */
+#include "kilobot_lmcrw.h"
+/* Function definitions for XML parsing */
+#include <argos3/core/utility/configuration/argos_configuration.h>
+/* Angles and pi */
+#include <argos3/core/utility/math/angles.h>
+/* Length of the control step */
+#include <argos3/core/simulator/physics_engine/physics_engine.h>
+/* Distance between the wheels */
+#include <argos3/plugins/robots/kilobot/simulator/kilobot_measures.h>
+/* Random number streams of the robots */
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+/****************************************/
+/****************************************/
+
+/* Constants of gradient_follower.c */
+static const UInt8  COLLISION_BITS       = 8;
+static const UInt8  SECTORS_IN_COLLISION = 2;
+static const UInt32 SCALING_STD          = 8;
+static const UInt8  MAX_TURNING_TICKS    = 125; /* a rotation of 180 degrees with omega=pi/5 */
+static const UInt8  SECTOR_BASE          = (1 << (COLLISION_BITS / 2)) - 1;
+static const UInt32 TURNING_TICKS_THRESHOLD = static_cast<UInt32>((0.18 / ARGOS_PI) * MAX_TURNING_TICKS);
+
+/* Constants of kilolib.c */
+static const UInt32 KILO_TICKS_PER_SEC = 31;
+static const Real   KILO_TX_PERIOD     = 100; /* ms */
+
+/****************************************/
+/****************************************/
+
+CKilobotLMCRW::CKilobotLMCRW() :
+   m_pcMotors(NULL),
+   m_pcLED(NULL),
+   m_pcCommA(NULL),
+   m_pcCommS(NULL),
+   m_fLinearVelocity(1),
+   m_fAngularVelocity(45),
+   m_unKiloUID(0),
+   m_unKiloTicks(0),
+   m_fKiloTicksDelta(0),
+   m_fKiloTicksFrac(0),
+   m_fMsDelta(0),
+   m_fTxClock(0),
+   m_unTxState(0),
+   m_eMotion(MOTION_STOP),
+   m_ePivot(MOTION_STOP),
+   m_fStdMotionSteps(8 * 1),
+   m_fLevyExponent(2.0),
+   m_fCRWExponent(0.0),
+   m_unTurningTicks(0),
+   m_unStraightTicks(0),
+   m_unLastMotionTicks(0),
+   m_unProximitySensor(0),
+   m_eFreeSpace(MOTION_TURN_LEFT),
+   m_bWallAvoidanceStart(false),
+   m_eLightSensor(LIGHT_WHITE),
+   m_pcRNG(NULL) {
+   ::memset(&m_tMessage, 0, sizeof(m_tMessage));
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotLMCRW::Init(TConfigurationNode& t_node) {
+   /* Get sensor/actuator handles, the LED and the communication are optional as in kilobot_controller */
+   m_pcMotors = GetActuator<CCI_DifferentialSteeringActuator>("differential_steering");
+   try {
+      m_pcLED   = GetActuator<CCI_KilobotLEDActuator          >("kilobot_led"          );
+   } catch(CARGoSException&) {}
+   try {
+      m_pcCommA = GetActuator<CCI_KilobotCommunicationActuator>("kilobot_communication");
+   } catch(CARGoSException&) {}
+   try {
+      m_pcCommS = GetSensor  <CCI_KilobotCommunicationSensor  >("kilobot_communication");
+   } catch(CARGoSException&) {}
+   /* Parse the configuration file */
+   GetNodeAttributeOrDefault(t_node, "linearvelocity", m_fLinearVelocity, m_fLinearVelocity);
+   GetNodeAttributeOrDefault(t_node, "angularvelocity", m_fAngularVelocity, m_fAngularVelocity);
+   Real fStd = 1;
+   GetNodeAttributeOrDefault(t_node, "std", fStd, fStd);
+   m_fStdMotionSteps = 8 * fStd;
+   /* The uid is the number in the robot id, as in kilolib */
+   const std::string& strId = GetId();
+   size_t unPos = 0;
+   while(unPos < strId.size() && !::isdigit(strId[unPos])) ++unPos;
+   m_unKiloUID = (unPos < strId.size()) ? ::strtoul(strId.c_str() + unPos, NULL, 10) : 0;
+   /* kilo_ticks run at 31 Hz, whatever the length of the control step */
+   m_fKiloTicksDelta = CPhysicsEngine::GetSimulationClockTick() * KILO_TICKS_PER_SEC;
+   m_fMsDelta = m_fKiloTicksDelta / KILO_TICKS_PER_SEC * 1000.0;
+   m_pcRNG = new CKilobotRNG(GetId(), KILOBOT_RNG_BEHAVIOR);
+   Reset();
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotLMCRW::Reset() {
+   /* The random numbers start over, for the seed of the new run */
+   m_pcRNG->Reset();
+   /* The state of the kilolib behavior at the start of main() */
+   m_unKiloTicks = 0;
+   m_fKiloTicksFrac = 0;
+   m_fTxClock = 0;
+   m_unTxState = 0;
+   m_eMotion = MOTION_STOP;
+   m_fLevyExponent = 2.0;
+   m_fCRWExponent = 0.0;
+   m_unTurningTicks = 0;
+   m_unStraightTicks = 0;
+   m_unLastMotionTicks = 0;
+   m_unProximitySensor = 0;
+   m_eFreeSpace = MOTION_TURN_LEFT;
+   m_bWallAvoidanceStart = false;
+   m_eLightSensor = LIGHT_WHITE;
+   /* setup() */
+   ::memset(&m_tMessage, 0, sizeof(m_tMessage));
+   m_tMessage.type = 10;
+   m_tMessage.data[0] = m_unKiloUID;
+   /* The communication medium does not check the CRC */
+   m_cColor = CColor::BLACK;
+   m_ePivot = m_pcRNG->Bernoulli() ? MOTION_TURN_LEFT : MOTION_TURN_RIGHT;
+   SetMotion(MOTION_FORWARD);
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotLMCRW::Destroy() {
+   delete m_pcRNG;
+   m_pcRNG = NULL;
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotLMCRW::ControlStep() {
+   /* Read the sensors and update the clocks, as preloop() */
+   m_fKiloTicksFrac += m_fKiloTicksDelta;
+   m_unKiloTicks += static_cast<UInt32>(m_fKiloTicksFrac);
+   m_fKiloTicksFrac -= static_cast<UInt32>(m_fKiloTicksFrac);
+   if(m_pcCommS && m_pcCommS->MessageSent()) {
+      m_unTxState = 2;
+   }
+   if(m_unTxState != 2) {
+      m_fTxClock += m_fMsDelta;
+   }
+   else {
+      m_unTxState = 0;
+      m_fTxClock = 0;
+   }
+   if(m_pcCommS) {
+      const CCI_KilobotCommunicationSensor::TPackets& tPackets = m_pcCommS->GetPackets();
+      for(size_t i = 0; i < tPackets.size() && i < KILOBOT_MAX_RX; ++i) {
+         ReceiveMessage(*tPackets[i].Message);
+      }
+   }
+   /* loop() */
+   if(m_bWallAvoidanceStart) {
+      WallAvoidance(m_unProximitySensor);
+      m_unProximitySensor = 0;
+      m_bWallAvoidanceStart = false;
+   }
+   else {
+      RandomWalk();
+   }
+   /* Send the presence message, as postloop() */
+   if(m_unTxState == 0 && m_fTxClock > KILO_TX_PERIOD) {
+      m_unTxState = 1;
+   }
+   /* Set the actuators, as the kilobot_controller does with the motors of the robot state */
+   Real fTurnVelocity = ToRadians(CDegrees(m_fAngularVelocity)).GetValue() * KILOBOT_INTERPIN_DISTANCE * 100;
+   switch(m_eMotion) {
+      case MOTION_FORWARD:
+         m_pcMotors->SetLinearVelocity(m_fLinearVelocity, m_fLinearVelocity);
+         break;
+      case MOTION_TURN_LEFT:
+         /* set_motors(kilo_turn_left, 0) */
+         m_pcMotors->SetLinearVelocity(0, fTurnVelocity);
+         break;
+      case MOTION_TURN_RIGHT:
+         /* set_motors(0, kilo_turn_right) */
+         m_pcMotors->SetLinearVelocity(fTurnVelocity, 0);
+         break;
+      case MOTION_STOP:
+      default:
+         m_pcMotors->SetLinearVelocity(0, 0);
+   }
+   if(m_pcLED) {
+      m_pcLED->SetColor(m_cColor);
+   }
+   if(m_pcCommA && m_unTxState == 1) {
+      m_pcCommA->SetMessage(&m_tMessage);
+   }
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotLMCRW::ReceiveMessage(const message_t& t_message) {
+   if(t_message.type != 0) return;
+   /* A message of the ALF addresses three robots */
+   for(UInt8 i = 0; i < 3; ++i) {
+      UInt16 unId = t_message.data[i * 3] << 2 | (t_message.data[i * 3 + 1] >> 6);
+      if(unId == m_unKiloUID) {
+         ParseSmartArenaMessage(t_message.data, i);
+         return;
+      }
+   }
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotLMCRW::ParseSmartArenaMessage(const UInt8* pun_data, UInt8 un_index) {
+   UInt8 unShift = un_index * 3;
+   UInt8 unType = pun_data[unShift + 1] >> 2 & 0x0F;
+   UInt16 unPayload = ((pun_data[unShift + 1] & 0x03) << 8) | pun_data[unShift + 2];
+   m_eLightSensor = static_cast<ELightSensor>(unType);
+   /* Parameters of the 3 bits configuration 3_2679431 */
+   switch(unType) {
+      case LIGHT_BLACK:
+         m_fLevyExponent = 1.96;
+         m_fCRWExponent = 0.29;
+         break;
+      case LIGHT_GRAY:
+      case LIGHT_LIGHTGRAY:
+         m_fLevyExponent = 1.0;
+         m_fCRWExponent = 0.0;
+         break;
+      case LIGHT_WHITE:
+         m_fLevyExponent = 1.0;
+         m_fCRWExponent = 0.96;
+         break;
+      default:
+         break;
+   }
+   if(unPayload != 0) {
+      /* The walls around the robot, to avoid at the next step */
+      m_unProximitySensor = unPayload;
+      m_bWallAvoidanceStart = true;
+   }
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotLMCRW::RandomWalk() {
+   switch(m_eMotion) {
+      case MOTION_TURN_LEFT:
+      case MOTION_TURN_RIGHT:
+         /* If turned for enough time, move forward */
+         if(m_unKiloTicks > m_unLastMotionTicks + m_unTurningTicks) {
+            m_unLastMotionTicks = m_unKiloTicks;
+            SetMotion(MOTION_FORWARD);
+         }
+         break;
+      case MOTION_FORWARD:
+         /* If moved forward for enough time, turn */
+         if(m_unKiloTicks > m_unLastMotionTicks + m_unStraightTicks) {
+            m_unLastMotionTicks = m_unKiloTicks;
+            Real fAngle;
+            if(m_fCRWExponent == 0) {
+               fAngle = m_pcRNG->Uniform(CRange<Real>(0, ARGOS_PI));
+            }
+            else {
+               fAngle = Abs(WrappedCauchy(m_fCRWExponent));
+            }
+            SetLED();
+            m_unStraightTicks = static_cast<UInt32>(Abs(Levy(m_fStdMotionSteps, m_fLevyExponent)));
+            m_unTurningTicks = static_cast<UInt32>((fAngle / ARGOS_PI) * MAX_TURNING_TICKS);
+            if(m_unTurningTicks < TURNING_TICKS_THRESHOLD) {
+               break;
+            }
+            /* Turn the other way round half of the times */
+            if(m_pcRNG->Bernoulli()) {
+               m_unTurningTicks = MAX_TURNING_TICKS * 2 - m_unTurningTicks;
+            }
+            SetMotion(m_ePivot);
+         }
+         break;
+      case MOTION_STOP:
+      default:
+         SetMotion(MOTION_STOP);
+   }
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotLMCRW::WallAvoidance(UInt8 un_sensor_readings) {
+   UInt8 unRightSide = un_sensor_readings & SECTOR_BASE;
+   UInt8 unLeftSide = (un_sensor_readings >> (COLLISION_BITS / 2)) & SECTOR_BASE;
+   UInt8 unCountOnes = 0;
+   for(UInt8 unBits = un_sensor_readings; unBits > 0; unBits >>= 1) {
+      unCountOnes += unBits & 1;
+   }
+   if(unCountOnes > SECTORS_IN_COLLISION) {
+      m_unTurningTicks = static_cast<UInt32>((ARGOS_PI / COLLISION_BITS) * MAX_TURNING_TICKS);
+      if(unRightSide < unLeftSide) {
+         SetMotion(MOTION_TURN_RIGHT);
+         m_eFreeSpace = MOTION_TURN_RIGHT;
+      }
+      else if(unRightSide > unLeftSide) {
+         SetMotion(MOTION_TURN_LEFT);
+         m_eFreeSpace = MOTION_TURN_LEFT;
+      }
+      else {
+         SetMotion(m_eFreeSpace);
+      }
+      if(m_unKiloTicks > m_unLastMotionTicks + m_unTurningTicks) {
+         m_unTurningTicks = static_cast<UInt32>((ARGOS_PI / COLLISION_BITS) * MAX_TURNING_TICKS);
+         m_unStraightTicks = SCALING_STD * static_cast<UInt32>(Abs(Levy(m_fStdMotionSteps, m_fLevyExponent)));
+      }
+   }
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotLMCRW::SetMotion(EMotion e_motion) {
+   /* The motors are set at every step from the motion */
+   m_eMotion = e_motion;
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotLMCRW::SetLED() {
+   /* RGB(r,g,b) of kilolib, with 3 as the full intensity */
+   switch(m_eLightSensor) {
+      case LIGHT_BLACK:
+         m_cColor = CColor(255, 255, 255);
+         break;
+      case LIGHT_GRAY:
+         m_cColor = CColor(255, 0, 255);
+         break;
+      case LIGHT_LIGHTGRAY:
+         m_cColor = CColor(255, 255, 0);
+         break;
+      case LIGHT_WHITE:
+         m_cColor = CColor(0, 0, 0);
+         break;
+      default:
+         break;
+   }
+}
+
+/****************************************/
+/****************************************/
+
+SInt32 CKilobotLMCRW::Levy(Real f_c, Real f_alpha) {
+   /* Chambers-Mallows-Stuck sampling of a symmetric alpha-stable distribution */
+   Real fU = ARGOS_PI * (m_pcRNG->Uniform(CRange<Real>(0, 1)) - 0.5);
+   if(f_alpha == 1) {
+      /* Cauchy */
+      return static_cast<SInt32>(f_c * ::tan(fU));
+   }
+   Real fV;
+   do {
+      fV = -::log(1 - m_pcRNG->Uniform(CRange<Real>(0, 1)));
+   } while(fV == 0);
+   if(f_alpha == 2) {
+      /* Gaussian */
+      return static_cast<SInt32>(f_c * 2 * ::sin(fU) * ::sqrt(fV));
+   }
+   Real fT = ::sin(f_alpha * fU) / ::pow(::cos(fU), 1 / f_alpha);
+   Real fS = ::pow(::cos((1 - f_alpha) * fU) / fV, (1 - f_alpha) / f_alpha);
+   return static_cast<SInt32>(f_c * fT * fS);
+}
+
+/****************************************/
+/****************************************/
+
+Real CKilobotLMCRW::WrappedCauchy(Real f_rho) {
+   Real fU = m_pcRNG->Uniform(CRange<Real>(0, 1));
+   return 2 * ::atan((1 - f_rho) / (1 + f_rho) * ::tan(ARGOS_PI * (fU - 0.5)));
+}
+
+/****************************************/
+/****************************************/
+
+REGISTER_CONTROLLER(CKilobotLMCRW, "kilobot_lmcrw_controller")
@@ -0,0 +1,169 @@
+/*
+ * A native port of the Levy-modulated correlated random walk (LMCRW) of
+ * behaviors/gradient_follower.c.
+ *
+ * Each robot moves straight for a number of ticks drawn from a Levy
+ * distribution of exponent alpha, then turns by an angle drawn from a
+ * wrapped Cauchy distribution of parameter rho. The gradientFollowing ALF
+ * sets alpha and rho by sending to each robot the area it is in, and
+ * signals the walls, which the robot avoids by turning away from them.
+ *
+ * The controller runs the same state machine as the kilolib behavior,
+ * including the timing of kilo_ticks and of the message transmission, but
+ * inside the ARGoS process: there is no behavior process to fork, and no
+ * robot state to exchange through shared memory at every step. The random
+ * numbers come from a stream of the robot (see kilobot_rng.h) instead of
+ * the C library, so the two versions differ run by run, and can only be
+ * compared over many runs, with experiments/batch/lmcrw_equivalence.sh.
+ *
+ * This controller is meant to be used with the XML files:
+ *    experiments/kilobot_ALF_gradientFollower.argos (commented out)
+ *    experiments/batch/lmcrw_equivalence.argos
+ */
+
+#ifndef KILOBOT_LMCRW_H
+#define KILOBOT_LMCRW_H
+
+/* Definition of the CCI_Controller class. */
+#include <argos3/core/control_interface/ci_controller.h>
+/* Definition of the differential steering actuator */
+#include <argos3/plugins/robots/generic/control_interface/ci_differential_steering_actuator.h>
+/* Definitions of the kilobot devices */
+#include <argos3/plugins/robots/kilobot/control_interface/ci_kilobot_led_actuator.h>
+#include <argos3/plugins/robots/kilobot/control_interface/ci_kilobot_communication_actuator.h>
+#include <argos3/plugins/robots/kilobot/control_interface/ci_kilobot_communication_sensor.h>
+/* Random number generator */
+#include <argos3/plugins/robots/kilobot/control_interface/kilobot_rng.h>
+/* Logging functions */
+#include <argos3/core/utility/logging/argos_log.h>
+
+using namespace argos;
+
+class CKilobotLMCRW : public CCI_Controller {
+
+public:
+
+   /* Motion of the robot, with the values of gradient_follower.c */
+   enum EMotion {
+      MOTION_TURN_LEFT  = 1,
+      MOTION_TURN_RIGHT = 2,
+      MOTION_STOP       = 3,
+      MOTION_FORWARD    = 4
+   };
+
+   /* Area of the robot, as sent by the ALF */
+   enum ELightSensor {
+      LIGHT_BLACK     = 0,
+      LIGHT_GRAY      = 1,
+      LIGHT_WHITE     = 2,
+      LIGHT_LIGHTGRAY = 3
+   };
+
+public:
+
+   /* Class constructor. */
+   CKilobotLMCRW();
+
+   /* Class destructor. */
+   virtual ~CKilobotLMCRW() {}
+
+   /*
+    * This function initializes the controller.
+    * The 't_node' variable points to the <params> section in the XML
+    * file in the <controllers><kilobot_lmcrw_controller> section.
+    */
+   virtual void Init(TConfigurationNode& t_node);
+
+   /*
+    * This function is called once every time step.
+    * It runs one iteration of the loop() of the kilolib behavior.
+    */
+   virtual void ControlStep();
+
+   /*
+    * This function resets the controller to its state right after the
+    * Init(), as the setup() of the kilolib behavior.
+    */
+   virtual void Reset();
+
+   /*
+    * This function frees the random number generator of the robot.
+    */
+   virtual void Destroy();
+
+private:
+
+   /* The message callback of the kilolib behavior */
+   void ReceiveMessage(const message_t& t_message);
+
+   /* Reads the area and the walls sent by the ALF to this robot */
+   void ParseSmartArenaMessage(const UInt8* pun_data, UInt8 un_index);
+
+   /* The random walk, in free space */
+   void RandomWalk();
+
+   /* Turns away from the walls signalled by the ALF */
+   void WallAvoidance(UInt8 un_sensor_readings);
+
+   /* Sets the motors, as set_motion() in the kilolib behavior */
+   void SetMotion(EMotion e_motion);
+
+   /* Sets the LED after the area of the robot */
+   void SetLED();
+
+   /* Draws a number of straight ticks, as levy() in distribution_functions.c */
+   SInt32 Levy(Real f_c, Real f_alpha);
+
+   /* Draws a turning angle, as wrapped_cauchy_ppf() in distribution_functions.c */
+   Real WrappedCauchy(Real f_rho);
+
+private:
+
+   /* Pointers to the devices */
+   CCI_DifferentialSteeringActuator* m_pcMotors;
+   CCI_KilobotLEDActuator* m_pcLED;
+   CCI_KilobotCommunicationActuator* m_pcCommA;
+   CCI_KilobotCommunicationSensor* m_pcCommS;
+
+   /* Velocities of the robot, as in the <params> of the kilobot_controller */
+   Real m_fLinearVelocity;
+   Real m_fAngularVelocity;
+
+   /* The kilolib uid of the robot, i.e., the number in its id */
+   UInt16 m_unKiloUID;
+
+   /* kilolib clocks */
+   UInt32 m_unKiloTicks;
+   Real m_fKiloTicksDelta;
+   Real m_fKiloTicksFrac;
+   Real m_fMsDelta;
+   Real m_fTxClock;
+
+   /* Presence message, and its kilolib transmission state (0 = none, 1 = sending, 2 = sent) */
+   message_t m_tMessage;
+   UInt8 m_unTxState;
+
+   /* Random walk */
+   EMotion m_eMotion;
+   EMotion m_ePivot;
+   Real m_fStdMotionSteps;
+   Real m_fLevyExponent;
+   Real m_fCRWExponent;
+   UInt32 m_unTurningTicks;
+   UInt32 m_unStraightTicks;
+   UInt32 m_unLastMotionTicks;
+
+   /* Wall avoidance */
+   UInt8 m_unProximitySensor;
+   EMotion m_eFreeSpace;
+   bool m_bWallAvoidanceStart;
+
+   /* Area of the robot, and the color it shows */
+   ELightSensor m_eLightSensor;
+   CColor m_cColor;
+
+   /* The random number stream of this robot */
+   CKilobotRNG* m_pcRNG;
+};
+
+#endif
@@ -34,7 +34,6 @@ echo "$CONFIGURATION_FILE" | egrep "^$SHARED_DIR" &> /dev/null || exit 1
 ###################################
 # experiment_length is in seconds #
 ###################################
-date_time=`date "+%Y-%m-%d"`
 # experiment_length="2"
 experiment_length="5000"
 RUNS=100
@@ -45,54 +44,27 @@ arena_size="0.7 1 1.25 1.5 1.75"
 
 
 
-for nrob in $numrobots; do
-    for a_size in $arena_size; do
-        for nsocial in $socialrobots; do
-            
-            float1=0.02
-            float_asize=$(echo "$a_size" | bc -l)
-            posdistr=$(echo "$float_asize / 2.0 - $float1" | bc -l)
-
-            echo "The pos distribution is: $posdistr"
-
-            float_nrob=$(echo "$nrob" | bc -l)
-            float_nsocial=$(echo "$nsocial" | bc -l)
-            social_size=$(echo "$float_nrob * $float_nsocial" | bc -l)
-            
-
-            echo "The total robots are: $nrob"
-            echo "The arena size is: $a_size"
-            echo "The social robots are: $social_size"
-
-            param_dir=$res_dir/"heterogeneous#"$date_time"_arenasize#"$(echo "$a_size * 100" | bc -l)"_numrobots#"$nrob"_socialRobots#"$social_size"_seconds#"$experiment_length
-            if [[ ! -e $param_dir ]]; then
-                cmake -E make_directory $param_dir
-            fi
-
-            for it in $(seq 1 $RUNS); do
-                config=`printf 'config_seed%03d.argos' $it`
-                cp $base_config $config
-                sed -i "s|__TIMEEXPERIMENT__|$experiment_length|g" $config
-                sed -i "s|__SEED__|$it|g" $config
-                sed -i "s|__SOCIALROBOTS__|$social_size|g" $config
-                sed -i "s|__NUMROBOTS__|$nrob|g" $config
-                sed -i "s|__ARENASIZE__|$a_size|g" $config
-                sed -i "s|__POSDISTR__|$posdistr|g" $config
-
-                robot_positions_file="seed#${it}_kiloLOG.tsv"
-                echo $robot_positions_file
-                sed -i "s|__ROBPOSOUTPUT__|$robot_positions_file|g" $config
-
-
-
-                echo "Running next configuration seed $it with $social_size  social robots"
-                echo "argos3 -c $1$config"
-                argos3 -c './'$config
-
+# kilobot_batch loads the plugins once per worker, replaces the placeholders
+# of the template for each run, and writes seed#<seed>_kiloLOG.tsv in the
+# directory of each configuration. It runs JOBS workers, one per core by
+# default. MEMORY, if set, limits each run, the simulator and its behaviors
+# together, to MEMORY MiB: a run that goes over it is killed and reported as
+# failed. Run the script again to resume an interrupted sweep: the completed
+# runs are in the manifest of $res_dir.
+kilobot_batch=$wdir/build/examples/batch_runner/kilobot_batch
+if [ ! -x $kilobot_batch ]; then
+    echo "Error: missing '$kilobot_batch', build the examples first" 1>&2
+    exit 1
+fi
 
-                mv *.tsv $param_dir
-                rm *.argos
-            done
-        done
-    done
-done
+$kilobot_batch \
+    --seeds 1-$RUNS \
+    --robots ${numrobots// /,} \
+    --arena-sizes ${arena_size// /,} \
+    --social ${socialrobots// /,} \
+    --length $experiment_length \
+    --results $res_dir \
+    --prefix heterogeneous \
+    --jobs ${JOBS:-0} \
+    ${MEMORY:+--run-memory $MEMORY} \
+    $base_config
@@ -45,23 +45,8 @@ echo "$t1"
 echo "$a0"
 
 #here modify params
-base_cfileconfig=src/examples/behaviors/social_behavior_base2.c
-cfileconfig=src/examples/behaviors/social_behavior.c
-
-cp $base_cfileconfig $cfileconfig
-
-sed -i "s|__std__|$std|g" $cfileconfig
-sed -i "s|__t0__|$t0|g" $cfileconfig
-sed -i "s|__t1__|$t1|g" $cfileconfig
-sed -i "s|__a0__|$a0|g" $cfileconfig
-sed -i "s|__a1__|$a1|g" $cfileconfig
-sed -i "s|__r0__|$r0|g" $cfileconfig
-sed -i "s|__r1__|$r1|g" $cfileconfig
-
-cd build
-cmake ../src
-make
-cd ..
+# social_behavior reads them with kilo_get_param(): build it once, before starting irace
+behavior_params="sampling=\"2\" irace_semantics=\"1\" std=\"$std\" t0=\"$t0\" t1=\"$t1\" a0=\"$a0\" a1=\"$a1\" r0=\"$r0\" r1=\"$r1\""
 
 numrobots="25"
 
@@ -72,32 +57,29 @@ experiment_length="3600"
 RUNS=1
 
 
-param_dir=$res_dir/"temp"
-# param_dir=$res_dir/"irace_behavior2_config_10"
-
-if [[ ! -e $param_dir ]]; then
-    cmake -E make_directory $param_dir
-fi
+# irace runs several candidates at once: each run writes its configuration
+# and its logs in its own directory, named after the candidate and the
+# instance that target-runner exports, and removes only that directory
+param_dir=`mktemp -d "$res_dir/c${IRACE_CONFIG_ID:-0}-i${IRACE_INSTANCE_ID:-0}-s${SEED}.XXXXXX"` || exit 1
+trap 'rm -rf "$param_dir"' EXIT
 
 for it in $(seq 1 $RUNS); do
 
-    config=`printf 'config_seed%03d.argos' $it`
+    config=$param_dir/`printf 'config_seed%03d.argos' $it`
     cp $base_config $config
     sed -i "s|__TIMEEXPERIMENT__|$experiment_length|g" $config
     sed -i "s|__SEED__|$SEED|g" $config
     sed -i "s|__NUMROBOTS__|$numrobots|g" $config
+    sed -i "s|__BEHAVIORPARAMS__|$behavior_params|g" $config
 
-    robot_positions_file="seed#${it}_kiloLOG.tsv"
+    robot_positions_file="$param_dir/seed#${it}_kiloLOG.tsv"
     sed -i "s|__ROBPOSOUTPUT__|$robot_positions_file|g" $config
 
-    argos3 -c './'$config
-
-    mv *.tsv $param_dir
-    rm *.argos
+    argos3 -c $config
 done
 
 #call the python script to output something
-python_output=$(python3.8 plots/irace_metric.py)
+python_output=$(python3.8 plots/irace_metric.py "$param_dir/seed#1_kiloLOG.tsv")
 echo "$python_output"
 
 cd tuning
@@ -0,0 +1,67 @@
+#!/bin/bash
+
+### How it works for me ###
+# in ARGoS folder run the following:
+# ./src/examples/experiments/batch/lmcrw_equivalence.sh /src/examples/experiments/batch lmcrw_equivalence.argos
+#
+# Runs the same seeds with the LMCRW of behaviors/gradient_follower.c, as a
+# behavior process, and with its native port, controllers/kilobot_lmcrw,
+# then compares the metrics of the trajectories in the KiloLOGs with
+# plots/lmcrw_equivalence.py, by equivalence tests (TOST) with a margin of
+# MARGIN (0.1 by default) times the mean of the behavior process runs. The
+# script fails unless every metric is shown equivalent. With few runs the
+# tests may lack power: check the power column before adding RUNS.
+
+if [ "$#" -ne 2 ]; then
+    echo "Usage: lmcrw_equivalence.sh (from src folder) <config_dir> <argos_fileName>"
+    exit 11
+fi
+
+wdir=`pwd`
+base_config=.$1/$2
+if [ ! -e $base_config ]; then
+    base_config=$wdir$1/$2
+    if [ ! -e $base_config ]; then
+        echo "Error: missing configuration file '$base_config'" 1>&2
+        exit 1
+    fi
+fi
+
+res_dir=$wdir/"results/lmcrw_equivalence"
+if [[ ! -e $res_dir ]]; then
+    cmake -E make_directory $res_dir
+fi
+
+###################################
+# experiment_length is in seconds #
+###################################
+experiment_length="1800"
+RUNS=30
+numrobots="25"
+arena_size="1"
+
+kilobot_batch=$wdir/build/examples/batch_runner/kilobot_batch
+if [ ! -x $kilobot_batch ]; then
+    echo "Error: missing '$kilobot_batch', build the examples first" 1>&2
+    exit 1
+fi
+
+for controller in gradient_follower gradient_follower_native; do
+    $kilobot_batch \
+        --seeds 1-$RUNS \
+        --robots $numrobots \
+        --arena-sizes $arena_size \
+        --length $experiment_length \
+        --results $res_dir/$controller \
+        --prefix lmcrw \
+        --jobs ${JOBS:-0} \
+        ${MEMORY:+--run-memory $MEMORY} \
+        -D CONTROLLER=$controller \
+        $base_config || exit 1
+done
+
+python3 plots/lmcrw_equivalence.py \
+    $res_dir/gradient_follower/lmcrw#* \
+    $res_dir/gradient_follower_native/lmcrw#* \
+    --margin ${MARGIN:-0.1} \
+    --output $res_dir/lmcrw_equivalence.pdf
@@ -0,0 +1,91 @@
+#!/bin/bash
+
+### How it works for me ###
+# in ARGoS folder run the following:
+# ./src/examples/experiments/batch/medium_benchmark.sh /src/examples/experiments/batch medium_benchmark.argos
+#
+# Every configuration keeps the density at 100 kilobots per square meter,
+# so the number of neighbors per robot does not change with the swarm size.
+# The ticks per second include the whole simulation loop, so compare runs
+# made on the same machine with the same behavior. Each kilobot runs in its
+# own process, so 10000 robots might need a higher 'ulimit -u'.
+#
+# The table below does NOT come from this script. It is a stand-in
+# micro-benchmark of CKilobotCommunicationMedium::Update() alone, built
+# against stub ARGoS headers: no physics, no controllers, no behavior
+# processes. The robots move by a small random step, transmit every 5
+# ticks and retry until they succeed, at the same density, on 1 thread,
+# g++ 12 -O2, median of 7 runs (3 for the baseline). It shows how the
+# medium scales, not the ticks per second this script measures.
+#
+#   medium updates per second
+#   robots   baseline   flat grid   counter-based streams
+#   100         2128       64880         93170
+#   1000         168        5116          7138
+#   10000        4.7         437           542
+#
+# baseline: the medium before the grid, flat grid: c2dd933, counter-based
+# streams: the queued transmitters with the per-robot streams of
+# kilobot_rng.h.
+
+if [ "$#" -ne 2 ]; then
+    echo "Usage: medium_benchmark.sh (from src folder) <config_dir> <argos_fileName>"
+    exit 11
+fi
+
+wdir=`pwd`
+base_config=.$1/$2
+echo "base_config:" $base_config
+if [ ! -e $base_config ]; then
+    base_config=$wdir$1/$2
+    if [ ! -e $base_config ]; then
+        echo "Error: missing configuration file '$base_config'" 1>&2
+        exit 1
+    fi
+fi
+
+res_dir=$wdir/"results/medium_benchmark"
+if [[ ! -e $res_dir ]]; then
+    cmake -E make_directory $res_dir
+fi
+
+###################################
+# experiment_length is in seconds #
+###################################
+date_time=`date "+%Y-%m-%d"`
+experiment_length="100"
+ticks_per_second="10"
+RUNS=3
+
+numrobots="100 1000 10000"
+
+res_file=$res_dir/"medium_benchmark#"$date_time".tsv"
+echo -e "robots\tarena_size\tseed\tseconds\tticks_per_second" > $res_file
+
+for nrob in $numrobots; do
+    a_size=$(echo "sqrt($nrob / 100)" | bc -l)
+    posdistr=$(echo "$a_size / 2.0 - 0.02" | bc -l)
+
+    for it in $(seq 1 $RUNS); do
+        config=`printf 'config_seed%03d.argos' $it`
+        cp $base_config $config
+        sed -i "s|__TIMEEXPERIMENT__|$experiment_length|g" $config
+        sed -i "s|__SEED__|$it|g" $config
+        sed -i "s|__NUMROBOTS__|$nrob|g" $config
+        sed -i "s|__ARENASIZE__|$a_size|g" $config
+        sed -i "s|__POSDISTR__|$posdistr|g" $config
+
+        echo "Running $nrob robots, seed $it"
+        start=`date +%s.%N`
+        argos3 -c './'$config -z
+        end=`date +%s.%N`
+
+        seconds=$(echo "$end - $start" | bc -l)
+        ticks=$(echo "$experiment_length * $ticks_per_second" | bc -l)
+        tps=$(echo "$ticks / $seconds" | bc -l)
+        printf "%d\t%.3f\t%d\t%.3f\t%.1f\n" $nrob $a_size $it $seconds $tps >> $res_file
+        rm $config
+    done
+done
+
+echo "Results in $res_file"
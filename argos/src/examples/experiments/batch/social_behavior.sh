@@ -63,6 +63,7 @@ for it in $(seq 1 $RUNS); do
     sed -i "s|__TIMEEXPERIMENT__|$experiment_length|g" $config
     sed -i "s|__SEED__|$it|g" $config
     sed -i "s|__NUMROBOTS__|$numrobots|g" $config
+    sed -i "s|__BEHAVIORPARAMS__||g" $config
 
     robot_positions_file="seed#${it}_kiloLOG.tsv"
     echo $robot_positions_file
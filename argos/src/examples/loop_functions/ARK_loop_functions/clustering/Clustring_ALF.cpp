@@ -106,10 +106,14 @@ void CClusteringALF::GetExperimentVariables(TConfigurationNode& t_tree){
 /****************************************/
 /****************************************/
 
-void CClusteringALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
+void CClusteringALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity,
+                                        UInt16 un_kilobot_index){
     /* Update the state of the kilobots (inside or outside the clustering hub)*/
-    UInt16 unKilobotID=GetKilobotId(c_kilobot_entity);
-    CVector2 cKilobotPosition=GetKilobotPosition(c_kilobot_entity);
+    UInt16 unKilobotID=GetKilobotId(un_kilobot_index);
+    /* The snapshot holds the positions only when they are tracked */
+    CVector2 cKilobotPosition=m_bPositionTracking ?
+        CVector2(m_vecKilobotsX[un_kilobot_index],m_vecKilobotsY[un_kilobot_index]) :
+        GetKilobotPosition(c_kilobot_entity);
     Real fDistance = Distance(cKilobotPosition, m_sClusteringHub.Center);
     if(fDistance<(m_sClusteringHub.Radius*0.9)){
         m_vecKilobotStates[unKilobotID]=INSIDE_CLUSTERING_HUB;
@@ -122,13 +126,14 @@ void CClusteringALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
 /****************************************/
 /****************************************/
 
-void CClusteringALF::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
+void CClusteringALF::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity,
+                                         UInt16 un_kilobot_index){
     /*Create ARK-type messages variables*/
-    m_tALFKilobotMessage tKilobotMessage,tEmptyMessage,tMessage;
+    m_tALFKilobotMessage tKilobotMessage;
     /* Flag for existance of message to send*/
     bool bMessageToSend=false;
     /* Get the kilobot ID and state (Only Position in this example) */
-    UInt16 unKilobotID=GetKilobotId(c_kilobot_entity);
+    UInt16 unKilobotID=GetKilobotId(un_kilobot_index);
     /* check if enough time has passed from the last message otherwise*/
     if (m_fTimeInSeconds - m_vecLastTimeMessaged[unKilobotID]< m_fMinTimeBetweenTwoMsg){
         return; // if the time is too short, the kilobot cannot receive a message
@@ -137,6 +142,7 @@ void CClusteringALF::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
         /*  Prepare the inividual kilobot's message */
         tKilobotMessage.m_sID = unKilobotID;
         tKilobotMessage.m_sType = (int)m_vecKilobotStates[unKilobotID];
+        tKilobotMessage.m_sData = 0;
         /*  Set the message sending flag to True */
         bMessageToSend=true;
         m_vecLastTimeMessaged[unKilobotID] = m_fTimeInSeconds;
@@ -144,38 +150,18 @@ void CClusteringALF::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
 
     /* Send the message to the kilobot using the ARK messaging protocol (addressing 3 kilobots per one standard kilobot message)*/
     if(bMessageToSend){
-        for (int i = 0; i < 9; ++i) {
-            m_tMessages[unKilobotID].data[i]=0;
-        }
-        // Prepare an empty ARK-type message to fill the gap in the full kilobot message
-        tEmptyMessage.m_sID=1023;
-        tEmptyMessage.m_sType=0;
-        tEmptyMessage.m_sData=0;
-        // Fill the kilobot message by the ARK-type messages
-        for (int i = 0; i < 3; ++i) {
-            if( i == 0){
-                tMessage = tKilobotMessage;
-            } else{
-                tMessage = tEmptyMessage;
-            }
-            m_tMessages[unKilobotID].data[i*3] = (tMessage.m_sID >> 2);
-            m_tMessages[unKilobotID].data[1+i*3] = (tMessage.m_sID << 6);
-            m_tMessages[unKilobotID].data[1+i*3] = m_tMessages[unKilobotID].data[1+i*3] | (tMessage.m_sType << 2);
-            m_tMessages[unKilobotID].data[1+i*3] = m_tMessages[unKilobotID].data[1+i*3] | (tMessage.m_sData >> 8);
-            m_tMessages[unKilobotID].data[2+i*3] = tMessage.m_sData;
-        }
-        /* Sending the message */
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
+        /* CALF packs the queued messages three by three */
+        QueueARKMessage(c_kilobot_entity,tKilobotMessage);
     }
     else{
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,NULL);
+        GetKilobotMedium().SendOHCMessageTo(c_kilobot_entity,NULL);
     }
 }
 
 /****************************************/
 /****************************************/
 
-CColor CClusteringALF::GetFloorColor(const CVector2 &vec_position_on_plane) {
+CColor CClusteringALF::ComputeFloorColor(const CVector2 &vec_position_on_plane) {
     CColor cColor=CColor::WHITE;
     Real fDistance = Distance(vec_position_on_plane,m_sClusteringHub.Center);
     if(fDistance<m_sClusteringHub.Radius){
@@ -97,21 +97,23 @@ void CCommunicationALF::GetExperimentVariables(TConfigurationNode& t_tree){
 /****************************************/
 /****************************************/
 
-void CCommunicationALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
+void CCommunicationALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity,
+                                           UInt16 un_kilobot_index){
     
 }
 
 /****************************************/
 /****************************************/
 
-void CCommunicationALF::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
+void CCommunicationALF::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity,
+                                            UInt16 un_kilobot_index){
     
 }
 
 /****************************************/
 /****************************************/
 
-CColor CCommunicationALF::GetFloorColor(const CVector2 &vec_position_on_plane) {
+CColor CCommunicationALF::ComputeFloorColor(const CVector2 &vec_position_on_plane) {
     CColor cColor=CColor::WHITE;
     Real fDistance = Distance(vec_position_on_plane,m_sClusteringHub.Center);
     if(fDistance<m_sClusteringHub.Radius){
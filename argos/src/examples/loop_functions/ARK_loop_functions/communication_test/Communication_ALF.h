@@ -92,14 +92,16 @@ public:
 
 
     /** Get the message to send to a Kilobot according to its position */
-    void UpdateKilobotState(CKilobotEntity& c_kilobot_entity);
+    void UpdateKilobotState(CKilobotEntity& c_kilobot_entity,
+                            UInt16 un_kilobot_index);
 
 
     /** Get the message to send to a Kilobot according to its position */
-    void UpdateVirtualSensor(CKilobotEntity& c_kilobot_entity);
+    void UpdateVirtualSensor(CKilobotEntity& c_kilobot_entity,
+                             UInt16 un_kilobot_index);
 
     /** Used to plot the Virtual environment on the floor */
-    virtual CColor GetFloorColor(const CVector2& vec_position_on_plane);
+    virtual CColor ComputeFloorColor(const CVector2& vec_position_on_plane);
 
 private:
 
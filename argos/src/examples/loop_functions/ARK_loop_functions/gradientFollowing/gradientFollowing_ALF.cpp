@@ -11,6 +11,7 @@
  */
 
 #include "gradientFollowing_ALF.h"
+#include <cstring>
 
 namespace
 {
@@ -22,45 +23,26 @@ namespace
     const UInt32 MAX_PLACE_TRIALS = 100;
 
     // wall avoidance params
-    const CVector2 up_direction(0.0, -1.0);
-    const CVector2 down_direction(0.0, 1.0);
-    const CVector2 left_direction(1.0, 0.0);
-    const CVector2 right_direction(-1.0, 0.0);
     const int kProximity_bits = 8;
+    const double kProximity_range = 2.0 * kKiloDiameter;
 
     // log time counter
     int internal_counter = 0;
 
-    typedef enum
-    {
-        CONTINUOUS = 0,
-        DISCRETE = 1,
-        NO_BACKGROUND = 2
-    } Background;
-
-    typedef enum
-    {
-        BITS_2 = 2,
-        BITS_3 = 3,
-        BITS_4 = 4
-    } Discretization;
-
-    Background background_flag = DISCRETE;
-    Discretization discret_bits = BITS_3;
-
-    const Real MAX_VAL = 1.0;
-    const Real NUM_SYMBOLS = Real(discret_bits);
     Real overall_gradient = 0.0;
-    Real gradient_radius = 0.5;
 }
 
 /****************************************/
 /****************************************/
 
-GradientFollowingCALF::GradientFollowingCALF() : m_unDataAcquisitionFrequency(10),
-                                                 generator(), distribution(0.0, 0.1)
+GradientFollowingCALF::GradientFollowingCALF() : m_strKiloLogFormat("tsv"),
+                                                 m_unKiloLogCapacity(1024),
+                                                 m_eKiloLogOverflow(CKilobotAsyncLog::OVERFLOW_BLOCK),
+                                                 m_unGradientLevels(3),
+                                                 m_eBackground(DISCRETE),
+                                                 m_cWallProximity(kProximity_bits),
+                                                 m_unDataAcquisitionFrequency(10)
 {
-    c_rng = CRandom::CreateRNG("argos");
 }
 
 /****************************************/
@@ -70,15 +52,25 @@ void GradientFollowingCALF::Init(TConfigurationNode &t_node)
 {
     std::cout<< "Init\n";
 
+    /* The counters outlive the loop functions when a batch runs several experiments in a process */
+    internal_counter = 0;
+    overall_gradient = 0.0;
+
     /* Initialize ALF*/
     CALF::Init(t_node);
-    random_seed = GetSimulator().GetRandomSeed();
+    if(!m_bPositionTracking || !m_bOrientationTracking)
+    {
+        THROW_ARGOSEXCEPTION("The gradient following ALF needs position and orientation tracking");
+    }
 
     /*********** LOG FILES *********/
-    m_kiloOutput.open(m_strKiloOutputFileName, std::ios_base::trunc | std::ios_base::out);
-
-
-    
+    m_pcKiloLog.reset(CKiloLog::Create(m_strKiloLogFormat));
+    OpenKiloLOG();
+    /* PostStep() only copies the snapshot: the log is formatted and written by another thread */
+    m_cKiloLogQueue.Start(m_cKiloLogSink,
+                          1 + 4 * m_tKilobotEntities.size(),
+                          m_unKiloLogCapacity,
+                          m_eKiloLogOverflow);
 }
 
 /****************************************/
@@ -86,9 +78,17 @@ void GradientFollowingCALF::Init(TConfigurationNode &t_node)
 
 void GradientFollowingCALF::Reset()
 {
-    m_kiloOutput.close();
-    m_kiloOutput.open(m_strKiloOutputFileName, std::ios_base::trunc | std::ios_base::out);
-
+    internal_counter = 0;
+    overall_gradient = 0.0;
+    /* Restart the generators, for the seed of the new run */
+    for (UInt32 i = 0; i < m_vecKilobotRNGs.size(); i++)
+    {
+        m_vecKilobotRNGs[i]->Reset();
+    }
+    /* Write the records of the previous run before reopening the file */
+    m_cKiloLogQueue.Flush();
+    m_pcKiloLog->Close();
+    OpenKiloLOG();
 }
 
 /****************************************/
@@ -96,7 +96,18 @@ void GradientFollowingCALF::Reset()
 
 void GradientFollowingCALF::Destroy()
 {
-    m_kiloOutput.close();
+    for (UInt32 i = 0; i < m_vecKilobotRNGs.size(); i++)
+    {
+        delete m_vecKilobotRNGs[i];
+    }
+    m_vecKilobotRNGs.clear();
+    if (m_pcKiloLog)
+    {
+        /* The log is closed and deleted even if stopping the writer throws */
+        std::unique_ptr<CKiloLog> pcKiloLog(std::move(m_pcKiloLog));
+        m_cKiloLogQueue.Stop();
+        pcKiloLog->Close();
+    }
 }
 
 /****************************************/
@@ -120,16 +131,20 @@ void GradientFollowingCALF::SetupInitialKilobotStates()
 {
     std::cout<< "SetupInitialKilobotStates\n";
     /* Resize variables related to the number of Kilobots */
-    m_vecKilobotsPositions.resize(m_tKilobotEntities.size());
     m_vecKilobotsLightSensors.resize(m_tKilobotEntities.size());
-    m_vecKilobotsOrientations.resize(m_tKilobotEntities.size());
+    m_vecKilobotsGradient.resize(m_tKilobotEntities.size());
     m_vecLastTimeMessaged.resize(m_tKilobotEntities.size());
+    /* Each robot has its own generator, so the noise does not depend on the order of the robots */
+    m_vecKilobotRNGs.resize(m_tKilobotEntities.size());
+    for (UInt32 i = 0; i < m_tKilobotEntities.size(); i++)
+    {
+        m_vecKilobotRNGs[i] = new CKilobotRNG(m_tKilobotEntities[i]->GetId(), KILOBOT_RNG_LOOP_FUNCTION);
+    }
     m_fMinTimeBetweenTwoMsg = Max<Real>(1.0, m_tKilobotEntities.size() * m_fTimeForAMessage / 3.0);
 
     if(socialRobots > m_tKilobotEntities.size())
     {
-        std::cerr << "Asked to many social robots\n";
-        exit(-1);
+        THROW_ARGOSEXCEPTION("Asked for " << socialRobots << " social robots, but there are only " << m_tKilobotEntities.size() << " robots");
     }
 
     /* Setup the min time between two message sent to a kilobot (ARK message sending limits)*/
@@ -177,6 +192,34 @@ void GradientFollowingCALF::SetupVirtualEnvironments(TConfigurationNode &t_tree)
     // std::cout << std::endl << "cornerProportion: " << cornerProportion << std::endl << std::endl;
     std::cout << std::endl << "socialRobots: " << socialRobots << std::endl << std::endl;
 
+    /* Get the gradient field, by default a radial field of radius 0.5 in the center */
+    m_cGradientField.SetRadial(CVector2(0.0, 0.0), 0.5);
+    if (NodeExists(t_tree, "gradient_field"))
+    {
+        TConfigurationNode &tGradientFieldNode = GetNode(t_tree, "gradient_field");
+        CVector3 arena_center = GetSpace().GetArenaCenter();
+        CVector3 arena_size = GetSpace().GetArenaSize();
+        m_cGradientField.Init(tGradientFieldNode,
+                              CVector2(arena_center.GetX(), arena_center.GetY()),
+                              CVector2(arena_size.GetX(), arena_size.GetY()));
+        /* Number of light levels sent to the robots and drawn on the floor */
+        GetNodeAttributeOrDefault(tGradientFieldNode, "levels", m_unGradientLevels, m_unGradientLevels);
+        if (m_unGradientLevels < 2 || m_unGradientLevels > 4)
+        {
+            THROW_ARGOSEXCEPTION("The gradient field must have 2, 3 or 4 levels, not " << m_unGradientLevels);
+        }
+        std::string strBackground("discrete");
+        GetNodeAttributeOrDefault(tGradientFieldNode, "background", strBackground, strBackground);
+        if (strBackground == "continuous")
+            m_eBackground = CONTINUOUS;
+        else if (strBackground == "discrete")
+            m_eBackground = DISCRETE;
+        else if (strBackground == "none")
+            m_eBackground = NO_BACKGROUND;
+        else
+            THROW_ARGOSEXCEPTION("Unknown background \"" << strBackground << "\", use \"continuous\", \"discrete\" or \"none\"");
+    }
+
     /**
      * 
      *  CREATION AND POSITIONING OF THE ARENA WALLS
@@ -186,6 +229,7 @@ void GradientFollowingCALF::SetupVirtualEnvironments(TConfigurationNode &t_tree)
 
     unsigned int cornerWalls = 20;
     cornerRadius = cornerProportion * Min(arena_size[0],arena_size[1]);
+    m_cArenaBoundary.Set(CVector2(0.0, 0.0), CVector2(arena_size[0], arena_size[1]), cornerRadius);
 
     CQuaternion wall_orientation;
     wall_orientation.FromEulerAngles(CRadians::ZERO, CRadians::ZERO, CRadians::ZERO );
@@ -230,7 +274,6 @@ void GradientFollowingCALF::PlaceBots(CVector3 arenaSize, double cornerRadius) {
     CVector3 cPosition;
     CQuaternion cOrientation;
     cPosition.SetZ(0.0);
-    CRandom::CRNG* m_pcRNG = CRandom::CreateRNG("argos");
     unsigned int unTrials;
     CKilobotEntity* pcKB;
     for(unsigned int i=0; i<m_tKilobotEntities.size(); ++i) {
@@ -238,14 +281,16 @@ void GradientFollowingCALF::PlaceBots(CVector3 arenaSize, double cornerRadius) {
         unTrials = 0;
         
         pcKB = m_tKilobotEntities[i];
+        /* The placement of a robot comes from its own stream: only the robots placed before it can make it retry */
+        CKilobotRNG cRNG(pcKB->GetId(), KILOBOT_RNG_PLACEMENT);
         do {
-            double x = m_pcRNG->Uniform(CRange<Real>(-1.0 * vDistance_threshold, vDistance_threshold));
-            double y = m_pcRNG->Uniform(CRange<Real>(-1.0 * vDistance_threshold, vDistance_threshold));
+            double x = cRNG.Uniform(CRange<Real>(-1.0 * vDistance_threshold, vDistance_threshold));
+            double y = cRNG.Uniform(CRange<Real>(-1.0 * vDistance_threshold, vDistance_threshold));
             if(abs(x)<arenaSize[0]/2.0-cornerRadius or abs(y)<arenaSize[1]/2.0-cornerRadius or Distance(CVector3(abs(x),abs(y),0),CVector3(arenaSize[0]/2.0-cornerRadius,arenaSize[1]/2.0-cornerRadius,0))<cornerRadius) {
                 cPosition.SetX(x);
                 cPosition.SetY(y);
 
-                CRadians cRandomOrientation = CRadians(m_pcRNG->Uniform(CRange<Real>(-CRadians::PI.GetValue(), CRadians::PI.GetValue())));
+                CRadians cRandomOrientation = CRadians(cRNG.Uniform(CRange<Real>(-CRadians::PI.GetValue(), CRadians::PI.GetValue())));
                 cOrientation.FromEulerAngles(cRandomOrientation, CRadians::ZERO, CRadians::ZERO);
 
                 bDone = MoveEntity(pcKB->GetEmbodiedEntity(), cPosition, cOrientation);
@@ -270,6 +315,13 @@ void GradientFollowingCALF::GetExperimentVariables(TConfigurationNode &t_tree)
 
     // /* Get the output datafile name and open it */
     GetNodeAttribute(tExperimentVariablesNode, "kilo_filename", m_strKiloOutputFileName);
+    /* Get the format of the log: "tsv" or "binary" (see kilo_log.h) */
+    GetNodeAttributeOrDefault(tExperimentVariablesNode, "kilo_format", m_strKiloLogFormat, m_strKiloLogFormat);
+    /* Get the number of records the asynchronous log holds, and what to do when it is full: "block" or "drop" */
+    GetNodeAttributeOrDefault(tExperimentVariablesNode, "log_capacity", m_unKiloLogCapacity, m_unKiloLogCapacity);
+    std::string strKiloLogOverflow("block");
+    GetNodeAttributeOrDefault(tExperimentVariablesNode, "log_overflow", strKiloLogOverflow, strKiloLogOverflow);
+    m_eKiloLogOverflow = CKilobotAsyncLog::ParseOverflowPolicy(strKiloLogOverflow);
     // std::cout<< "Filename: " << m_strKiloOutputFileName << std::endl;
 
     /* Get the frequency of data saving */
@@ -281,241 +333,161 @@ void GradientFollowingCALF::GetExperimentVariables(TConfigurationNode &t_tree)
 /****************************************/
 /****************************************/
 
-CVector2 GradientFollowingCALF::VectorRotation2D(Real angle, CVector2 vec)
+Real GradientFollowingCALF::addNoise(Real value, UInt32 un_index)
 {
-    Real kx = (cos(angle) * vec.GetX()) + (-1.0 * sin(angle) * vec.GetY());
-    Real ky = (sin(angle) * vec.GetX()) + (cos(angle) * vec.GetY());
-    CVector2 rotated_vector(kx, ky);
-    return rotated_vector;
+        Real noise = m_vecKilobotRNGs[un_index]->Gaussian(0.1);
+        value += noise;
+        return (value > 0.0f) ? ( (value < 1.0f) ? value : 1.0f) : 0.0f;
 }
 
 /****************************************/
 /****************************************/
 
-std::vector<int> GradientFollowingCALF::Proximity_sensor(CVector2 obstacle_direction, Real kOrientation, int num_sectors)
+bool GradientFollowingCALF::UpdateVirtualSensorsBatch(std::vector<m_tALFKilobotMessage> &vec_messages)
 {
-    double sector = M_PI_2 / (num_sectors / 2.0);
-    std::vector<int> proximity_values;
+    const size_t unNumKilobots = m_tKilobotEntities.size();
 
-    for (int i = 0; i < num_sectors; i++)
+    /* Gradient value of the whole swarm, read from the CALF snapshot */
+    for (size_t i = 0; i < unNumKilobots; i++)
     {
-        CVector2 sector_dir_start = VectorRotation2D((kOrientation + M_PI_2 - i * sector), left_direction);
-        CVector2 sector_dir_end = VectorRotation2D((kOrientation + M_PI_2 - (i + 1) * sector), left_direction);
+        m_vecKilobotsGradient[i] = m_cGradientField.GetValue(m_vecKilobotsX[i], m_vecKilobotsY[i]);
+    }
 
-        if (obstacle_direction.DotProduct(sector_dir_start) >= 0.0 || obstacle_direction.DotProduct(sector_dir_end) >= 0.0)
-        {
-            proximity_values.push_back(0);
-        }
-        else
+    for (size_t i = 0; i < unNumKilobots; i++)
+    {
+        UInt16 unKilobotID = GetKilobotId(i);
+        m_vecKilobotsLightSensors[unKilobotID] = m_vecKilobotsGradient[i];
+        overall_gradient += m_vecKilobotsGradient[i];
+
+        /* check if enough time has passed from the last message */
+        if (m_fTimeInSeconds - m_vecLastTimeMessaged[unKilobotID] < m_fMinTimeBetweenTwoMsg)
         {
-            proximity_values.push_back(1);
+            continue;
         }
-    }
 
-    return proximity_values;
+        vec_messages[i].m_sID = unKilobotID;
+        vec_messages[i].m_sType = GradientToLightSensor(m_vecKilobotsGradient[i]);
+        vec_messages[i].m_sData = 0;
+
+        /* check for robot collisions with walls */
+        /* To turn off the wall avoidance comment the following line */
+        vec_messages[i].m_sData = WallProximity(m_vecKilobotsX[i], m_vecKilobotsY[i], m_vecKilobotsYaw[i]);
+    }
+    /* CALF packs the messages three by three */
+    return true;
 }
 
 /****************************************/
 /****************************************/
 
-void GradientFollowingCALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity)
+UInt8 GradientFollowingCALF::GradientToLightSensor(Real gradient)
 {
-    UInt16 unKilobotID = GetKilobotId(c_kilobot_entity);
-    // std::cout << "unKilobotID: "  << unKilobotID << " controller:" 
-    //           << (unKilobotID < socialRobots ? "soc" : "env") << std::endl;
-    // std::cout << "unKilobotID: "  << unKilobotID << std::endl;
-    m_vecKilobotsPositions[unKilobotID] = GetKilobotPosition(c_kilobot_entity);
-    m_vecKilobotsOrientations[unKilobotID] = GetKilobotOrientation(c_kilobot_entity);
+    int symbol = static_cast<int>(gradient * m_unGradientLevels); // 0, 1, 2, 3
+
+    if (symbol <= 0)
+    {
+        return kBLACK;
+    }
+    else if (symbol == 1 && m_unGradientLevels > 2)
+    {
+        return kGRAY;
+    }
+    else if (symbol == 2 && m_unGradientLevels > 3)
+    {
+        return kLIGHTGRAY;
+    }
+    return kWHITE;
 }
 
 /****************************************/
 /****************************************/
 
-Real GradientFollowingCALF::addNoise(Real value)
+UInt8 GradientFollowingCALF::WallProximity(Real x, Real y, Real orientation)
 {
-        float noise = distribution(generator);
-        value += noise;
-        return (value > 0.0f) ? ( (value < 1.0f) ? value : 1.0f) : 0.0f;
+    /* 8 bit proximity sensor as decimal, 0 away from the walls */
+    return m_cWallProximity.GetMask(m_cArenaBoundary, CVector2(x, y), orientation, kProximity_range);
 }
 
-/****************************************/
-/****************************************/
-
-void GradientFollowingCALF::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity)
+void GradientFollowingCALF::OpenKiloLOG()
 {
-    /* Create ARK-type messages variables */
-    m_tALFKilobotMessage tKilobotMessage, tEmptyMessage, tMessage;
-
-    /* Flag for existence of message to send */
-    bool bMessageToSend = true;
-
-    /* Get the kilobot ID and state (Position and Orientation in this example*/
-    UInt16 unKilobotID = GetKilobotId(c_kilobot_entity);
-    tKilobotMessage.m_sID = unKilobotID;
-    tKilobotMessage.m_sData = 0;
-
-    // std::cout << "unKilobotID " << unKilobotID << " c_kilobot_entity.GetId(): " << c_kilobot_entity.GetId() << std::endl;
-    // std::cout<< "Tograyscale " << m_vecKilobotsLightSensors[unKilobotID].ToGrayScale() << std::endl;
-
-    Real fDistance = Distance(m_vecKilobotsPositions[unKilobotID], CVector2(0.0, 0.0));
-    Real headindIndex = fDistance/(gradient_radius);
-
-    // Real headindIndex1 = addNoise(headindIndex);
-    // Real headindIndex1 = headindIndex;
-    // Real symbol1 = static_cast<int>(((headindIndex1 * NUM_SYMBOLS) / MAX_VAL)); // 0, 1, 2, 3
-
-    Real symbol = static_cast<int>(((headindIndex * NUM_SYMBOLS) / MAX_VAL)); // 0, 1, 2, 3
-
-    // std::cout << unKilobotID << " symbol " << symbol << std::endl;
-    // std::cout << unKilobotID << " gradient " << headindIndex << " symbol " << symbol << std::endl;
-    // std::cout << unKilobotID << " noise gradient " << headindIndex1 << " symbol1 " << symbol1 << std::endl << std::endl;
-
-    m_vecKilobotsLightSensors[unKilobotID] = headindIndex;
-    overall_gradient += headindIndex;
-
-    if (symbol == 0.0)
-    {
-        tKilobotMessage.m_sType = kBLACK;
-    }
-    else if (symbol == 1.0 && Real(discret_bits) > 2)
+    /* One record per kilobot, sorted by ID */
+    std::vector<CKiloLog::SColumn> vecColumns;
+    vecColumns.push_back(CKiloLog::SColumn("x", 8));
+    vecColumns.push_back(CKiloLog::SColumn("y", 8));
+    vecColumns.push_back(CKiloLog::SColumn("orientation", 6));
+    vecColumns.push_back(CKiloLog::SColumn("light", 8));
+    std::vector<CKiloLog::SRobot> vecRobots;
+    std::vector<UInt16> vecIndices;
+    for (size_t kID = 0; kID < m_vecKilobotsLightSensors.size(); kID++)
     {
-        tKilobotMessage.m_sType = kGRAY;
+        vecRobots.push_back(CKiloLog::SRobot(kID, kID < socialRobots));
+        /* The log is sorted by kilobot ID, the snapshot by index */
+        vecIndices.push_back(GetKilobotIndex(kID));
     }
-    else if (symbol == 2.0 && Real(discret_bits) > 3)
-    {
-        tKilobotMessage.m_sType = kLIGHTGRAY;
-    }
-    else
-    {
-        tKilobotMessage.m_sType = kWHITE;
-    }
-    
-    // std::cout << unKilobotID << " sending " << tKilobotMessage.m_sType << std::endl << std::endl;
-    /* check for robot collisions with walls */
-    UInt8 proximity_sensor_dec = 0; // 8 bit proximity sensor as decimal
+    m_pcKiloLog->Open(m_strKiloOutputFileName, vecColumns, vecRobots);
+    m_cKiloLogSink.SetKiloLog(m_pcKiloLog.get(), vecIndices);
+}
+
+/****************************************/
+/****************************************/
 
-    if (m_fTimeInSeconds - m_vecLastTimeMessaged[unKilobotID] < m_fMinTimeBetweenTwoMsg)
+void GradientFollowingCALF::KiloLOG()
+{
+    Real *pfRecord = m_cKiloLogQueue.BeginRecord();
+    if (pfRecord == NULL)
     {
+        /* The log is full and drops the records */
         return;
     }
+    const size_t unNumKilobots = m_tKilobotEntities.size();
+    pfRecord[0] = m_fTimeInSeconds;
+    /* The light of a kilobot is its gradient value */
+    ::memcpy(pfRecord + 1, m_vecKilobotsX.data(), unNumKilobots * sizeof(Real));
+    ::memcpy(pfRecord + 1 + unNumKilobots, m_vecKilobotsY.data(), unNumKilobots * sizeof(Real));
+    ::memcpy(pfRecord + 1 + 2 * unNumKilobots, m_vecKilobotsYaw.data(), unNumKilobots * sizeof(Real));
+    ::memcpy(pfRecord + 1 + 3 * unNumKilobots, m_vecKilobotsGradient.data(), unNumKilobots * sizeof(Real));
+    m_cKiloLogQueue.CommitRecord();
+}
 
-    if (fabs(m_vecKilobotsPositions[unKilobotID].GetX()) > vDistance_threshold ||
-        fabs(m_vecKilobotsPositions[unKilobotID].GetY()) > vDistance_threshold)
-    {
-        // if(unKilobotID == 6)
-        //     std::cout<< "kID:" << unKilobotID << "\n";
-
-        std::vector<int> proximity_vec;
-        if (m_vecKilobotsPositions[unKilobotID].GetX() > vDistance_threshold)
-        {
-            // if (unKilobotID == 6)
-            //     std::cout << "---RIGHT\n";
-            proximity_vec = Proximity_sensor(right_direction, m_vecKilobotsOrientations[unKilobotID].GetValue(), kProximity_bits);
-        }
-        else if (m_vecKilobotsPositions[unKilobotID].GetX() < -1.0 * vDistance_threshold)
-        {
-            // if (unKilobotID == 6)
-            //     std::cout << "---LEFT\n";
-            proximity_vec = Proximity_sensor(left_direction, m_vecKilobotsOrientations[unKilobotID].GetValue(), kProximity_bits);
-        }
+/****************************************/
+/****************************************/
 
-        else
-        {
-            if (m_vecKilobotsPositions[unKilobotID].GetY() > vDistance_threshold)
-            {
-                // if (unKilobotID == 6)
-                //     std::cout << "---UP\n";
-                proximity_vec = Proximity_sensor(up_direction, m_vecKilobotsOrientations[unKilobotID].GetValue(), kProximity_bits);
-            }
-            else if (m_vecKilobotsPositions[unKilobotID].GetY() < -1.0 * vDistance_threshold)
-            {
-                // if (unKilobotID == 6)
-                //     std::cout << "---DOWN\n";
-                proximity_vec = Proximity_sensor(down_direction, m_vecKilobotsOrientations[unKilobotID].GetValue(), kProximity_bits);
-            }
-        }
-        // if (unKilobotID == 6)
-        // {
-        //     std::cout << "\t";
-        //     for(auto bit : proximity_vec){
-        //         std::cout << bit;
-        //     }
-        //     std::cout << std::endl;
-        // }
-        proximity_sensor_dec = std::accumulate(proximity_vec.begin(), proximity_vec.end(), 0, [](int x, int y)
-                                                   { return (x << 1) + y; });
-        /* To turn off the wall avoidance decomment the following line */
-        // proximity_sensor_dec = 0;
-
-        tKilobotMessage.m_sData = proximity_sensor_dec;
-    }
+void GradientFollowingCALF::CKiloLogSink::SetKiloLog(CKiloLog *pc_kilo_log,
+                                                    const std::vector<UInt16> &vec_indices)
+{
+    m_pcKiloLog = pc_kilo_log;
+    m_vecIndices = vec_indices;
+    m_vecValues.resize(4 * vec_indices.size());
+}
 
-    /* Send the message to the kilobot using the ARK messaging protocol (addressing 3 kilobots per one standard kilobot message)*/
-    if (bMessageToSend)
-    {
-        // std::cout << "Sending message to kID " << unKilobotID << "\n";
-        // std::cout << "m_sID " << tKilobotMessage.m_sID << "\n";
-        // std::cout << "m_sType " << tKilobotMessage.m_sType << "\n";
-        // std::cout << "m_sData " << tKilobotMessage.m_sData << "\n";
+/****************************************/
+/****************************************/
 
-        for (int i = 0; i < 9; ++i)
-        {
-            m_tMessages[unKilobotID].data[i] = 0;
-        }
-        // Prepare an empty ARK-type message to fill the gap in the full kilobot message
-        tEmptyMessage.m_sID = 1023;
-        tEmptyMessage.m_sType = 0;
-        tEmptyMessage.m_sData = 0;
-        // Fill the kilobot message by the ARK-type messages
-        for (int i = 0; i < 3; ++i)
-        {
-            if (i == 0)
-            {
-                tMessage = tKilobotMessage;
-            }
-            else
-            {
-                tMessage = tEmptyMessage;
-            }
-            m_tMessages[unKilobotID].data[i * 3] = (tMessage.m_sID >> 2);
-            m_tMessages[unKilobotID].data[1 + i * 3] = (tMessage.m_sID << 6);
-            m_tMessages[unKilobotID].data[1 + i * 3] = m_tMessages[unKilobotID].data[1 + i * 3] | (tMessage.m_sType << 2);
-            m_tMessages[unKilobotID].data[1 + i * 3] = m_tMessages[unKilobotID].data[1 + i * 3] | (tMessage.m_sData >> 8);
-            m_tMessages[unKilobotID].data[2 + i * 3] = tMessage.m_sData;
-        }
-        /* Sending the message */
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity, &m_tMessages[unKilobotID]);
-    }
-    else
+void GradientFollowingCALF::CKiloLogSink::Write(const Real *pf_record)
+{
+    const size_t unNumKilobots = m_vecIndices.size();
+    const Real *pfX = pf_record + 1;
+    const Real *pfY = pfX + unNumKilobots;
+    const Real *pfYaw = pfY + unNumKilobots;
+    const Real *pfLight = pfYaw + unNumKilobots;
+    size_t unValue = 0;
+    for (size_t i = 0; i < unNumKilobots; i++)
     {
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity, NULL);
+        UInt16 unIndex = m_vecIndices[i];
+        m_vecValues[unValue++] = pfX[unIndex];
+        m_vecValues[unValue++] = pfY[unIndex];
+        m_vecValues[unValue++] = pfYaw[unIndex];
+        m_vecValues[unValue++] = pfLight[unIndex];
     }
+    m_pcKiloLog->Write(pf_record[0], m_vecValues);
 }
 
-void GradientFollowingCALF::KiloLOG()
+/****************************************/
+/****************************************/
+
+void GradientFollowingCALF::CKiloLogSink::Flush()
 {
-    // std::cout << std::noshowpos << std::setw(4) << std::setprecision(0) << std::setfill('0')
-    //           << m_fTimeInSeconds << '\t';
-    m_kiloOutput
-        << std::noshowpos << std::setw(4) << std::setprecision(0) << std::setfill('0')
-        << m_fTimeInSeconds << '\t';
-    for (size_t kID = 0; kID < m_vecKilobotsPositions.size(); kID++)
-    {
-        m_kiloOutput
-            // << std::noshowpos
-            << std::noshowpos << std::setw(2) << std::setprecision(0) << std::setfill('0')
-            << kID << '\t'
-            << (kID < socialRobots ? "soc" : "env") << '\t'
-            << std::internal << std::showpos << std::setw(8) << std::setprecision(4) << std::setfill('0') << std::fixed
-            << m_vecKilobotsPositions[kID].GetX() << '\t'
-            << std::internal << std::showpos << std::setw(8) << std::setprecision(4) << std::setfill('0') << std::fixed
-            << m_vecKilobotsPositions[kID].GetY() << '\t'
-            << std::internal << std::showpos << std::setw(6) << std::setprecision(4) << std::setfill('0') << std::fixed
-            << m_vecKilobotsOrientations[kID].GetValue() << '\t'
-            << std::internal << std::showpos << std::setw(8) << std::setprecision(4) << std::setfill('0') << std::fixed
-            << m_vecKilobotsLightSensors[kID] << '\t';
-    }
-    m_kiloOutput << std::endl;
+    m_pcKiloLog->Flush();
 }
 
 /****************************************/
@@ -523,6 +495,8 @@ void GradientFollowingCALF::KiloLOG()
 
 void GradientFollowingCALF::PostExperiment()
 {
+    /* The experiment may end here: get the log to the disk */
+    m_cKiloLogQueue.Flush();
     std::cout << "num robots: " << m_tKilobotEntities.size() << std::endl;
     std::cout << "num social robots: " << socialRobots << std::endl;
     std::cout << "exp length: " << m_fTimeInSeconds << std::endl;
@@ -531,72 +505,39 @@ void GradientFollowingCALF::PostExperiment()
 
 /****************************************/
 /****************************************/
-CColor GradientFollowingCALF::GetFloorColor(const CVector2 &vec_position_on_plane)
+CColor GradientFollowingCALF::ComputeFloorColor(const CVector2 &vec_position_on_plane)
 {
     Real fPositionX(vec_position_on_plane.GetX()), fPositionY(vec_position_on_plane.GetY());
     CColor cColor = CColor::WHITE;
 
-    CVector2 gradient_pos = CVector2(0.0, 0.0);
-    Real max_distance = gradient_radius;
+    Real gradient = m_cGradientField.GetValue(vec_position_on_plane);
 
-    Real fDistance = Distance(vec_position_on_plane, gradient_pos);
-
-    switch (background_flag)
+    switch (m_eBackground)
     {
     case CONTINUOUS:
-        if (fDistance < max_distance)
+        if (gradient < 1.0)
         {
-            Real col = 255.0 * (fDistance / max_distance);
+            Real col = 255.0 * Max(gradient, 0.0);
             cColor = CColor(col, col, col, 1);
         }
         break;
 
     case DISCRETE:
-        
-        switch (discret_bits)
+        /* The levels of GradientToLightSensor() */
+        switch (GradientToLightSensor(gradient))
         {
-        case BITS_2:
-            if (fDistance <= max_distance * 1.0 / 2.0)
-            {
-                cColor = CColor::BLACK;
-            }
+        case kBLACK:
+            cColor = CColor::BLACK;
             break;
-
-        case BITS_3:
-            if (fDistance <= max_distance * 2.0 / 3.0 && fDistance > max_distance * 1.0 / 3.0)
-            {
-                cColor = CColor::GRAY30;
-            }
-            if (fDistance <= max_distance * 1.0 / 3.0)
-            {
-                cColor = CColor::BLACK;
-            }
+        case kGRAY:
+            cColor = CColor::GRAY30;
             break;
-
-        case BITS_4:
-            if (fDistance <= max_distance * 3.0 / 4.0 && fDistance > max_distance * 2.0 / 4.0)
-            {
-                cColor = CColor::GRAY60;
-            }
-
-            if (fDistance <= max_distance * 2.0 / 4.0 && fDistance > max_distance * 1.0 / 4.0)
-            {
-                cColor = CColor::GRAY30;
-            }
-
-            else if (fDistance <= max_distance * 1.0 / 4.0)
-            {
-                cColor = CColor::BLACK;
-            }
+        case kLIGHTGRAY:
+            cColor = CColor::GRAY60;
             break;
-
         default:
             break;
         }
-
-
-
-        
         break;
 
     case NO_BACKGROUND:
@@ -31,6 +31,7 @@ typedef enum
 
 #include <math.h>
 #include <bitset>
+#include <memory>
 #include <numeric>
 
 #include <argos3/core/simulator/loop_functions.h>
@@ -54,14 +55,19 @@ typedef enum
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_communication_entity.h>
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_communication_medium.h>
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_communication_default_actuator.h>
+#include <argos3/plugins/robots/kilobot/simulator/kilobot_wall_proximity.h>
+#include <argos3/plugins/robots/kilobot/simulator/kilobot_virtual_field.h>
+#include <argos3/plugins/robots/kilobot/simulator/kilobot_async_log.h>
+
+#include "kilo_log.h"
 
 // kilobot messaging
 #include <argos3/plugins/robots/kilobot/control_interface/kilolib.h>
 #include <argos3/plugins/robots/kilobot/control_interface/message_crc.h>
 #include <argos3/plugins/robots/kilobot/control_interface/message.h>
+#include <argos3/plugins/robots/kilobot/control_interface/kilobot_rng.h>
 
 #include <array>
-#include <random>
 #include <algorithm>
 using namespace argos;
 
@@ -102,69 +108,121 @@ public:
     /** Get experiment variables */
     void GetExperimentVariables(TConfigurationNode &t_tree);
 
-    /** Get the message to send to a Kilobot according to its position */
-    void UpdateKilobotState(CKilobotEntity &c_kilobot_entity);
+    /** Add Gaussian noise to the sensor reading of the Kilobot of index un_index in m_tKilobotEntities */
+    Real addNoise(Real value, UInt32 un_index);
 
-    /** Get the sensor reading to send to a Kilobot according to its position */
-    Real addNoise(Real value);
+    /** Get the messages to send to all the Kilobots according to their positions */
+    virtual bool UpdateVirtualSensorsBatch(std::vector<m_tALFKilobotMessage> &vec_messages);
 
-    /** Get the message to send to a Kilobot according to its position */
-    void UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity);
+    /** Light sensor reading corresponding to a gradient value */
+    UInt8 GradientToLightSensor(Real gradient);
 
-    /** Used to plot the Virtual environment on the floor */
-    virtual CColor GetFloorColor(const CVector2 &vec_position_on_plane);
+    /** Proximity sensor reading of a Kilobot close to the walls, as decimal */
+    UInt8 WallProximity(Real x, Real y, Real orientation);
 
-    /** 2D vector rotation */
-    CVector2 VectorRotation2D(Real angle, CVector2 vec);
+    /** Used to plot the Virtual environment on the floor */
+    virtual CColor ComputeFloorColor(const CVector2 &vec_position_on_plane);
 
-    /** Simulate proximity sensor*/
-    std::vector<int> Proximity_sensor(CVector2 obstacle_direction, Real kOrientation, int num_sectors);
+    /** Open the log of the Kilobot poses and states */
+    void OpenKiloLOG();
 
-    /** Log Kilobot pose and state */
+    /** Log Kilobot pose and state (the record is written by the thread of the asynchronous log) */
     void KiloLOG();
 
     
 
+private:
+    /**
+     * Writes the records of the asynchronous log in the KiloLOG.
+     * A record holds the time, then the x, the y, the orientation and the light
+     * of all the Kilobots, each sorted by index in m_tKilobotEntities.
+     */
+    class CKiloLogSink : public CKilobotAsyncLog::CSink
+    {
+
+    public:
+        CKiloLogSink() : m_pcKiloLog(NULL) {}
+
+        /**
+         * Sets the KiloLOG
+         * @param pc_kilo_log The KiloLOG
+         * @param vec_indices The index in the records of each Kilobot, in the order of the KiloLOG
+         */
+        void SetKiloLog(CKiloLog *pc_kilo_log,
+                        const std::vector<UInt16> &vec_indices);
+
+        virtual void Write(const Real *pf_record);
+
+        virtual void Flush();
+
+    private:
+        CKiloLog *m_pcKiloLog;
+        std::vector<UInt16> m_vecIndices;
+        std::vector<Real> m_vecValues;
+    };
+
 private:
     /************************************/
     /*  Virtual Environment variables   */
     /************************************/
 
-    /** virtual environment struct*/
-    struct Gradient
+    /** Ways to draw the gradient on the floor */
+    typedef enum
     {
-        CVector2 CenterPos;
-    };
+        CONTINUOUS = 0,
+        DISCRETE = 1,
+        NO_BACKGROUND = 2
+    } Background;
 
     /***********************************/
     /*      Experiment variables       */
     /***********************************/
-    /* random number generator */
-    CRandom::CRNG *c_rng;
-    UInt32 random_seed;
+    /* Random number generators of the virtual sensors, by index in m_tKilobotEntities */
+    std::vector<CKilobotRNG*> m_vecKilobotRNGs;
 
     /* Send a right amount of messages for each time-step*/
     std::vector<Real> m_vecLastTimeMessaged;
     Real m_fMinTimeBetweenTwoMsg;
 
     /* output LOG files */
-    std::ofstream m_kiloOutput;
     std::string m_strKiloOutputFileName;
+    std::string m_strKiloLogFormat;
+    /* Declared before the asynchronous log, which writes to it, so it is deleted after */
+    std::unique_ptr<CKiloLog> m_pcKiloLog;
+    /* The sink must outlive the asynchronous log */
+    CKiloLogSink m_cKiloLogSink;
+    CKilobotAsyncLog m_cKiloLogQueue;
+    /* Number of records the asynchronous log holds, and what to do when it is full */
+    UInt32 m_unKiloLogCapacity;
+    CKilobotAsyncLog::EOverflowPolicy m_eKiloLogOverflow;
 
     /** Size of social robots */
     unsigned int socialRobots;
 
-    /* Kilobots properties */
-    std::vector<CVector2> m_vecKilobotsPositions;
-    std::vector<CRadians> m_vecKilobotsOrientations;
+    /* Kilobots properties (the positions and orientations are in the CALF snapshot) */
     std::vector<Real> m_vecKilobotsLightSensors;
 
-    /** Gradient field radius */
-    Real m_fGradientFieldRadius;
+    /* Gradient value of the Kilobots, by index in m_tKilobotEntities */
+    std::vector<Real> m_vecKilobotsGradient;
+
+    /** Gradient field, 0 at the target of the robots (<gradient_field> in the .argos file) */
+    CKilobotVirtualField m_cGradientField;
+
+    /** Number of light levels of the gradient: 2, 3 or 4 */
+    UInt32 m_unGradientLevels;
+
+    /** How the gradient is drawn on the floor */
+    Background m_eBackground;
 
     /** Circular corner radius  */
     double cornerRadius;
 
+    /** Shape of the arena, with the rounded corners */
+    CKilobotRoundedRectangleBoundary m_cArenaBoundary;
+
+    /** Simulated proximity sensor for wall avoidance */
+    CKilobotWallProximity m_cWallProximity;
+
     /** output file for data acquisition */
     std::ofstream m_cOutput;
 
@@ -174,9 +232,6 @@ private:
     /** data acquisition frequency in ticks */
     UInt16 m_unDataAcquisitionFrequency;
 
-    std::default_random_engine generator;
-    std::normal_distribution<Real> distribution;
-
 };
 
 #endif
@@ -0,0 +1,280 @@
+/**
+ * @file <kilo_log.cpp>
+ *
+ * @brief This is the source file of the loggers of the kilobot states (KiloLOG).
+ */
+
+#include "kilo_log.h"
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <cstring>
+#include <iomanip>
+
+namespace
+{
+    const char KILOLOG_MAGIC[8] = {'K', 'I', 'L', 'O', 'L', 'O', 'G', '\0'};
+
+    template <typename T>
+    void WriteBinary(std::ostream &c_stream, const T &t_value)
+    {
+        c_stream.write(reinterpret_cast<const char *>(&t_value), sizeof(T));
+    }
+
+    template <typename T>
+    void ReadBinary(std::istream &c_stream, T &t_value)
+    {
+        c_stream.read(reinterpret_cast<char *>(&t_value), sizeof(T));
+    }
+}
+
+/****************************************/
+/****************************************/
+
+const UInt32 CKiloLogBinary::VERSION;
+const size_t CKiloLogBinary::BUFFER_SIZE;
+
+/****************************************/
+/****************************************/
+
+CKiloLog *CKiloLog::Create(const std::string &str_format)
+{
+    if (str_format == "tsv")
+    {
+        return new CKiloLogTSV();
+    }
+    if (str_format == "binary")
+    {
+        return new CKiloLogBinary();
+    }
+    THROW_ARGOSEXCEPTION("Unknown KiloLOG format \"" << str_format << "\", use \"tsv\" or \"binary\"");
+}
+
+/****************************************/
+/****************************************/
+
+CKiloLogTSV::CKiloLogTSV() : m_pcStream(NULL) {}
+
+/****************************************/
+/****************************************/
+
+CKiloLogTSV::CKiloLogTSV(std::ostream &c_stream) : m_pcStream(&c_stream) {}
+
+/****************************************/
+/****************************************/
+
+void CKiloLogTSV::Open(const std::string &str_file_name,
+                       const std::vector<SColumn> &vec_columns,
+                       const std::vector<SRobot> &vec_robots)
+{
+    Close();
+    m_cFile.open(str_file_name.c_str(), std::ios_base::trunc | std::ios_base::out);
+    if (!m_cFile)
+    {
+        THROW_ARGOSEXCEPTION("Opening the KiloLOG file \"" << str_file_name << "\"");
+    }
+    m_pcStream = &m_cFile;
+    SetLayout(vec_columns, vec_robots);
+}
+
+/****************************************/
+/****************************************/
+
+void CKiloLogTSV::SetLayout(const std::vector<SColumn> &vec_columns,
+                            const std::vector<SRobot> &vec_robots)
+{
+    m_vecColumns = vec_columns;
+    m_vecRobots = vec_robots;
+}
+
+/****************************************/
+/****************************************/
+
+void CKiloLogTSV::Write(Real f_time,
+                        const std::vector<Real> &vec_values)
+{
+    /* The stream keeps its flags from a row to the next, as the analysis scripts expect */
+    std::ostream &cOut = *m_pcStream;
+    cOut << std::noshowpos << std::setw(4) << std::setprecision(0) << std::setfill('0')
+         << f_time << '\t';
+    size_t unValue = 0;
+    for (size_t i = 0; i < m_vecRobots.size(); i++)
+    {
+        cOut << std::noshowpos << std::setw(2) << std::setprecision(0) << std::setfill('0')
+             << m_vecRobots[i].Id << '\t'
+             << (m_vecRobots[i].Social ? "soc" : "env") << '\t';
+        for (size_t j = 0; j < m_vecColumns.size(); j++)
+        {
+            cOut << std::internal << std::showpos << std::setw(m_vecColumns[j].Width) << std::setprecision(4) << std::setfill('0') << std::fixed
+                 << vec_values[unValue++] << '\t';
+        }
+    }
+    /* No flush: the stream buffers the rows */
+    cOut << '\n';
+}
+
+/****************************************/
+/****************************************/
+
+void CKiloLogTSV::Flush()
+{
+    if (m_pcStream != NULL)
+    {
+        m_pcStream->flush();
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CKiloLogTSV::Close()
+{
+    if (m_cFile.is_open())
+    {
+        m_cFile.close();
+    }
+    m_pcStream = NULL;
+}
+
+/****************************************/
+/****************************************/
+
+void CKiloLogBinary::Open(const std::string &str_file_name,
+                          const std::vector<SColumn> &vec_columns,
+                          const std::vector<SRobot> &vec_robots)
+{
+    Close();
+    m_vecColumns = vec_columns;
+    m_vecRobots = vec_robots;
+    /* The buffer must be set before the file is opened */
+    m_vecBuffer.resize(BUFFER_SIZE);
+    m_cFile.rdbuf()->pubsetbuf(&m_vecBuffer[0], m_vecBuffer.size());
+    m_cFile.open(str_file_name.c_str(), std::ios_base::trunc | std::ios_base::out | std::ios_base::binary);
+    if (!m_cFile)
+    {
+        THROW_ARGOSEXCEPTION("Opening the KiloLOG file \"" << str_file_name << "\"");
+    }
+    /* Header */
+    m_cFile.write(KILOLOG_MAGIC, sizeof(KILOLOG_MAGIC));
+    WriteBinary<UInt32>(m_cFile, VERSION);
+    WriteBinary<UInt32>(m_cFile, m_vecRobots.size());
+    WriteBinary<UInt32>(m_cFile, m_vecColumns.size());
+    for (size_t i = 0; i < m_vecColumns.size(); i++)
+    {
+        UInt8 unLength = std::min<size_t>(m_vecColumns[i].Name.size(), 255);
+        WriteBinary<UInt8>(m_cFile, unLength);
+        m_cFile.write(m_vecColumns[i].Name.data(), unLength);
+        WriteBinary<UInt8>(m_cFile, m_vecColumns[i].Width);
+    }
+    for (size_t i = 0; i < m_vecRobots.size(); i++)
+    {
+        WriteBinary<UInt16>(m_cFile, m_vecRobots[i].Id);
+        WriteBinary<UInt8>(m_cFile, m_vecRobots[i].Social ? 1 : 0);
+    }
+    m_vecRow.resize(1 + m_vecRobots.size() * m_vecColumns.size());
+}
+
+/****************************************/
+/****************************************/
+
+void CKiloLogBinary::Write(Real f_time,
+                           const std::vector<Real> &vec_values)
+{
+    m_vecRow[0] = f_time;
+    for (size_t i = 1; i < m_vecRow.size(); i++)
+    {
+        m_vecRow[i] = vec_values[i - 1];
+    }
+    m_cFile.write(reinterpret_cast<const char *>(&m_vecRow[0]), m_vecRow.size() * sizeof(float));
+}
+
+/****************************************/
+/****************************************/
+
+void CKiloLogBinary::Flush()
+{
+    m_cFile.flush();
+}
+
+/****************************************/
+/****************************************/
+
+void CKiloLogBinary::Close()
+{
+    if (m_cFile.is_open())
+    {
+        m_cFile.close();
+    }
+}
+
+/****************************************/
+/****************************************/
+
+UInt32 CKiloLogBinary::ConvertToTSV(const std::string &str_input_file_name,
+                                    std::ostream &c_output)
+{
+    std::ifstream cInput(str_input_file_name.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!cInput)
+    {
+        THROW_ARGOSEXCEPTION("Opening the KiloLOG file \"" << str_input_file_name << "\"");
+    }
+    /* Header */
+    char pchMagic[sizeof(KILOLOG_MAGIC)];
+    UInt32 unVersion = 0, unNumRobots = 0, unNumColumns = 0;
+    cInput.read(pchMagic, sizeof(pchMagic));
+    ReadBinary(cInput, unVersion);
+    ReadBinary(cInput, unNumRobots);
+    ReadBinary(cInput, unNumColumns);
+    if (!cInput || ::memcmp(pchMagic, KILOLOG_MAGIC, sizeof(KILOLOG_MAGIC)) != 0)
+    {
+        THROW_ARGOSEXCEPTION("\"" << str_input_file_name << "\" is not a binary KiloLOG file");
+    }
+    if (unVersion != VERSION)
+    {
+        THROW_ARGOSEXCEPTION("\"" << str_input_file_name << "\" has version " << unVersion << " of the binary KiloLOG format, expected " << VERSION);
+    }
+    std::vector<SColumn> vecColumns;
+    for (UInt32 i = 0; i < unNumColumns; i++)
+    {
+        UInt8 unLength = 0, unWidth = 0;
+        ReadBinary(cInput, unLength);
+        std::string strName(unLength, '\0');
+        if (unLength > 0)
+        {
+            cInput.read(&strName[0], unLength);
+        }
+        ReadBinary(cInput, unWidth);
+        vecColumns.push_back(SColumn(strName, unWidth));
+    }
+    std::vector<SRobot> vecRobots;
+    for (UInt32 i = 0; i < unNumRobots; i++)
+    {
+        UInt16 unId = 0;
+        UInt8 unSocial = 0;
+        ReadBinary(cInput, unId);
+        ReadBinary(cInput, unSocial);
+        vecRobots.push_back(SRobot(unId, unSocial != 0));
+    }
+    if (!cInput)
+    {
+        THROW_ARGOSEXCEPTION("\"" << str_input_file_name << "\" has a truncated header");
+    }
+    /* Rows */
+    CKiloLogTSV cTSV(c_output);
+    cTSV.SetLayout(vecColumns, vecRobots);
+    std::vector<float> vecRow(1 + unNumRobots * unNumColumns);
+    std::vector<Real> vecValues(unNumRobots * unNumColumns);
+    UInt32 unRows = 0;
+    while (cInput.read(reinterpret_cast<char *>(&vecRow[0]), vecRow.size() * sizeof(float)))
+    {
+        for (size_t i = 0; i < vecValues.size(); i++)
+        {
+            vecValues[i] = vecRow[i + 1];
+        }
+        cTSV.Write(vecRow[0], vecValues);
+        ++unRows;
+    }
+    if (cInput.gcount() != 0)
+    {
+        THROW_ARGOSEXCEPTION("\"" << str_input_file_name << "\" ends with a truncated row");
+    }
+    return unRows;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file <kilo_log.h>
+ *
+ * @brief This is the header file of the loggers of the kilobot states (KiloLOG).
+ *
+ * A log has one row per acquisition: the time, then a record of the same
+ * columns (position, orientation, sensor...) for each kilobot. Two formats
+ * are available:
+ *
+ * - "tsv": the tab-separated text layout the analysis scripts read.
+ *
+ * - "binary": fixed-width float32 records, for large batch runs. The file
+ *   starts with a header that describes the columns and the kilobots, and
+ *   can be converted to the tsv layout with kilolog_to_tsv.
+ *
+ * The binary file is in the byte order of the machine that wrote it:
+ *
+ *   char[8]  magic, "KILOLOG" and a zero byte
+ *   uint32   version (1)
+ *   uint32   number of kilobots
+ *   uint32   number of columns per kilobot
+ *   columns  uint8 name length, name, uint8 width of the field in the tsv layout
+ *   kilobots uint16 ID, uint8 1 for social robots and 0 for the others
+ *   rows     float32 time, then the columns of each kilobot, kilobot after kilobot
+ */
+
+#ifndef KILO_LOG_H
+#define KILO_LOG_H
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace argos;
+
+/**
+ * @brief The CKiloLog class
+ */
+
+class CKiloLog
+{
+
+public:
+
+    /** A column of the record of each kilobot */
+    struct SColumn
+    {
+        std::string Name;
+        /** Width of the field in the tsv layout */
+        UInt8 Width;
+
+        SColumn(const std::string &str_name, UInt8 un_width) : Name(str_name), Width(un_width) {}
+    };
+
+    /** A kilobot in the log */
+    struct SRobot
+    {
+        UInt16 Id;
+        bool Social;
+
+        SRobot(UInt16 un_id, bool b_social) : Id(un_id), Social(b_social) {}
+    };
+
+public:
+
+    virtual ~CKiloLog() {}
+
+    /**
+     * Creates a logger
+     * @param str_format The format of the log, "tsv" or "binary"
+     */
+    static CKiloLog *Create(const std::string &str_format);
+
+    /**
+     * Opens the log file, truncating it
+     * @param str_file_name The name of the log file
+     * @param vec_columns The columns of the record of each kilobot
+     * @param vec_robots The kilobots, in the order of their records
+     */
+    virtual void Open(const std::string &str_file_name,
+                      const std::vector<SColumn> &vec_columns,
+                      const std::vector<SRobot> &vec_robots) = 0;
+
+    /**
+     * Writes a row
+     * The row is buffered: it reaches the file at the latest when the log is closed.
+     * @param f_time The time of the row, in seconds
+     * @param vec_values The records of the kilobots, kilobot after kilobot
+     */
+    virtual void Write(Real f_time,
+                       const std::vector<Real> &vec_values) = 0;
+
+    /**
+     * Writes the buffered rows to the file
+     */
+    virtual void Flush() = 0;
+
+    /**
+     * Closes the log file
+     */
+    virtual void Close() = 0;
+
+protected:
+
+    std::vector<SColumn> m_vecColumns;
+    std::vector<SRobot> m_vecRobots;
+};
+
+/**
+ * @brief The tab-separated text logger
+ */
+
+class CKiloLogTSV : public CKiloLog
+{
+
+public:
+
+    CKiloLogTSV();
+
+    /**
+     * Creates a logger that writes on an already open stream
+     * @param c_stream The stream
+     */
+    CKiloLogTSV(std::ostream &c_stream);
+
+    virtual ~CKiloLogTSV() { Close(); }
+
+    virtual void Open(const std::string &str_file_name,
+                      const std::vector<SColumn> &vec_columns,
+                      const std::vector<SRobot> &vec_robots);
+
+    /**
+     * Sets the columns and the kilobots, when writing on an already open stream
+     */
+    void SetLayout(const std::vector<SColumn> &vec_columns,
+                   const std::vector<SRobot> &vec_robots);
+
+    virtual void Write(Real f_time,
+                       const std::vector<Real> &vec_values);
+
+    virtual void Flush();
+
+    virtual void Close();
+
+private:
+
+    std::ofstream m_cFile;
+    std::ostream *m_pcStream;
+};
+
+/**
+ * @brief The binary logger
+ */
+
+class CKiloLogBinary : public CKiloLog
+{
+
+public:
+
+    /** Version of the binary format */
+    static const UInt32 VERSION = 1;
+
+    /** Size of the write buffer, in bytes */
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+public:
+
+    CKiloLogBinary() {}
+
+    virtual ~CKiloLogBinary() { Close(); }
+
+    virtual void Open(const std::string &str_file_name,
+                      const std::vector<SColumn> &vec_columns,
+                      const std::vector<SRobot> &vec_robots);
+
+    virtual void Write(Real f_time,
+                       const std::vector<Real> &vec_values);
+
+    virtual void Flush();
+
+    virtual void Close();
+
+    /**
+     * Reads a binary log and writes it in the tsv layout
+     * @param str_input_file_name The binary log
+     * @param c_output The stream of the tsv log
+     * @return The number of rows
+     */
+    static UInt32 ConvertToTSV(const std::string &str_input_file_name,
+                               std::ostream &c_output);
+
+private:
+
+    std::ofstream m_cFile;
+    std::vector<char> m_vecBuffer;
+    std::vector<float> m_vecRow;
+};
+
+#endif
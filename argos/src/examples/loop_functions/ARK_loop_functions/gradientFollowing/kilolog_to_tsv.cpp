@@ -0,0 +1,60 @@
+/**
+ * @file <kilolog_to_tsv.cpp>
+ *
+ * @brief Converts a binary KiloLOG file to the tsv layout read by the analysis scripts.
+ *
+ * Usage: kilolog_to_tsv <binary_log> [<tsv_log>]
+ *
+ * Without <tsv_log>, the output file has the name of the binary log, with
+ * the extension replaced by .tsv.
+ */
+
+#include "kilo_log.h"
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <binary_log> [<tsv_log>]" << std::endl;
+        return 1;
+    }
+    std::string strInput(argv[1]);
+    std::string strOutput;
+    if (argc == 3)
+    {
+        strOutput = argv[2];
+    }
+    else
+    {
+        size_t unDot = strInput.find_last_of('.');
+        size_t unSlash = strInput.find_last_of('/');
+        if (unDot == std::string::npos || (unSlash != std::string::npos && unDot < unSlash))
+        {
+            unDot = strInput.size();
+        }
+        strOutput = strInput.substr(0, unDot) + ".tsv";
+    }
+    if (strOutput == strInput)
+    {
+        std::cerr << argv[0] << ": the output file would overwrite the input file" << std::endl;
+        return 1;
+    }
+    try
+    {
+        std::ofstream cOutput(strOutput.c_str(), std::ios_base::trunc | std::ios_base::out);
+        if (!cOutput)
+        {
+            std::cerr << argv[0] << ": cannot open \"" << strOutput << "\"" << std::endl;
+            return 1;
+        }
+        CKiloLogBinary::ConvertToTSV(strInput, cOutput);
+    }
+    catch (CARGoSException &ex)
+    {
+        std::cerr << argv[0] << ": " << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
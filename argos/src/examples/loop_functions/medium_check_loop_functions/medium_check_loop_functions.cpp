@@ -0,0 +1,103 @@
+#include "medium_check_loop_functions.h"
+#include <argos3/core/simulator/simulator.h>
+#include <argos3/core/utility/math/rng.h>
+
+/****************************************/
+/****************************************/
+
+void CMediumCheckLoopFunctions::Init(TConfigurationNode& t_tree) {
+   /* Parse the parameters */
+   std::string strMedium = "kilocomm";
+   UInt32 unOrders = 4;
+   UInt32 unUpdates = 10;
+   GetNodeAttributeOrDefault(t_tree, "medium", strMedium, strMedium);
+   GetNodeAttributeOrDefault(t_tree, "orders", unOrders, unOrders);
+   GetNodeAttributeOrDefault(t_tree, "updates", unUpdates, unUpdates);
+   m_pcMedium = &GetSimulator().GetMedium<CKilobotCommunicationMedium>(strMedium);
+   /* Get the kilobots, sorted by id as the space keeps them */
+   m_vecKilobots.clear();
+   CSpace::TMapPerType& tKBMap = GetSpace().GetEntitiesByType("kilobot");
+   for(CSpace::TMapPerType::iterator it = tKBMap.begin();
+       it != tKBMap.end();
+       ++it) {
+      CKilobotEntity* pcKB = any_cast<CKilobotEntity*>(it->second);
+      /* Skip the robots that do not use this medium */
+      CKilobotCommunicationEntity& cCommEntity = pcKB->GetKilobotCommunicationEntity();
+      if(cCommEntity.GetMediumIndex() >= 0 && &cCommEntity.GetMedium() == m_pcMedium) {
+         m_vecKilobots.push_back(pcKB);
+      }
+   }
+   /* Record the deliveries in id order */
+   TDeliveries tReference;
+   RecordDeliveries(m_vecKilobots, unUpdates, tReference);
+   /* Record them again in shuffled orders, and compare */
+   CRandom::CRNG* pcRNG = CRandom::CreateRNG("argos");
+   std::vector<CKilobotEntity*> vecKilobots(m_vecKilobots);
+   TDeliveries tDeliveries;
+   for(UInt32 o = 0; o < unOrders; ++o) {
+      for(size_t i = vecKilobots.size(); i > 1; --i) {
+         std::swap(vecKilobots[i - 1],
+                   vecKilobots[pcRNG->Uniform(CRange<UInt32>(0, i))]);
+      }
+      RecordDeliveries(vecKilobots, unUpdates, tDeliveries);
+      for(size_t d = 0; d < tReference.size(); ++d) {
+         if(tDeliveries[d] != tReference[d]) {
+            THROW_ARGOSEXCEPTION("The medium \"" << strMedium << "\" delivered different messages to \"" <<
+                                 tReference[d][0] << "\" at update " << (d / m_vecKilobots.size()) <<
+                                 " when the robots were added in shuffled order " << o);
+         }
+      }
+   }
+   LOG << "[medium_check] The deliveries of " << vecKilobots.size() << " robots over "
+       << unUpdates << " updates are the same in " << (unOrders + 1) << " insertion orders" << std::endl;
+}
+
+/****************************************/
+/****************************************/
+
+void CMediumCheckLoopFunctions::RecordDeliveries(const std::vector<CKilobotEntity*>& vec_order,
+                                                 UInt32 un_updates,
+                                                 TDeliveries& t_deliveries) {
+   /* Add the robots to the medium in the given order */
+   for(size_t i = 0; i < vec_order.size(); ++i) {
+      m_pcMedium->RemoveEntity(vec_order[i]->GetKilobotCommunicationEntity());
+   }
+   for(size_t i = 0; i < vec_order.size(); ++i) {
+      m_pcMedium->AddEntity(vec_order[i]->GetKilobotCommunicationEntity());
+   }
+   /* Start over, as at the beginning of a run */
+   m_pcMedium->Reset();
+   /*
+    * Every robot tries to transmit at every update, queued in the given
+    * order. The deliveries are recorded in id order
+    */
+   t_deliveries.clear();
+   for(UInt32 u = 0; u < un_updates; ++u) {
+      for(size_t i = 0; i < vec_order.size(); ++i) {
+         CKilobotCommunicationEntity& cCommEntity = vec_order[i]->GetKilobotCommunicationEntity();
+         cCommEntity.SetTxStatus(CKilobotCommunicationEntity::TX_ATTEMPT);
+         m_pcMedium->AddTransmitter(cCommEntity);
+      }
+      m_pcMedium->Update();
+      for(size_t i = 0; i < m_vecKilobots.size(); ++i) {
+         /* The first element is the receiver, the others its senders */
+         t_deliveries.push_back(std::vector<std::string>(1, m_vecKilobots[i]->GetId()));
+         CKilobotCommunicationMedium::SNeighbors sSenders =
+            m_pcMedium->GetKilobotsCommunicatingWith(m_vecKilobots[i]->GetKilobotCommunicationEntity());
+         for(CKilobotCommunicationMedium::TNeighborIterator it = sSenders.Begin;
+             it != sSenders.End; ++it) {
+            t_deliveries.back().push_back((*it)->GetParent().GetId());
+         }
+      }
+   }
+   /* Leave the robots silent */
+   for(size_t i = 0; i < vec_order.size(); ++i) {
+      vec_order[i]->GetKilobotCommunicationEntity().SetTxStatus(CKilobotCommunicationEntity::TX_NONE);
+   }
+   m_pcMedium->Reset();
+}
+
+/****************************************/
+/****************************************/
+
+REGISTER_LOOP_FUNCTIONS(CMediumCheckLoopFunctions, "medium_check_loop_functions")
@@ -0,0 +1,58 @@
+/*
+ * These loop functions check that the deliveries of the Kilobot
+ * communication medium do not depend on the order in which the
+ * communication entities were added to it.
+ *
+ * At init, they add the entities to the medium in several shuffled
+ * orders. For each order, they reset the medium and let every robot
+ * transmit for a few updates, recording the senders of the messages each
+ * robot receives. The recordings must be identical, or the experiment
+ * stops with an error.
+ *
+ * The check changes the state of the medium, so these loop functions are
+ * meant for experiments that run the check only, such as
+ * src/examples/experiments/kilobot_medium_check.argos.
+ */
+
+#ifndef MEDIUM_CHECK_LOOP_FUNCTIONS_H
+#define MEDIUM_CHECK_LOOP_FUNCTIONS_H
+
+#include <argos3/core/simulator/loop_functions.h>
+#include <argos3/plugins/robots/kilobot/simulator/kilobot_entity.h>
+#include <argos3/plugins/robots/kilobot/simulator/kilobot_communication_medium.h>
+
+using namespace argos;
+
+class CMediumCheckLoopFunctions : public CLoopFunctions {
+
+public:
+
+   /** The senders of the messages received by each robot, update by update */
+   typedef std::vector<std::vector<std::string> > TDeliveries;
+
+public:
+
+   virtual ~CMediumCheckLoopFunctions() {}
+
+   virtual void Init(TConfigurationNode& t_tree);
+
+private:
+
+   /**
+    * Adds the robots to the medium in the given order, resets the medium
+    * and records the deliveries of the given number of updates.
+    */
+   void RecordDeliveries(const std::vector<CKilobotEntity*>& vec_order,
+                         UInt32 un_updates,
+                         TDeliveries& t_deliveries);
+
+private:
+
+   CKilobotCommunicationMedium* m_pcMedium;
+
+   /** The kilobots, sorted by id */
+   std::vector<CKilobotEntity*> m_vecKilobots;
+
+};
+
+#endif
@@ -2,6 +2,28 @@
 #include <argos3/core/utility/logging/argos_log.h>
 #include <argos3/core/simulator/physics_engine/physics_engine.h>
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_measures.h>
+#include <algorithm>
+#include <mutex>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
+
+/****************************************/
+/****************************************/
+
+std::vector<CCI_KilobotController*> CCI_KilobotController::m_vecBatchControllers;
+size_t CCI_KilobotController::m_unBatchResumed = 0;
+
+/* Protects the batch bookkeeping when ARGoS runs the controllers in parallel */
+static std::mutex BATCH_MUTEX;
+
+#ifdef __linux__
+static long Futex(uint32_t* pun_word, int n_op, uint32_t un_value, const timespec* pt_timeout) {
+    return ::syscall(SYS_futex, pun_word, n_op, un_value, pt_timeout, NULL, 0);
+}
+#endif
 
 /****************************************/
 /****************************************/
@@ -14,11 +36,14 @@ CCI_KilobotController::CCI_KilobotController() :
     m_pcCommA(NULL),
     m_pcCommS(NULL),
     m_pcRNG(NULL),
-    m_nSharedMemFD(-1),
-    m_nDebugInfoFD(-1),
+    m_unStateSlot(0),
     m_tBehaviorPID(-1),
     m_fLinearVelocity(1),
-    m_fAngularVelocity(45){}
+    m_fAngularVelocity(45),
+    m_bBatchStep(false),
+    m_bStepPending(false),
+    m_unStepCount(0),
+    m_unResetCount(0){}
 
 /****************************************/
 /****************************************/
@@ -41,40 +66,60 @@ void CCI_KilobotController::Init(TConfigurationNode& t_tree) {
         try {
             m_pcLight  = GetSensor  <CCI_KilobotLightSensor          >("kilobot_light"        );
         } catch(CARGoSException&) {}
-        /* Create a random number generator */
-        m_pcRNG = CRandom::CreateRNG("argos");
+        /* Create the random number generator of this robot */
+        m_pcRNG = new CKilobotRNG(GetId(), KILOBOT_RNG_CONTROLLER);
         /* Parse XML parameters */
         GetNodeAttribute(t_tree, "behavior", m_strBehaviorFName);
         GetNodeAttributeOrDefault(t_tree, "linearvelocity", m_fLinearVelocity,m_fLinearVelocity);
         GetNodeAttributeOrDefault(t_tree, "angularvelocity", m_fAngularVelocity,m_fAngularVelocity);
+        GetNodeAttributeOrDefault(t_tree, "batch", m_bBatchStep, m_bBatchStep);
+        UInt32 unDebugInfoSize = KILOBOT_DEBUG_INFO_SIZE;
+        GetNodeAttributeOrDefault(t_tree, "debug_info_size", unDebugInfoSize, unDebugInfoSize);
+#ifndef __linux__
+        if(m_bBatchStep) {
+            THROW_ARGOSEXCEPTION("Batch stepping of the behaviors is only supported on Linux");
+        }
+#endif
         /* Make sure script file exists */
         int nBehaviorFD = open(m_strBehaviorFName.c_str(), O_RDONLY);
         if(nBehaviorFD < 0) {
             THROW_ARGOSEXCEPTION("Opening behavior file \"" << m_strBehaviorFName << "\": " << strerror(errno));
         }
         close(nBehaviorFD);
-        /* Create shared memory area for master-slave communication */
-        m_nSharedMemFD = ::shm_open(("/" + ToString<pid_t>(getpid()) + "_" + GetId()).c_str(),
-                                    O_RDWR | O_CREAT,
-                                    S_IRUSR | S_IWUSR);
-        if(m_nSharedMemFD < 0) {
-            THROW_ARGOSEXCEPTION("Creating a shared memory area for " << GetId() << ": " << ::strerror(errno));
+        /* Pack the behavior parameters as "name\0value\0" pairs, for kilo_get_param() */
+        std::string strBehaviorParams;
+        if(NodeExists(t_tree, "behavior_params")) {
+            TConfigurationAttributeIterator itAttr;
+            for(itAttr = itAttr.begin(&GetNode(t_tree, "behavior_params"));
+                itAttr != itAttr.end();
+                ++itAttr) {
+                strBehaviorParams += itAttr->Name();
+                strBehaviorParams += '\0';
+                strBehaviorParams += itAttr->Value();
+                strBehaviorParams += '\0';
+            }
         }
-        /* Resize shared memory area to contain the robot state */
-        ::ftruncate(m_nSharedMemFD, sizeof(kilobot_state_t));
-        /* Get pointer to shared memory area */
-        m_ptRobotState = reinterpret_cast<kilobot_state_t*>(
-                    ::mmap(NULL,
-                           sizeof(kilobot_state_t),
-                           PROT_READ | PROT_WRITE,
-                           MAP_SHARED,
-                           m_nSharedMemFD,
-                           0));
-        if(m_ptRobotState == MAP_FAILED) {
-            THROW_ARGOSEXCEPTION("Mmapping the shared memory area of " << GetId() << ": " << ::strerror(errno));
+        /* Leave room for the terminating empty name */
+        if(strBehaviorParams.size() >= KILOBOT_PARAMS_SIZE) {
+            THROW_ARGOSEXCEPTION("The behavior parameters take " << strBehaviorParams.size() + 1 << " bytes, but at most " << KILOBOT_PARAMS_SIZE << " are available");
         }
+        /* Get a slot in the state arena for master-slave communication */
+        CKilobotStateArena& cArena = CKilobotStateArena::Acquire(unDebugInfoSize);
+        try {
+            m_unStateSlot = cArena.AllocateSlot();
+        }
+        catch(CARGoSException&) {
+            CKilobotStateArena::Release();
+            throw;
+        }
+        m_ptRobotState = cArena.GetState(m_unStateSlot);
+        ::memcpy(cArena.GetParams(m_unStateSlot), strBehaviorParams.data(), strBehaviorParams.size());
         /* Create behavior */
         CreateBehavior();
+        if(m_bBatchStep) {
+            std::lock_guard<std::mutex> cLock(BATCH_MUTEX);
+            m_vecBatchControllers.push_back(this);
+        }
     }
     catch(CARGoSException& ex) {
         THROW_ARGOSEXCEPTION_NESTED("Error initializing the Kilobot controller for robot " << GetId(), ex);
@@ -85,6 +130,34 @@ void CCI_KilobotController::Init(TConfigurationNode& t_tree) {
 /****************************************/
 
 void CCI_KilobotController::ControlStep() {
+    if(!m_bBatchStep) {
+        ReadSensors();
+        StepBehavior();
+        WriteActuators();
+        return;
+    }
+    /*
+     * Batch mode: resume the behavior and return, so the behaviors of all
+     * the robots run concurrently. The last controller to be stepped waits
+     * for all of them and sets the actuators.
+     */
+    std::lock_guard<std::mutex> cLock(BATCH_MUTEX);
+    if(m_bStepPending) {
+        /* Some robot was not stepped in the last step: collect what was resumed */
+        CollectBatch();
+    }
+    ReadSensors();
+    ResumeBehavior();
+    ++m_unBatchResumed;
+    if(m_unBatchResumed == m_vecBatchControllers.size()) {
+        CollectBatch();
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::ReadSensors() {
     /* Set light reading */
     if(m_pcLight)
         m_ptRobotState->ambientlight = m_pcLight->GetReading();
@@ -108,10 +181,83 @@ void CCI_KilobotController::ControlStep() {
     }
     // TODO m_ptRobotState->voltage
     // TODO m_ptRobotState->temperature
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::StepBehavior() {
     /* Resume process */
     ::kill(m_tBehaviorPID, SIGCONT);
     /* Wait for behavior to be done */
     ::waitpid(m_tBehaviorPID, NULL, WUNTRACED);
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::ResumeBehavior() {
+#ifdef __linux__
+    __atomic_store_n(&m_ptRobotState->step_request, ++m_unStepCount, __ATOMIC_RELEASE);
+    Futex(&m_ptRobotState->step_request, FUTEX_WAKE, 1, NULL);
+    m_bStepPending = true;
+#endif
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::WaitBehavior() {
+    m_bStepPending = false;
+    WaitBehaviorCounter(&m_ptRobotState->step_done, m_unStepCount);
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::WaitBehaviorCounter(uint32_t* pun_counter,
+                                                UInt32 un_value) {
+#ifdef __linux__
+    /* Check every second that the behavior process is still alive */
+    timespec tTimeout = { 1, 0 };
+    UInt32 unCurrent;
+    while((unCurrent = __atomic_load_n(pun_counter, __ATOMIC_ACQUIRE)) != un_value) {
+        if(Futex(pun_counter, FUTEX_WAIT, unCurrent, &tTimeout) < 0 &&
+           errno == ETIMEDOUT &&
+           ::waitpid(m_tBehaviorPID, NULL, WNOHANG) != 0) {
+            THROW_ARGOSEXCEPTION("The behavior process of " << GetId() << " terminated unexpectedly");
+        }
+    }
+#endif
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::CollectBatch() {
+    for(size_t i = 0; i < m_vecBatchControllers.size(); ++i) {
+        if(m_vecBatchControllers[i]->m_bStepPending) {
+            m_vecBatchControllers[i]->WaitBehavior();
+            m_vecBatchControllers[i]->WriteActuators();
+        }
+    }
+    m_unBatchResumed = 0;
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::CancelBatchStep() {
+    if(m_bStepPending) {
+        m_bStepPending = false;
+        --m_unBatchResumed;
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::WriteActuators() {
     /* Set actuator values */
     // TODO set proper conversion factors
     if((m_ptRobotState->right_motor!=0)&&(m_ptRobotState->left_motor!=0)){
@@ -146,19 +292,69 @@ void CCI_KilobotController::ControlStep() {
 /****************************************/
 
 void CCI_KilobotController::Reset() {
-    /* Kill kilobot process */
-    ::kill(m_tBehaviorPID, SIGTERM);
-    int nStatus;
-    ::waitpid(m_tBehaviorPID, &nStatus, WIFEXITED(nStatus));
-    /* Restart kilobot process */
+    /* The behavior gets the same seeds as after Init() */
+    m_pcRNG->Reset();
+    if(m_bBatchStep) {
+        /* A step resumed before the reset is not collected anymore */
+        std::lock_guard<std::mutex> cLock(BATCH_MUTEX);
+        CancelBatchStep();
+    }
+#ifdef __linux__
+    /* If the behavior process is alive, ask it to start over */
+    if(m_tBehaviorPID > 0 && ::waitpid(m_tBehaviorPID, NULL, WNOHANG) == 0) {
+        ResetBehavior();
+        return;
+    }
+#endif
+    /* Kill kilobot behavior */
+    DestroyBehavior();
+    /* Restart kilobot behavior */
     CreateBehavior();
 }
 
 /****************************************/
 /****************************************/
 
+void CCI_KilobotController::ResetBehavior() {
+    /* The behavior process zeroes the state and reseeds rand_hard() with this */
+    m_ptRobotState->random_seed = m_pcRNG->Uniform(CRange<UInt32>(0, 0xFFFFFFFFUL));
+    m_unStepCount = 0;
+    /*
+     * The behavior process copies the request into reset_done when it
+     * suspends itself after setup(). step_done cannot tell, since it is
+     * zero both before and after the reset.
+     */
+    __atomic_store_n(&m_ptRobotState->reset_request, ++m_unResetCount, __ATOMIC_RELEASE);
+    ::kill(m_tBehaviorPID, SIGUSR1);
+    if(m_bBatchStep) {
+        /* Wait for the behavior process to be reset */
+        WaitBehaviorCounter(&m_ptRobotState->reset_done, m_unResetCount);
+    }
+    else {
+        /* Let the behavior process execute setup() and suspend itself */
+        ::kill(m_tBehaviorPID, SIGCONT);
+        ::waitpid(m_tBehaviorPID, NULL, WUNTRACED);
+    }
+}
+
+/****************************************/
+/****************************************/
+
 void CCI_KilobotController::Destroy() {
+    if(m_bBatchStep) {
+        std::lock_guard<std::mutex> cLock(BATCH_MUTEX);
+        m_vecBatchControllers.erase(
+            std::remove(m_vecBatchControllers.begin(), m_vecBatchControllers.end(), this),
+            m_vecBatchControllers.end());
+        CancelBatchStep();
+    }
     DestroyBehavior();
+    /* Give back the slot in the state arena */
+    CKilobotStateArena::GetInstance()->FreeSlot(m_unStateSlot);
+    CKilobotStateArena::Release();
+    m_ptRobotState = NULL;
+    delete m_pcRNG;
+    m_pcRNG = NULL;
 }
 
 /****************************************/
@@ -167,21 +363,43 @@ void CCI_KilobotController::Destroy() {
 void CCI_KilobotController::CreateBehavior() {
     /* Zero the robot state */
     ::memset(m_ptRobotState, 0, sizeof(kilobot_state_t));
-    /* Fork this process */
+    m_ptRobotState->batch = m_bBatchStep;
+    m_unStepCount = 0;
+    m_unResetCount = 0;
+    m_bStepPending = false;
+    /*
+     * Fork this process. The child starts with SIGUSR1 blocked, and keeps
+     * it blocked through exec, so a reset sent before the behavior is ready
+     * for it waits instead of killing the process (see ResetBehavior())
+     */
     pid_t tParentPID = getpid();
+    sigset_t tResetSignal, tOldSignals;
+    ::sigemptyset(&tResetSignal);
+    ::sigaddset(&tResetSignal, SIGUSR1);
+    ::pthread_sigmask(SIG_BLOCK, &tResetSignal, &tOldSignals);
     m_tBehaviorPID = ::fork();
+    if(m_tBehaviorPID != 0) {
+        ::pthread_sigmask(SIG_SETMASK, &tOldSignals, NULL);
+    }
     if(m_tBehaviorPID < 0) {
         THROW_ARGOSEXCEPTION("Forking the behavior process of " << GetId() << ": " << ::strerror(errno));
     }
     /* Execute the behavior */
     if(m_tBehaviorPID == 0) {
         /* Child process */
+#ifdef __linux__
+        /* Do not outlive ARGoS, even if it dies before it could kill the behavior */
+        ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if(::getppid() != tParentPID) ::_exit(1);
+#endif
         ::execl(m_strBehaviorFName.c_str(),
                 m_strBehaviorFName.c_str(),                                          // Script name
                 ToString(tParentPID).c_str(),                                        // The parent process' PID
                 GetId().c_str(),                                                     // Robot id
                 ToString(CPhysicsEngine::GetSimulationClockTick()).c_str(),          // Control step duration in sec
                 ToString(m_pcRNG->Uniform(CRange<UInt32>(0, 0xFFFFFFFFUL))).c_str(), // Random seed for rand_hard()
+                ToString(CKilobotStateArena::GetInstance()->GetSlotOffset(m_unStateSlot)).c_str(), // Offset of the robot state
+                ToString(CKilobotStateArena::GetInstance()->GetDebugInfoSize()).c_str(),           // Space for the debug info
                 NULL
                 );
         /* If the next line is executed, it's because execl did not succeed */
@@ -196,12 +414,7 @@ void CCI_KilobotController::CreateBehavior() {
 void CCI_KilobotController::DestroyBehavior() {
     ::kill(m_tBehaviorPID, SIGTERM);
     ::kill(m_tBehaviorPID, SIGCONT);
-    int nStatus;
-    ::waitpid(m_tBehaviorPID, &nStatus, WIFEXITED(nStatus));
-    munmap(m_ptRobotState, sizeof(kilobot_state_t));
-    close(m_nSharedMemFD);
-    pid_t tParentPID = getpid();
-    ::shm_unlink(("/" + ToString<pid_t>(tParentPID) + "_" + GetId()).c_str());
+    ::waitpid(m_tBehaviorPID, NULL, 0);
 }
 
 /****************************************/
@@ -12,8 +12,9 @@
 #define CCI_KILOBOT_CONTROLLER_H
 
 #include <argos3/core/control_interface/ci_controller.h>
-#include <argos3/core/utility/math/rng.h>
+#include <argos3/plugins/robots/kilobot/control_interface/kilobot_rng.h>
 #include <argos3/plugins/robots/kilobot/control_interface/kilolib.h>
+#include <argos3/plugins/robots/kilobot/control_interface/kilobot_state_arena.h>
 #include <argos3/plugins/robots/generic/control_interface/ci_differential_steering_actuator.h>
 #include <argos3/plugins/robots/kilobot/control_interface/ci_kilobot_led_actuator.h>
 #include <argos3/plugins/robots/kilobot/control_interface/ci_kilobot_light_sensor.h>
@@ -46,8 +47,18 @@ public:
 
    virtual void Destroy();
 
+   /**
+    * Returns the file descriptor of the state arena shared with the behaviors.
+    */
    int GetSharedMemFD() const {
-      return m_nSharedMemFD;
+      return CKilobotStateArena::GetInstance()->GetFD();
+   }
+
+   /**
+    * Returns the slot of this robot in the state arena.
+    */
+   UInt32 GetStateSlot() const {
+      return m_unStateSlot;
    }
 
    pid_t GetBehaviorPID() const {
@@ -59,50 +70,95 @@ public:
    }
 
    template<class S> S* DebugInfoCreate() {
-      /* Open shared file */
-      m_nDebugInfoFD =
-         ::shm_open(
-            ("/ARGoS_DEBUG_" + ToString<pid_t>(getpid()) + "_" + GetId()).c_str(),
-            O_RDWR | O_CREAT,
-            S_IRUSR | S_IWUSR);
-      /* Check for errors */
-      if(m_nDebugInfoFD < 0) {
-         THROW_ARGOSEXCEPTION("Creating debug info shared memory area for " << GetId() << ": " << ::strerror(errno));
+      /* The debug info is stored in the slot of the robot, after its state */
+      if(sizeof(S) > CKilobotStateArena::GetInstance()->GetDebugInfoSize()) {
+         THROW_ARGOSEXCEPTION("The debug info of " << GetId() << " takes " << sizeof(S) << " bytes, but at most " << CKilobotStateArena::GetInstance()->GetDebugInfoSize() << " are available: raise debug_info_size in the controller");
       }
-      /* Resize shared memory area to contain the robot state */
-      ::ftruncate(m_nDebugInfoFD, sizeof(S));
-      /* Get pointer to shared memory area */
       S* ptDebugInfo = reinterpret_cast<S*>(
-         ::mmap(NULL,
-                sizeof(S),
-                PROT_READ | PROT_WRITE,
-                MAP_SHARED,
-                m_nDebugInfoFD,
-                0));
-      if(ptDebugInfo == MAP_FAILED) {
-         THROW_ARGOSEXCEPTION("Mmapping the debug info shared memory area of " << GetId() << ": " << ::strerror(errno));
-      }
+         CKilobotStateArena::GetInstance()->GetDebugInfo(m_unStateSlot));
       ::memset(ptDebugInfo, 0, sizeof(S));
       /* Return pointer */
       return ptDebugInfo;
    }
 
    template<class S> void DebugInfoDestroy(S* pt_debug_info) {
-      munmap(pt_debug_info, sizeof(S));
-      close(m_nDebugInfoFD);
-      ::shm_unlink(
-         ("/ARGoS_DEBUG_" + ToString<pid_t>(getpid()) + "_" + GetId()).c_str());
+      /* Nothing to do, the debug info goes away with the slot */
    }
 
 protected:
 
+   /**
+    * Starts the behavior of the robot.
+    * The default implementation forks and executes the behavior binary.
+    */
    virtual void CreateBehavior();
 
+   /**
+    * Stops the behavior of the robot.
+    * The default implementation terminates the behavior process.
+    */
    virtual void DestroyBehavior();
 
-private:
+   /**
+    * Makes the running behavior process start over, without forking it again.
+    * The process executes the behavior again in place, is given a new
+    * random seed, and runs its main() and setup(). Returns when the
+    * process has suspended itself after the reset.
+    */
+   void ResetBehavior();
+
+   /**
+    * Executes one step of the behavior on the current robot state.
+    * The default implementation resumes the behavior process and waits
+    * for it to suspend itself again.
+    */
+   virtual void StepBehavior();
+
+   /**
+    * Copies the sensor readings into the robot state.
+    */
+   void ReadSensors();
+
+   /**
+    * Sets the actuators according to the robot state.
+    */
+   void WriteActuators();
+
+   /**
+    * Asks the behavior process to execute one step, without waiting for it.
+    * Used in batch mode.
+    */
+   void ResumeBehavior();
+
+   /**
+    * Waits for the behavior process to complete the step requested by
+    * ResumeBehavior(). Used in batch mode.
+    */
+   void WaitBehavior();
+
+   /**
+    * Waits for the behavior process to set a counter of the robot state to
+    * the given value. Used in batch mode.
+    * @param pun_counter The counter, step_done or reset_done.
+    * @param un_value The value to wait for.
+    */
+   void WaitBehaviorCounter(uint32_t* pun_counter,
+                            UInt32 un_value);
+
+   /**
+    * Waits for all the batch behaviors resumed in this step and sets their actuators.
+    */
+   static void CollectBatch();
+
+   /**
+    * Forgets the step resumed by ResumeBehavior(), which will not be collected.
+    * Call it with the batch mutex held.
+    */
+   void CancelBatchStep();
 
-   /** Pointer to the shared memory area */
+protected:
+
+   /** Pointer to the robot state in the state arena */
    kilobot_state_t* m_ptRobotState;
 
    /** Pointer to the motor actuator */
@@ -121,13 +177,10 @@ private:
    CCI_KilobotCommunicationSensor* m_pcCommS;
 
    /** The random number generator */
-   CRandom::CRNG* m_pcRNG;
-
-   /** File descriptor for shared memory area */
-   int m_nSharedMemFD;
+   CKilobotRNG* m_pcRNG;
 
-   /** File descriptor for debug info */
-   int m_nDebugInfoFD;
+   /** Slot of the robot state in the state arena */
+   UInt32 m_unStateSlot;
 
    /** PID of the process executing the behavior */
    pid_t m_tBehaviorPID;
@@ -141,6 +194,24 @@ private:
    /** Angular velocity of the robots */
    CDegrees m_fAngularVelocity;
 
+   /** True if the behavior process is resumed together with the others */
+   bool m_bBatchStep;
+
+   /** True if the behavior was resumed and its step was not collected yet */
+   bool m_bStepPending;
+
+   /** Number of steps requested to the behavior process */
+   UInt32 m_unStepCount;
+
+   /** Number of resets requested to the behavior process */
+   UInt32 m_unResetCount;
+
+   /** The controllers that resume their behaviors together */
+   static std::vector<CCI_KilobotController*> m_vecBatchControllers;
+
+   /** Number of batch controllers resumed in the current step */
+   static size_t m_unBatchResumed;
+
 };
 
 #endif
@@ -0,0 +1,132 @@
+#include "ci_kilobot_inprocess_controller.h"
+#include <argos3/core/simulator/physics_engine/physics_engine.h>
+#include <dlfcn.h>
+#include <cstdlib>
+
+/****************************************/
+/****************************************/
+
+CCI_KilobotInProcessController::CCI_KilobotInProcessController() :
+   m_pvBehaviorHandle(NULL),
+   m_nBehaviorCopyFD(-1),
+   m_tStepFunction(NULL),
+   m_tDestroyFunction(NULL) {}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotInProcessController::CreateBehavior() {
+   if(m_bBatchStep) {
+      THROW_ARGOSEXCEPTION("Batch stepping is meaningless for in-process behaviors");
+   }
+   /* Zero the robot state */
+   ::memset(m_ptRobotState, 0, sizeof(kilobot_state_t));
+   /* Load a private copy of the behavior */
+   std::string strCopyFName = CopyBehavior();
+   m_pvBehaviorHandle = ::dlopen(strCopyFName.c_str(), RTLD_NOW | RTLD_LOCAL);
+   if(m_pvBehaviorHandle == NULL) {
+      THROW_ARGOSEXCEPTION("Loading the behavior of " << GetId() << ": " << m_strBehaviorFName << ": " << ::dlerror());
+   }
+   /* Get the entry points of kilolib */
+   TInitFunction tInitFunction =
+      reinterpret_cast<TInitFunction>(::dlsym(m_pvBehaviorHandle, "kilo_inprocess_init"));
+   m_tStepFunction =
+      reinterpret_cast<TStepFunction>(::dlsym(m_pvBehaviorHandle, "kilo_inprocess_step"));
+   m_tDestroyFunction =
+      reinterpret_cast<TStepFunction>(::dlsym(m_pvBehaviorHandle, "kilo_inprocess_destroy"));
+   if(tInitFunction == NULL || m_tStepFunction == NULL || m_tDestroyFunction == NULL) {
+      THROW_ARGOSEXCEPTION("The behavior " << m_strBehaviorFName << " of " << GetId() << " was not linked to argos3plugin_simulator_kilolib_inprocess");
+   }
+   /* Execute main() and setup() of the behavior */
+   if(tInitFunction(m_ptRobotState,
+                    GetId().c_str(),
+                    CPhysicsEngine::GetSimulationClockTick(),
+                    m_pcRNG->Uniform(CRange<UInt32>(0, 0xFFFFFFFFUL)),
+                    CKilobotStateArena::GetInstance()->GetDebugInfoSize()) != 0) {
+      THROW_ARGOSEXCEPTION("Starting the behavior of " << GetId() << ": " << m_strBehaviorFName);
+   }
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotInProcessController::DestroyBehavior() {
+   if(m_pvBehaviorHandle != NULL) {
+      if(m_tDestroyFunction != NULL) {
+         m_tDestroyFunction();
+      }
+      ::dlclose(m_pvBehaviorHandle);
+      m_pvBehaviorHandle = NULL;
+      m_tStepFunction = NULL;
+      m_tDestroyFunction = NULL;
+   }
+   /* The private copy can go only after the library is unloaded */
+   if(m_nBehaviorCopyFD >= 0) {
+      ::close(m_nBehaviorCopyFD);
+      m_nBehaviorCopyFD = -1;
+   }
+   if(!m_strBehaviorCopyFName.empty()) {
+      ::unlink(m_strBehaviorCopyFName.c_str());
+      m_strBehaviorCopyFName.clear();
+   }
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotInProcessController::StepBehavior() {
+   m_tStepFunction();
+}
+
+/****************************************/
+/****************************************/
+
+std::string CCI_KilobotInProcessController::CopyBehavior() {
+   /* Open the original */
+   int nSourceFD = ::open(m_strBehaviorFName.c_str(), O_RDONLY);
+   if(nSourceFD < 0) {
+      THROW_ARGOSEXCEPTION("Opening behavior file \"" << m_strBehaviorFName << "\": " << ::strerror(errno));
+   }
+   /* Create the copy */
+   std::string strCopyFName;
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+   /*
+    * An anonymous file in memory, alive as long as the descriptor is open.
+    * Keeping it open also makes sure that no other robot gets the same
+    * /proc path while this copy is loaded.
+    */
+   m_nBehaviorCopyFD = ::memfd_create(GetId().c_str(), MFD_CLOEXEC);
+   strCopyFName = "/proc/self/fd/" + ToString(m_nBehaviorCopyFD);
+#else
+   /* A temporary file, removed when the behavior is destroyed */
+   char pchTemplate[] = "/tmp/argos_kilobot_XXXXXX";
+   m_nBehaviorCopyFD = ::mkstemp(pchTemplate);
+   if(m_nBehaviorCopyFD >= 0) {
+      m_strBehaviorCopyFName = pchTemplate;
+      strCopyFName = m_strBehaviorCopyFName;
+   }
+#endif
+   if(m_nBehaviorCopyFD < 0) {
+      ::close(nSourceFD);
+      THROW_ARGOSEXCEPTION("Creating a copy of the behavior of " << GetId() << ": " << ::strerror(errno));
+   }
+   /* Copy the content */
+   char pchBuffer[65536];
+   ssize_t nRead;
+   while((nRead = ::read(nSourceFD, pchBuffer, sizeof(pchBuffer))) > 0) {
+      if(::write(m_nBehaviorCopyFD, pchBuffer, nRead) != nRead) {
+         nRead = -1;
+         break;
+      }
+   }
+   ::close(nSourceFD);
+   if(nRead < 0) {
+      THROW_ARGOSEXCEPTION("Copying the behavior of " << GetId() << ": " << ::strerror(errno));
+   }
+   return strCopyFName;
+}
+
+/****************************************/
+/****************************************/
+
+REGISTER_CONTROLLER(CCI_KilobotInProcessController, "kilobot_inprocess_controller");
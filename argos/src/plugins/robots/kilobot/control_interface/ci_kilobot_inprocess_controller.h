@@ -0,0 +1,75 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/control_interface/ci_kilobot_inprocess_controller.h>
+ *
+ * @brief This file provides the definition of the in-process kilobot controller.
+ *
+ * This controller runs the behavior inside the ARGoS process, instead of
+ * forking a process per robot. The behavior must be compiled as a shared
+ * object linked to the in-process version of kilolib
+ * (argos3plugin_simulator_kilolib_inprocess).
+ *
+ * Every robot loads its own copy of the shared object, so the global
+ * variables of the behavior and of kilolib are private to each robot,
+ * exactly as if the behavior ran in its own process. The behavior also
+ * runs on its own stack, so blocking calls such as delay() suspend it
+ * with a user-space context switch rather than with a signal.
+ */
+
+#ifndef CCI_KILOBOT_INPROCESS_CONTROLLER_H
+#define CCI_KILOBOT_INPROCESS_CONTROLLER_H
+
+#include <argos3/plugins/robots/kilobot/control_interface/ci_kilobot_controller.h>
+
+using namespace argos;
+
+class CCI_KilobotInProcessController : public CCI_KilobotController {
+
+public:
+
+   CCI_KilobotInProcessController();
+   virtual ~CCI_KilobotInProcessController() {}
+
+protected:
+
+   virtual void CreateBehavior();
+
+   virtual void DestroyBehavior();
+
+   virtual void StepBehavior();
+
+private:
+
+   /** Pointer to the kilo_inprocess_init() function of the behavior */
+   typedef int (*TInitFunction)(kilobot_state_t*, const char*, float, uint32_t, uint32_t);
+
+   /** Pointer to the kilo_inprocess_step() and kilo_inprocess_destroy() functions of the behavior */
+   typedef void (*TStepFunction)();
+
+   /**
+    * Makes a private copy of the behavior file.
+    * The dynamic loader shares a library among all the dlopen() calls
+    * that refer to the same file, so each robot needs its own copy.
+    * @return The path of the copy.
+    */
+   std::string CopyBehavior();
+
+private:
+
+   /** Handle of the loaded behavior */
+   void* m_pvBehaviorHandle;
+
+   /** File descriptor of the private copy of the behavior */
+   int m_nBehaviorCopyFD;
+
+   /** Path of the private copy of the behavior */
+   std::string m_strBehaviorCopyFName;
+
+   /** The step function of the behavior */
+   TStepFunction m_tStepFunction;
+
+   /** The function that releases the resources of the behavior */
+   TStepFunction m_tDestroyFunction;
+
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "kilobot_rng.h"
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   /**
+    * The splitmix64 finalizer: close values, as consecutive ids and
+    * streams, give unrelated seeds.
+    */
+   static UInt64 MixSeed(UInt64 un_value) {
+      un_value += 0x9E3779B97F4A7C15ULL;
+      un_value = (un_value ^ (un_value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      un_value = (un_value ^ (un_value >> 27)) * 0x94D049BB133111EBULL;
+      return un_value ^ (un_value >> 31);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   /**
+    * FNV-1a hash of an id, which need not be a number.
+    */
+   static UInt64 HashId(const std::string& str_robot_id) {
+      UInt64 unIdHash = 0xCBF29CE484222325ULL;
+      for(size_t i = 0; i < str_robot_id.size(); ++i) {
+         unIdHash ^= static_cast<UInt8>(str_robot_id[i]);
+         unIdHash *= 0x100000001B3ULL;
+      }
+      return unIdHash;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   /**
+    * The key of a stream, from the seed of the experiment, the hash of the
+    * id and the stream, with all their bits.
+    */
+   static UInt64 MakeKey(UInt64 un_id_hash,
+                         UInt32 un_stream) {
+      UInt64 unKey = MixSeed(CRandom::GetSeedOf("argos"));
+      unKey = MixSeed(unKey ^ un_id_hash);
+      return MixSeed(unKey ^ un_stream);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotRNG::CKilobotRNG(const std::string& str_robot_id,
+                            UInt32 un_stream) :
+      m_unIdHash(HashId(str_robot_id)),
+      m_unStream(un_stream),
+      m_unKey(MakeKey(m_unIdHash, un_stream)),
+      m_unCounter(0) {}
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotRNG::Reset() {
+      m_unKey = MakeKey(m_unIdHash, m_unStream);
+      m_unCounter = 0;
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
@@ -0,0 +1,153 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/control_interface/kilobot_rng.h>
+ *
+ * @brief This file provides the random number streams of the kilobots.
+ *
+ * Each robot has a stream per subsystem, whose seed is derived from the
+ * random seed of the experiment, the id of the robot and the subsystem.
+ * The numbers a robot draws in a subsystem then depend neither on the
+ * other robots nor on the order in which the subsystems and the robots
+ * draw them. The medium check loop functions
+ * (src/examples/loop_functions/medium_check_loop_functions) verify that
+ * the deliveries of the medium do not depend on the order of the entities.
+ *
+ * The generators are owned by their users, which must call their Reset()
+ * in their own Reset(), because the seed of the experiment may change
+ * between two runs.
+ */
+
+#ifndef KILOBOT_RNG_H
+#define KILOBOT_RNG_H
+
+#include <argos3/core/utility/math/rng.h>
+#include <argos3/core/utility/math/general.h>
+#include <cmath>
+#include <string>
+
+namespace argos {
+
+   /**
+    * The subsystems that draw random numbers for a robot.
+    * The values enter the seeds: changing them changes every trajectory.
+    */
+   enum EKilobotRNGStream {
+      /** Seeds of rand_hard() in the behaviors */
+      KILOBOT_RNG_CONTROLLER    = 1,
+      /** Distance noise of the communication sensor */
+      KILOBOT_RNG_COMM_SENSOR   = 2,
+      /** Noise of the light sensor */
+      KILOBOT_RNG_LIGHT_SENSOR  = 3,
+      /** Conflicts and drops of the messages sent by the robot */
+      KILOBOT_RNG_MEDIUM        = 4,
+      /** Initial placement by the loop functions */
+      KILOBOT_RNG_PLACEMENT     = 5,
+      /** Virtual sensors of the loop functions */
+      KILOBOT_RNG_LOOP_FUNCTION = 6,
+      /** Native controllers that draw their own random numbers */
+      KILOBOT_RNG_BEHAVIOR      = 7
+   };
+
+   /**
+    * The generator of a stream of a robot.
+    *
+    * It is splitmix64 used as a counter-based generator: the n-th number is
+    * a mix of the 64-bit key of the stream plus n times a constant. Its
+    * whole state is the key and the counter, so thousands of robots with
+    * several streams each stay in the cache, where a Mersenne Twister
+    * takes 2.5 KB per stream.
+    */
+   class CKilobotRNG {
+
+   public:
+
+      /**
+       * Class constructor.
+       * @param str_robot_id The id of the robot entity.
+       * @param un_stream The stream, usually an EKilobotRNGStream.
+       */
+      CKilobotRNG(const std::string& str_robot_id,
+                  UInt32 un_stream);
+
+      /**
+       * Restarts the stream, with the key derived from the current seed of
+       * the experiment.
+       */
+      void Reset();
+
+      /** Returns 64 uniform bits */
+      inline UInt64 Next() {
+         return Mix(m_unKey + (++m_unCounter) * 0x9E3779B97F4A7C15ULL);
+      }
+
+      /**
+       * Returns true with probability f_true, for an element of a draw.
+       * The answers for the elements of the same draw are independent, so
+       * the elements can be visited in any order.
+       * @param f_true The probability.
+       * @param un_draw A value returned by Next().
+       * @param un_element The element, such as the hash of an id.
+       */
+      static inline bool Bernoulli(Real f_true,
+                                   UInt64 un_draw,
+                                   UInt64 un_element) {
+         return ToUniform01(Mix(un_draw ^ un_element)) < f_true;
+      }
+
+      /** Returns true with probability f_true */
+      inline bool Bernoulli(Real f_true = 0.5) {
+         return ToUniform01(Next()) < f_true;
+      }
+
+      /** Returns a number uniform in [min, max) */
+      inline Real Uniform(const CRange<Real>& c_range) {
+         return c_range.GetMin() + ToUniform01(Next()) * c_range.GetSpan();
+      }
+
+      /** Returns an integer uniform in [min, max) */
+      inline UInt32 Uniform(const CRange<UInt32>& c_range) {
+         return c_range.GetMin() +
+            static_cast<UInt32>(((Next() >> 32) * c_range.GetSpan()) >> 32);
+      }
+
+      /** Returns a Gaussian number, by the Box-Muller transform */
+      inline Real Gaussian(Real f_std_dev,
+                           Real f_mean = 0.0) {
+         Real fU = 1.0 - ToUniform01(Next());
+         return f_mean + f_std_dev * ::sqrt(-2.0 * ::log(fU)) * ::cos(2.0 * ARGOS_PI * ToUniform01(Next()));
+      }
+
+      /** Returns the hash of the id of the robot */
+      inline UInt64 GetIdHash() const {
+         return m_unIdHash;
+      }
+
+   private:
+
+      /** The splitmix64 finalizer */
+      static inline UInt64 Mix(UInt64 un_value) {
+         un_value = (un_value ^ (un_value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+         un_value = (un_value ^ (un_value >> 27)) * 0x94D049BB133111EBULL;
+         return un_value ^ (un_value >> 31);
+      }
+
+      /** Returns a number uniform in [0, 1) from the top 53 bits of a value */
+      static inline Real ToUniform01(UInt64 un_value) {
+         return (un_value >> 11) * (1.0 / 9007199254740992.0);
+      }
+
+   private:
+
+      /** Hash of the id of the robot */
+      UInt64 m_unIdHash;
+      /** The stream */
+      UInt32 m_unStream;
+      /** Key of the stream, from the seed, the id and the stream */
+      UInt64 m_unKey;
+      /** Numbers drawn since the last reset */
+      UInt64 m_unCounter;
+
+   };
+
+}
+
+#endif
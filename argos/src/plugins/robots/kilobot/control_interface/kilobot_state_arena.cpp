@@ -0,0 +1,134 @@
+#include "kilobot_state_arena.h"
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <argos3/core/utility/string_utilities.h>
+#include <algorithm>
+#include <functional>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   const UInt32 CKilobotStateArena::MAX_SLOTS;
+   CKilobotStateArena* CKilobotStateArena::m_pcInstance = NULL;
+   UInt32 CKilobotStateArena::m_unUsers = 0;
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotStateArena& CKilobotStateArena::Acquire(UInt32 un_debug_info_size) {
+      /* Keep the parameters that follow the debug info aligned to a cache line */
+      un_debug_info_size = ((un_debug_info_size + KILOBOT_CACHE_LINE_SIZE - 1) /
+                            KILOBOT_CACHE_LINE_SIZE) * KILOBOT_CACHE_LINE_SIZE;
+      if(m_pcInstance == NULL) {
+         m_pcInstance = new CKilobotStateArena(un_debug_info_size);
+      }
+      else if(un_debug_info_size > m_pcInstance->m_unDebugInfoSize) {
+         THROW_ARGOSEXCEPTION("The kilobot state arena reserves " << m_pcInstance->m_unDebugInfoSize <<
+                              " bytes for the debug info, but " << un_debug_info_size <<
+                              " are requested: set the same debug_info_size in all the kilobot controllers");
+      }
+      ++m_unUsers;
+      return *m_pcInstance;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotStateArena::Release() {
+      if(m_unUsers > 0 && --m_unUsers == 0) {
+         delete m_pcInstance;
+         m_pcInstance = NULL;
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotStateArena::CKilobotStateArena(UInt32 un_debug_info_size) :
+      m_strName("/ARGoS_KILOBOTS_" + ToString<pid_t>(::getpid())),
+      m_nFD(-1),
+      m_pchData(NULL),
+      m_unDebugInfoSize(un_debug_info_size),
+      m_unSlotSize(KILOBOT_SLOT_SIZE(un_debug_info_size)),
+      m_unSize(MAX_SLOTS * m_unSlotSize) {
+      /* Create shared memory area */
+      m_nFD = ::shm_open(m_strName.c_str(),
+                         O_RDWR | O_CREAT | O_TRUNC,
+                         S_IRUSR | S_IWUSR);
+      if(m_nFD < 0) {
+         THROW_ARGOSEXCEPTION("Creating the kilobot state arena " << m_strName << ": " << ::strerror(errno));
+      }
+      /* Resize it; the pages are allocated only when touched */
+      if(::ftruncate(m_nFD, m_unSize) < 0) {
+         ::close(m_nFD);
+         ::shm_unlink(m_strName.c_str());
+         THROW_ARGOSEXCEPTION("Resizing the kilobot state arena " << m_strName << ": " << ::strerror(errno));
+      }
+      /* Get pointer to shared memory area */
+      void* pvData = ::mmap(NULL,
+                            m_unSize,
+                            PROT_READ | PROT_WRITE,
+                            MAP_SHARED,
+                            m_nFD,
+                            0);
+      if(pvData == MAP_FAILED) {
+         ::close(m_nFD);
+         ::shm_unlink(m_strName.c_str());
+         THROW_ARGOSEXCEPTION("Mmapping the kilobot state arena " << m_strName << ": " << ::strerror(errno));
+      }
+      m_pchData = reinterpret_cast<char*>(pvData);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotStateArena::~CKilobotStateArena() {
+      ::munmap(m_pchData, m_unSize);
+      ::close(m_nFD);
+      ::shm_unlink(m_strName.c_str());
+   }
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CKilobotStateArena::AllocateSlot() {
+      UInt32 unSlot;
+      if(!m_vecFreeSlots.empty()) {
+         /* Reuse the lowest free slot */
+         unSlot = m_vecFreeSlots.back();
+         m_vecFreeSlots.pop_back();
+      }
+      else {
+         if(m_vecSlotUsed.size() >= MAX_SLOTS) {
+            THROW_ARGOSEXCEPTION("The kilobot state arena is full: at most " << MAX_SLOTS << " kilobots are supported");
+         }
+         unSlot = m_vecSlotUsed.size();
+         m_vecSlotUsed.push_back(false);
+      }
+      m_vecSlotUsed[unSlot] = true;
+      ::memset(m_pchData + GetSlotOffset(unSlot), 0, m_unSlotSize);
+      return unSlot;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotStateArena::FreeSlot(UInt32 un_slot) {
+      m_vecSlotUsed[un_slot] = false;
+      /* Keep the free slots sorted from highest to lowest */
+      m_vecFreeSlots.insert(
+         std::upper_bound(m_vecFreeSlots.begin(), m_vecFreeSlots.end(), un_slot, std::greater<UInt32>()),
+         un_slot);
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
@@ -0,0 +1,190 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/control_interface/kilobot_state_arena.h>
+ *
+ * @brief This file provides the definition of the kilobot state arena.
+ *
+ * The state arena is a single shared memory area that holds the states of
+ * all the kilobots, plus room for their debug info and behavior
+ * parameters. Each robot gets a
+ * slot of GetSlotSize() bytes, aligned to a cache line. The behavior
+ * processes map only the pages that contain their own slot.
+ *
+ * The space for the debug info is chosen by the first controller that
+ * acquires the arena, and it is the same for all the robots.
+ *
+ * The area is created when the first kilobot controller is initialized,
+ * and destroyed when the last one is destroyed. Its size is fixed, but it
+ * is reserved sparsely, so only the slots in use take memory.
+ */
+
+#ifndef KILOBOT_STATE_ARENA_H
+#define KILOBOT_STATE_ARENA_H
+
+namespace argos {
+   class CKilobotStateArena;
+}
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+#include <argos3/plugins/robots/kilobot/control_interface/kilolib.h>
+#include <string>
+#include <vector>
+
+namespace argos {
+
+   class CKilobotStateArena {
+
+   public:
+
+      /** Maximum number of robots in the arena */
+      static const UInt32 MAX_SLOTS = 16384;
+
+   public:
+
+      /**
+       * Returns the arena, creating it if necessary.
+       * Every call must be matched by a call to Release().
+       * @param un_debug_info_size The space needed for the debug info of a robot.
+       * @throws CARGoSException If the arena exists and reserves less space for the debug info.
+       */
+      static CKilobotStateArena& Acquire(UInt32 un_debug_info_size = KILOBOT_DEBUG_INFO_SIZE);
+
+      /**
+       * Releases the arena, destroying it when nobody uses it anymore.
+       */
+      static void Release();
+
+      /**
+       * Returns the arena, or NULL if no kilobot controller exists.
+       */
+      static CKilobotStateArena* GetInstance() {
+         return m_pcInstance;
+      }
+
+      /**
+       * Reserves a slot, with the robot state, the debug info and the parameters set to zero.
+       * @return The index of the slot.
+       */
+      UInt32 AllocateSlot();
+
+      /**
+       * Gives back a slot reserved by AllocateSlot().
+       */
+      void FreeSlot(UInt32 un_slot);
+
+      /**
+       * Returns the robot state in the given slot.
+       */
+      inline kilobot_state_t* GetState(UInt32 un_slot) {
+         return reinterpret_cast<kilobot_state_t*>(m_pchData + GetSlotOffset(un_slot));
+      }
+
+      /**
+       * Returns the debug info area in the given slot.
+       * The area is GetDebugInfoSize() bytes long.
+       */
+      inline void* GetDebugInfo(UInt32 un_slot) {
+         return m_pchData + GetSlotOffset(un_slot) + KILOBOT_STATE_SLOT_SIZE;
+      }
+
+      /**
+       * Returns the behavior parameters area in the given slot.
+       * The area is KILOBOT_PARAMS_SIZE bytes long.
+       * @see kilo_get_param
+       */
+      inline char* GetParams(UInt32 un_slot) {
+         return m_pchData + GetSlotOffset(un_slot) + KILOBOT_STATE_SLOT_SIZE + m_unDebugInfoSize;
+      }
+
+      /**
+       * Returns the offset of the given slot from the start of the arena.
+       */
+      inline size_t GetSlotOffset(UInt32 un_slot) const {
+         return un_slot * m_unSlotSize;
+      }
+
+      /**
+       * Returns the space reserved for the debug info in each slot.
+       */
+      inline UInt32 GetDebugInfoSize() const {
+         return m_unDebugInfoSize;
+      }
+
+      /**
+       * Returns the size of a slot.
+       */
+      inline size_t GetSlotSize() const {
+         return m_unSlotSize;
+      }
+
+      /**
+       * Returns one past the highest slot ever allocated.
+       * The states of all the robots are in slots [0, GetNumSlots()), some of
+       * which might be free.
+       */
+      inline UInt32 GetNumSlots() const {
+         return m_vecSlotUsed.size();
+      }
+
+      /**
+       * Returns true if the given slot is allocated.
+       */
+      inline bool IsSlotUsed(UInt32 un_slot) const {
+         return m_vecSlotUsed[un_slot];
+      }
+
+      /**
+       * Returns the name of the shared memory area.
+       */
+      inline const std::string& GetName() const {
+         return m_strName;
+      }
+
+      /**
+       * Returns the file descriptor of the shared memory area.
+       */
+      inline int GetFD() const {
+         return m_nFD;
+      }
+
+   private:
+
+      CKilobotStateArena(UInt32 un_debug_info_size);
+      ~CKilobotStateArena();
+
+   private:
+
+      /** The arena, if created */
+      static CKilobotStateArena* m_pcInstance;
+
+      /** The number of users of the arena */
+      static UInt32 m_unUsers;
+
+      /** Name of the shared memory area */
+      std::string m_strName;
+
+      /** File descriptor of the shared memory area */
+      int m_nFD;
+
+      /** The mapped shared memory area */
+      char* m_pchData;
+
+      /** Space reserved for the debug info in each slot */
+      UInt32 m_unDebugInfoSize;
+
+      /** Size of a slot */
+      size_t m_unSlotSize;
+
+      /** Size of the shared memory area */
+      size_t m_unSize;
+
+      /** Which slots are allocated */
+      std::vector<bool> m_vecSlotUsed;
+
+      /** The free slots below GetNumSlots(), lowest last */
+      std::vector<UInt32> m_vecFreeSlots;
+
+   };
+
+}
+
+#endif
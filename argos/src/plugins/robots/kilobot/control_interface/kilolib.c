@@ -8,7 +8,14 @@
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
+#include <time.h>
 #include <ctype.h>
+#ifdef KILOLIB_INPROCESS
+#include <ucontext.h>
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 /*
  * Mersenne-Twister-related constants
@@ -87,9 +94,74 @@ static float     kilo_tx_clock     = 0.0f; // message transmission clock in ms
 static float     kilo_delay        = 0.0f; // delay clock in ms
 static uint8_t   kilo_seed         = 0xAA; // default random seed
 static uint8_t   kilo_accumulator  = 0;    // rng accumulator
+#ifndef KILOLIB_INPROCESS
 static int       kilo_state_fd     = -1;   // shared memory file
+#endif
 kilobot_state_t* kilo_state        = NULL; // shared robot state
 char*            kilo_str_id       = NULL; // kilobot id as string
+uint32_t         kilo_debug_info_size = KILOBOT_DEBUG_INFO_SIZE; // space for the debug info after kilo_state
+
+#ifdef KILOLIB_INPROCESS
+/*
+ * Fiber-related variables
+ *
+ * An in-process behavior runs on its own stack. Suspending it means
+ * switching back to the stack of ARGoS, which resumes it at the next
+ * control step.
+ */
+#ifndef KILOLIB_FIBER_STACK_SIZE
+#define KILOLIB_FIBER_STACK_SIZE (256 * 1024)
+#endif
+static ucontext_t kilo_argos_context;    // where ARGoS resumed the behavior from
+static ucontext_t kilo_fiber_context;    // where the behavior suspended itself
+static char*      kilo_fiber_stack = NULL;
+static size_t     kilo_fiber_stack_size = 0;
+static int        kilo_fiber_done = 0;   // set when the main of the behavior returns
+#endif
+
+#if !defined(KILOLIB_INPROCESS) && defined(__linux__)
+static uint32_t  kilo_step         = 0;    // last step requested by ARGoS in batch mode
+static uint32_t  kilo_reset        = 0;    // last reset requested by ARGoS and completed
+static sigset_t  kilo_reset_signal;        // SIGUSR1, unblocked only while suspended
+static pid_t     kilo_parent_pid   = 0;    // ARGoS, which the behavior must not outlive
+#endif
+
+/* Suspends the behavior, waiting for ARGoS controller's resume */
+static void kilo_suspend(int signum) {
+#ifdef KILOLIB_INPROCESS
+   swapcontext(&kilo_fiber_context, &kilo_argos_context);
+#else
+#ifdef __linux__
+   /* ARGoS can reset the behavior only while it is suspended */
+   sigprocmask(SIG_UNBLOCK, &kilo_reset_signal, NULL);
+   if(kilo_state->batch) {
+      /* Tell ARGoS that the step, or the reset, is done */
+      __atomic_store_n(&kilo_state->step_done, kilo_step, __ATOMIC_RELEASE);
+      syscall(SYS_futex, &kilo_state->step_done, FUTEX_WAKE, 1, NULL, NULL, 0);
+      if(__atomic_load_n(&kilo_state->reset_done, __ATOMIC_RELAXED) != kilo_reset) {
+         __atomic_store_n(&kilo_state->reset_done, kilo_reset, __ATOMIC_RELEASE);
+         syscall(SYS_futex, &kilo_state->reset_done, FUTEX_WAKE, 1, NULL, NULL, 0);
+      }
+      /* Wait for ARGoS to request the next step, and quit if ARGoS is gone */
+      while(__atomic_load_n(&kilo_state->step_request, __ATOMIC_ACQUIRE) == kilo_step) {
+         struct timespec timeout = { 1, 0 };
+         if(syscall(SYS_futex, &kilo_state->step_request, FUTEX_WAIT, kilo_step, &timeout, NULL, 0) < 0 &&
+            errno == ETIMEDOUT &&
+            getppid() != kilo_parent_pid) {
+            exit(1);
+         }
+      }
+      kilo_step = __atomic_load_n(&kilo_state->step_request, __ATOMIC_ACQUIRE);
+   }
+   else {
+      raise(signum);
+   }
+   sigprocmask(SIG_BLOCK, &kilo_reset_signal, NULL);
+#else
+   raise(signum);
+#endif
+#endif
+}
 
 void preloop() {
    /* Update tick count */
@@ -140,8 +212,8 @@ void delay(uint16_t ms) {
    kilo_delay = ms;
    postloop();
    while(kilo_delay > 0.0f) {
-      /* Suspend process, waiting for ARGoS controller's resume signal */
-      raise(SIGTSTP);
+      /* Suspend, waiting for ARGoS controller's resume signal */
+      kilo_suspend(SIGTSTP);
       /* Update state */
       preloop();
       /* Are we done waiting? */
@@ -197,13 +269,85 @@ void set_color(uint8_t color) {
    kilo_state->color = color;
 }
 
+const char* kilo_get_param(const char* name) {
+   /* The parameters follow the debug info in the slot of the robot */
+   const char* param = (const char*)kilo_state + KILOBOT_STATE_SLOT_SIZE + kilo_debug_info_size;
+   const char* end   = param + KILOBOT_PARAMS_SIZE;
+   while(param < end && *param != '\0') {
+      const char* value = param + strnlen(param, end - param) + 1;
+      if(value >= end) break;
+      if(strcmp(param, name) == 0) return value;
+      param = value + strnlen(value, end - value) + 1;
+   }
+   return NULL;
+}
+
+double kilo_get_param_double(const char* name, double default_value) {
+   const char* value = kilo_get_param(name);
+   if(value == NULL) return default_value;
+   char* value_end;
+   double result = strtod(value, &value_end);
+   if(value_end == value || *value_end != '\0') {
+      /* Do not exit: an in-process behavior would take ARGoS down with it */
+      fprintf(stderr, "Parameter \"%s\" of %s is not a number: \"%s\", using %g\n", name, kilo_str_id, value, default_value);
+      return default_value;
+   }
+   return result;
+}
+
 void kilo_init() {
 }
 
+#ifdef KILOLIB_INPROCESS
+
+/*
+ * Private C library random number generator
+ *
+ * The glibc reentrant functions reproduce exactly the sequence of rand(),
+ * so a behavior gets the same numbers as when it runs in its own process.
+ */
+#ifdef __GLIBC__
+static char               kilo_libc_rand_buf[128];
+static struct random_data kilo_libc_rand_data;
+#else
+static unsigned int       kilo_libc_rand_seed = 1;
+#endif
+static int                kilo_libc_rand_init = 0;
+
+void kilo_libc_srand(unsigned int seed) {
+#ifdef __GLIBC__
+   if(!kilo_libc_rand_init) {
+      initstate_r(seed, kilo_libc_rand_buf, sizeof(kilo_libc_rand_buf), &kilo_libc_rand_data);
+   }
+   else {
+      srandom_r(seed, &kilo_libc_rand_data);
+   }
+#else
+   kilo_libc_rand_seed = seed;
+#endif
+   kilo_libc_rand_init = 1;
+}
+
+int kilo_libc_rand(void) {
+   if(!kilo_libc_rand_init) kilo_libc_srand(1);
+#ifdef __GLIBC__
+   int32_t r;
+   random_r(&kilo_libc_rand_data, &r);
+   return r;
+#else
+   return rand_r(&kilo_libc_rand_seed);
+#endif
+}
+
+#else
+
+/* Start and length of the mapping of the state arena */
+static void*     kilo_slot_map     = NULL;
+static size_t    kilo_slot_map_len = 0;
+
 void cleanup() {
-   munmap(kilo_state, sizeof(kilobot_state_t));
+   munmap(kilo_slot_map, kilo_slot_map_len);
    close(kilo_state_fd);
-   shm_unlink(kilo_str_id);
 }
 
 void sigterm_handler(int s) {
@@ -211,15 +355,19 @@ void sigterm_handler(int s) {
    exit(0);
 }
 
+#endif // KILOLIB_INPROCESS
+
 void kilo_start(void (*setup)(void), void (*loop)(void)) {
+#ifndef KILOLIB_INPROCESS
    /* Install handler for SIGTERM */
    signal(SIGTERM, sigterm_handler);
+#endif
    /* Execute setup() */
    setup();
    /* Continue working until killed by ARGoS controller */
    while(1) {
       /* Suspend yourself, waiting for ARGoS controller's resume signal */
-      raise(SIGSTOP);
+      kilo_suspend(SIGSTOP);
       /* Resumed */
       /* Execute loop */
       preloop();
@@ -241,61 +389,199 @@ static uint16_t argos_id_to_kilo_uid(const char* argos_id) {
    return strtoul(argos_id + pos, NULL, 10);
 }
 
+/* Sets the library state that depends on the robot and on the simulation */
+static void kilo_setup_state(float tick_length, uint32_t seed) {
+   /* Set uid */
+   kilo_uid = argos_id_to_kilo_uid(kilo_str_id);
+   /* Set kilo_ticks delta */
+   kilo_ticks_delta = tick_length * TICKS_PER_SEC;
+   kilo_ms_delta = kilo_ticks_delta / TICKS_PER_SEC * 1000.0;
+   /* Initialize random number generator */
+   mt_rngstate = (int32_t*)malloc(MT_N * sizeof(int32_t));
+   mt_rngidx = MT_N + 1;
+   mt_setseed(seed);
+}
+
 /* main() wrapper */
 int __kilobot_main(int argc, char* argv[]);
 #undef main
+
+#if !defined(KILOLIB_INPROCESS) && defined(__linux__)
+/*
+ * Reset-related variables
+ *
+ * ARGoS resets a behavior by sending SIGUSR1. The process executes its
+ * own executable again, with the same arguments and a last "reset" one,
+ * so it keeps its pid and ARGoS does not fork it again. Everything the
+ * behavior had is gone, its globals, its memory and the state of the C
+ * library, and its main() starts as after a fork.
+ */
+#define KILO_RESET_ARG "reset"
+static char* kilo_reset_argv[9];
+
+void sigusr1_handler(int s) {
+   /*
+    * The signal is unblocked only while the behavior is suspended, out of
+    * stdio, so the output of the behavior can be flushed here. It stays
+    * blocked through exec, until the behavior suspends itself again.
+    */
+   fflush(NULL);
+   execv("/proc/self/exe", kilo_reset_argv);
+   fprintf(stderr, "Resetting %s: %s\n", kilo_str_id, strerror(errno));
+   _exit(1);
+}
+#endif
+
+#ifdef KILOLIB_INPROCESS
+
+/* Entry point of the fiber */
+static void kilo_fiber_main() {
+   char* argv[2];
+   argv[0] = kilo_str_id;
+   argv[1] = NULL;
+   /* Call main of behavior */
+   __kilobot_main(1, argv);
+   /* Returning switches back to ARGoS through uc_link */
+   kilo_fiber_done = 1;
+}
+
+int kilo_inprocess_init(kilobot_state_t* state,
+                        const char* id,
+                        float tick_length,
+                        uint32_t seed,
+                        uint32_t debug_info_size) {
+   kilo_state = state;
+   kilo_str_id = strdup(id);
+   kilo_debug_info_size = debug_info_size;
+   kilo_setup_state(tick_length, seed);
+   /* Allocate the stack, with a guard page at the bottom to catch overflows */
+   size_t page_size = sysconf(_SC_PAGESIZE);
+   kilo_fiber_stack_size = KILOLIB_FIBER_STACK_SIZE + page_size;
+   kilo_fiber_stack = (char*)mmap(NULL,
+                                  kilo_fiber_stack_size,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS,
+                                  -1,
+                                  0);
+   if(kilo_fiber_stack == MAP_FAILED) {
+      fprintf(stderr, "Allocating the stack of %s: %s\n", kilo_str_id, strerror(errno));
+      kilo_fiber_stack = NULL;
+      return -1;
+   }
+   mprotect(kilo_fiber_stack, page_size, PROT_NONE);
+   /* Create the fiber */
+   getcontext(&kilo_fiber_context);
+   kilo_fiber_context.uc_stack.ss_sp   = kilo_fiber_stack + page_size;
+   kilo_fiber_context.uc_stack.ss_size = KILOLIB_FIBER_STACK_SIZE;
+   kilo_fiber_context.uc_link          = &kilo_argos_context;
+   makecontext(&kilo_fiber_context, kilo_fiber_main, 0);
+   /* Run main() and setup() until the behavior suspends itself */
+   swapcontext(&kilo_argos_context, &kilo_fiber_context);
+   return 0;
+}
+
+void kilo_inprocess_step() {
+   if(!kilo_fiber_done) {
+      swapcontext(&kilo_argos_context, &kilo_fiber_context);
+   }
+}
+
+void kilo_inprocess_destroy() {
+   if(kilo_fiber_stack) {
+      munmap(kilo_fiber_stack, kilo_fiber_stack_size);
+      kilo_fiber_stack = NULL;
+   }
+   free(mt_rngstate);
+   mt_rngstate = NULL;
+   free(kilo_str_id);
+   kilo_str_id = NULL;
+}
+
+#else
+
 int main(int argc, char* argv[]) {
    /* Parse arguments */
-   if(argc != 5) {
+   int reset = 0;
+#if defined(__linux__)
+   if(argc == 8 && strcmp(argv[7], KILO_RESET_ARG) == 0) {
+      /* Executed again by sigusr1_handler(), the behavior gets the usual arguments */
+      reset = 1;
+      argv[--argc] = NULL;
+   }
+#endif
+   if(argc != 7) {
       int i;
       fprintf(stderr, "Error: %s was given %d arguments\n", argv[0], argc);
       for(i = 0; i < argc; ++i) {
          fprintf(stderr, "\tARG %d: %s\n", i, argv[i]);
       }
-      fprintf(stderr, "Usage: <script> <pid> <robot_id> <tick_length> <random_seed>\n");
+      fprintf(stderr, "Usage: <script> <pid> <robot_id> <tick_length> <random_seed> <slot_offset> <debug_info_size>\n");
       exit(1);
    }
    kilo_str_id = strdup(argv[2]);
-   /* Open shared memory */
-   char* shm_fname = malloc(strlen(argv[1]) + strlen(argv[2]) + 3);
-   shm_fname[0] = '/';
-   shm_fname[1] = 0;
+   /* Open the state arena of ARGoS */
+   char* shm_fname = malloc(strlen(argv[1]) + 17);
+   strcpy(shm_fname, "/ARGoS_KILOBOTS_");
    strcat(shm_fname, argv[1]);
-   strcat(shm_fname, "_");
-   strcat(shm_fname, argv[2]);
-   kilo_state_fd = shm_open(shm_fname, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+   kilo_state_fd = shm_open(shm_fname, O_RDWR, S_IRUSR | S_IWUSR);
    free(shm_fname);
    if(kilo_state_fd < 0) {
       fprintf(stderr, "Opening the shared memory file of %s: %s\n", kilo_str_id, strerror(errno));
       exit(1);
    }
-   /* Resize shared memory area to contain the robot state, filling it with zeros */
-   ftruncate(kilo_state_fd, sizeof(kilobot_state_t));
-   /* Get pointer to shared memory area */
-   kilo_state =
-      (kilobot_state_t*)mmap(NULL,
-                             sizeof(kilobot_state_t),
-                             PROT_READ | PROT_WRITE,
-                             MAP_SHARED,
-                             kilo_state_fd,
-                             0);
-   if(kilo_state == MAP_FAILED) {
+   /* Map the pages that contain the slot of this robot */
+   size_t slot_offset = strtoul(argv[5], NULL, 10);
+   kilo_debug_info_size = strtoul(argv[6], NULL, 10);
+   size_t page_size = sysconf(_SC_PAGESIZE);
+   size_t map_offset = slot_offset - (slot_offset % page_size);
+   kilo_slot_map_len = slot_offset - map_offset + KILOBOT_SLOT_SIZE(kilo_debug_info_size);
+   kilo_slot_map = mmap(NULL,
+                        kilo_slot_map_len,
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED,
+                        kilo_state_fd,
+                        map_offset);
+   if(kilo_slot_map == MAP_FAILED) {
       fprintf(stderr, "Mmapping the shared memory area of %s: %s\n", kilo_str_id, strerror(errno));
       close(kilo_state_fd);
-      shm_unlink(kilo_str_id);
       exit(1);
    }
+   kilo_state = (kilobot_state_t*)((char*)kilo_slot_map + (slot_offset - map_offset));
    /* Install cleanup function */
    atexit(cleanup);
-   /* Set uid */
-   kilo_uid = argos_id_to_kilo_uid(kilo_str_id);
-   /* Set kilo_ticks delta */
-   kilo_ticks_delta = (strtof(argv[3], NULL) * TICKS_PER_SEC);
-   kilo_ms_delta = kilo_ticks_delta / TICKS_PER_SEC * 1000.0;
-   /* Initialize random number generator */
-   mt_rngstate = (int32_t*)malloc(MT_N * sizeof(int32_t));
-   mt_rngidx = MT_N + 1;
-   mt_setseed(strtoul(argv[4], NULL, 10));
+   /* Set uid, tick length and random seed */
+   kilo_setup_state(strtof(argv[3], NULL), strtoul(argv[4], NULL, 10));
+#if defined(__linux__)
+   /*
+    * ARGoS blocks SIGUSR1 before executing the behavior, so a reset sent
+    * early waits until the behavior first suspends itself, and so does
+    * sigusr1_handler() when it executes the behavior again.
+    */
+   kilo_parent_pid = strtol(argv[1], NULL, 10);
+   sigemptyset(&kilo_reset_signal);
+   sigaddset(&kilo_reset_signal, SIGUSR1);
+   sigprocmask(SIG_BLOCK, &kilo_reset_signal, NULL);
+   memcpy(kilo_reset_argv, argv, 7 * sizeof(char*));
+   kilo_reset_argv[7] = KILO_RESET_ARG;
+   kilo_reset_argv[8] = NULL;
+   signal(SIGUSR1, sigusr1_handler);
+   if(reset) {
+      /* Start from a clean state, with the seed ARGoS wrote for the reset */
+      uint8_t  batch      = kilo_state->batch;
+      uint32_t seed       = kilo_state->random_seed;
+      uint32_t request    = kilo_state->reset_request;
+      uint32_t reset_done = kilo_state->reset_done;
+      memset(kilo_state, 0, sizeof(kilobot_state_t));
+      kilo_state->batch         = batch;
+      kilo_state->reset_request = request;
+      kilo_state->reset_done    = reset_done;
+      /* Published at the first suspension, when setup() is over or delays */
+      kilo_reset = request;
+      mt_setseed(seed);
+   }
+#endif
    /* Call main of behavior */
    return __kilobot_main(argc, argv);
 }
+
+#endif // KILOLIB_INPROCESS
@@ -47,6 +47,16 @@
  */
 #define main __kilobot_main
 
+#ifdef KILOLIB_INPROCESS
+/**
+ * When the behavior is loaded inside the ARGoS process, the C library
+ * random number generator would be shared by all the robots. Redirect it
+ * to a generator that is private to each robot.
+ */
+#define rand  kilo_libc_rand
+#define srand kilo_libc_srand
+#endif
+
 /**
  * @brief Distance measurement.
  *
@@ -540,6 +550,51 @@ void kilo_init();
  */
 void kilo_start(void (*setup)(void), void (*loop)(void));
 
+/**
+ * @brief Returns a parameter of the behavior.
+ *
+ * The parameters are the attributes of the <behavior_params> node in the
+ * <params> of the controller in the .argos file. They let you tune a
+ * behavior from the experiment file, without recompiling it.
+ *
+ * The parameters are available from the start of main(), and are kept
+ * when the behavior is reset.
+ *
+ * @param name the name of the parameter
+ * @return the value of the parameter, or NULL if it is not set
+ *
+ * @code
+ * <params behavior="build/behaviors/levy_walk" linearvelocity="0.01" angularvelocity="0.7">
+ *   <behavior_params levy_exponent="1.4" crw_exponent="0.9" />
+ * </params>
+ * @endcode
+ *
+ * @see kilo_get_param_double
+ */
+const char* kilo_get_param(const char* name);
+
+/**
+ * @brief Returns a numeric parameter of the behavior.
+ *
+ * @param name          the name of the parameter
+ * @param default_value the value returned when the parameter is not set
+ *                      or is not a number
+ * @return the value of the parameter, or @p default_value
+ *
+ * A value that is not a number is reported on stderr.
+ *
+ * @code
+ * double levy_exponent;
+ *
+ * void setup() {
+ *    levy_exponent = kilo_get_param_double("levy_exponent", 1.4);
+ * }
+ * @endcode
+ *
+ * @see kilo_get_param
+ */
+double kilo_get_param_double(const char* name, double default_value);
+
 
 /**
  * Maximum number of messages received by a Kilobot in a timestep
@@ -566,8 +621,110 @@ typedef struct {
    uint8_t                left_motor;     // used by set_motors()
    uint8_t                right_motor;    // used by set_motors()
    uint8_t                color;          // used by set_color()
+   uint8_t                batch;          // 1 = resumed through step_request instead of signals
+   uint32_t               step_request;   // # of steps requested by ARGoS, used as futex
+   uint32_t               step_done;      // # of steps completed by the behavior, used as futex
+   uint32_t               random_seed;    // seed for rand_hard() after a reset
+   uint32_t               reset_request;  // # of resets requested by ARGoS
+   uint32_t               reset_done;     // # of resets completed by the behavior, used as futex
 } kilobot_state_t;
 
+/**
+ * Size of a cache line, used to align the robot states in the state arena.
+ */
+#define KILOBOT_CACHE_LINE_SIZE 64
+
+/**
+ * Default space reserved for the debug info of each robot, right after its
+ * state. The attribute debug_info_size of the kilobot controllers sets a
+ * different size, rounded up to a whole number of cache lines.
+ * @see debug.h
+ */
+#define KILOBOT_DEBUG_INFO_SIZE 256
+
+/**
+ * Space reserved for the behavior parameters of each robot, after its
+ * debug info. The parameters are stored as a sequence of "name\0value\0"
+ * pairs, terminated by an empty name.
+ * @see kilo_get_param
+ */
+#define KILOBOT_PARAMS_SIZE 1024
+
+/**
+ * Space taken by a robot state in the state arena, rounded up to a whole
+ * number of cache lines so that no two robots share a cache line.
+ */
+#define KILOBOT_STATE_SLOT_SIZE                                   \
+   (((sizeof(kilobot_state_t) + KILOBOT_CACHE_LINE_SIZE - 1) /   \
+     KILOBOT_CACHE_LINE_SIZE) * KILOBOT_CACHE_LINE_SIZE)
+
+/**
+ * Space taken by a robot in the state arena: its state, then its debug
+ * info, then its behavior parameters.
+ *
+ * ARGoS keeps the slots of all the robots in a single shared memory area
+ * named /ARGoS_KILOBOTS_<pid>, and passes to each behavior the offset of
+ * its slot and the space reserved for the debug info.
+ */
+#define KILOBOT_SLOT_SIZE(debug_info_size) (KILOBOT_STATE_SLOT_SIZE + (debug_info_size) + KILOBOT_PARAMS_SIZE)
+
+#ifdef KILOLIB_INPROCESS
+
+/**
+ * @brief Private replacement for the C library rand().
+ *
+ * Returns the same sequence as rand() would in a separate process.
+ */
+int kilo_libc_rand(void);
+
+/**
+ * @brief Private replacement for the C library srand().
+ */
+void kilo_libc_srand(unsigned int seed);
+
+/**
+ * @brief Initializes a behavior loaded inside the ARGoS process.
+ *
+ * When kilolib is compiled with KILOLIB_INPROCESS, the behavior is built
+ * as a shared object that ARGoS loads once per robot. The behavior runs
+ * on its own stack: this function replaces main(), sets up the library
+ * state and runs the main() of the behavior until the behavior suspends
+ * itself, i.e., when setup() is over or when delay() is called.
+ *
+ * Do not use this in your own programs.
+ *
+ * @param state       The robot state shared with ARGoS.
+ * @param id          The ARGoS id of the robot.
+ * @param tick_length The control step duration in seconds.
+ * @param seed        The random seed for rand_hard().
+ * @param debug_info_size The space reserved for the debug info after the state.
+ * @return 0 on success, -1 if the stack of the behavior could not be allocated.
+ */
+int kilo_inprocess_init(kilobot_state_t* state,
+                        const char* id,
+                        float tick_length,
+                        uint32_t seed,
+                        uint32_t debug_info_size);
+
+/**
+ * @brief Executes one control step of a behavior loaded inside the ARGoS process.
+ *
+ * Resumes the behavior until it suspends itself again, at the end of
+ * loop() or at the next tick of a delay().
+ *
+ * Do not use this in your own programs.
+ */
+void kilo_inprocess_step();
+
+/**
+ * @brief Releases the resources of a behavior loaded inside the ARGoS process.
+ *
+ * Do not use this in your own programs.
+ */
+void kilo_inprocess_destroy();
+
+#endif // KILOLIB_INPROCESS
+
 #ifdef __cplusplus /* If this is a C++ compiler, use C linkage */
 }
 #endif
@@ -11,12 +11,43 @@
  */
 
 #include "ALF.h"
+#include <argos3/core/simulator/visualization/default_visualization.h>
+#include <cstring>
 
 
 
+const UInt16 CALF::NO_KILOBOT_INDEX;
+const UInt32 CALF::FLOOR_TILE_SIZE;
+
+/****************************************/
+/****************************************/
+
+/*
+ * Returns the rotation around the Z axis of an orientation.
+ * This is the Z angle of CQuaternion::ToEulerAngles(), without computing
+ * the other two.
+ */
+static inline Real GetYaw(const CQuaternion& c_orientation) {
+    return ::atan2(2.0 * (c_orientation.GetX() * c_orientation.GetY() + c_orientation.GetW() * c_orientation.GetZ()),
+                   c_orientation.GetW() * c_orientation.GetW() + c_orientation.GetX() * c_orientation.GetX() -
+                   c_orientation.GetY() * c_orientation.GetY() - c_orientation.GetZ() * c_orientation.GetZ());
+}
+
+/****************************************/
+/****************************************/
+
 CALF::CALF():
+    m_pcMedium(NULL),
     m_fTimeForAMessage(0.05),
-    m_unEnvironmentPlotUpdateFrequency(10){
+    m_unEnvironmentPlotUpdateFrequency(10),
+    m_bPlotEnvironment(true),
+    m_unFloorPixelsPerMeter(0),
+    m_unFloorWidth(0),
+    m_unFloorHeight(0),
+    m_unFloorTilesX(0),
+    m_unFloorTilesY(0),
+    m_bFloorDirty(false),
+    m_bFloorChanged(false){
 }
 
 /****************************************/
@@ -25,14 +56,20 @@ CALF::CALF():
 void CALF::Init(TConfigurationNode& t_node) {
     /* Set the tracking type from the .argos file*/
     SetTrackingType(t_node);
+    /* Get the communication medium from the .argos file */
+    SetupMedium(t_node);
     /* Get experiment variables from the .argos file*/
     GetExperimentVariables(t_node);
+    /* Get the floor plotting options from the .argos file */
+    SetupFloor(t_node);
     /* Get the virtual environment from the .argos file */
     SetupVirtualEnvironments(t_node);
     /* Get the Kilobots entities from the space.*/
     GetKilobotsEntities();
     /* Get the initial kilobots' states */
     SetupInitialKilobotStates();
+    /* Draw the virtual environment in the floor raster */
+    UpdateFloorRaster();
 }
 
 /****************************************/
@@ -45,8 +82,12 @@ void CALF::PreStep(){
     UpdateKilobotStates();
     /* Update the virtual sensor of the kilobots*/
     UpdateVirtualSensors();
+    /* Send the ARK messages queued by the virtual sensors */
+    FlushARKMessages();
     /* Update the virtual environment*/
     UpdateVirtualEnvironments();
+    /* Draw the changes of the virtual environment in the floor raster */
+    UpdateFloorRaster();
     /* Update the virtual environment plot*/
     PlotEnvironment();
 }
@@ -67,6 +108,31 @@ void CALF::GetKilobotsEntities(){
         ++it) {
         m_tKilobotEntities.push_back(any_cast<CKilobotEntity*>(it->second));
     }
+    /* Parse the Kilobot IDs once, so that the Update* hooks never do it */
+    m_vecKilobotIds.resize(m_tKilobotEntities.size());
+    UInt16 unMaxId = 0;
+    for(UInt16 it=0;it< m_tKilobotEntities.size();it++){
+        m_vecKilobotIds[it]=GetKilobotId(*m_tKilobotEntities[it]);
+        unMaxId=Max(unMaxId, m_vecKilobotIds[it]);
+    }
+    m_vecKilobotIndices.assign(m_tKilobotEntities.empty() ? 0 : unMaxId+1, NO_KILOBOT_INDEX);
+    for(UInt16 it=0;it< m_tKilobotEntities.size();it++){
+        if(m_vecKilobotIndices[m_vecKilobotIds[it]]!=NO_KILOBOT_INDEX){
+            THROW_ARGOSEXCEPTION("Kilobots \"" << m_tKilobotEntities[m_vecKilobotIndices[m_vecKilobotIds[it]]]->GetId() <<
+                                 "\" and \"" << m_tKilobotEntities[it]->GetId() <<
+                                 "\" have the same ID " << m_vecKilobotIds[it]);
+        }
+        m_vecKilobotIndices[m_vecKilobotIds[it]]=it;
+    }
+    /* Prepare the snapshot of the Kilobots' states */
+    m_vecKilobotAnchors.resize(m_tKilobotEntities.size());
+    for(UInt16 it=0;it< m_tKilobotEntities.size();it++){
+        m_vecKilobotAnchors[it]=&m_tKilobotEntities[it]->GetEmbodiedEntity().GetOriginAnchor();
+    }
+    m_vecKilobotsX.assign(m_tKilobotEntities.size(), 0.0);
+    m_vecKilobotsY.assign(m_tKilobotEntities.size(), 0.0);
+    m_vecKilobotsYaw.assign(m_tKilobotEntities.size(), 0.0);
+    m_vecKilobotsLed.assign(m_tKilobotEntities.size(), CColor::BLACK);
     /* Create Kilobots individual messages */
     m_tMessages=TKilobotsMessagesVector(m_tKilobotEntities.size());
 }
@@ -74,6 +140,33 @@ void CALF::GetKilobotsEntities(){
 /****************************************/
 /****************************************/
 
+void CALF::SetupMedium(TConfigurationNode& t_tree){
+    GetNodeAttributeOrDefault(t_tree, "medium", m_strMediumId, std::string("kilocomm"));
+    try {
+        m_pcMedium=&GetSimulator().GetMedium<CKilobotCommunicationMedium>(m_strMediumId);
+    }
+    catch(CARGoSException& ex) {
+        /* Without an explicit medium, the experiment may simply not use communication */
+        if(NodeAttributeExists(t_tree, "medium")) {
+            THROW_ARGOSEXCEPTION_NESTED("Error getting the communication medium of the ALF", ex);
+        }
+        m_pcMedium=NULL;
+    }
+}
+
+/****************************************/
+/****************************************/
+
+CKilobotCommunicationMedium& CALF::GetKilobotMedium(){
+    if(m_pcMedium==NULL){
+        THROW_ARGOSEXCEPTION("The ALF cannot send messages: no communication medium with id \"" << m_strMediumId << "\"");
+    }
+    return *m_pcMedium;
+}
+
+/****************************************/
+/****************************************/
+
 void CALF::SetTrackingType(TConfigurationNode& t_tree){
     TConfigurationNode& tTrackingNode=GetNode(t_tree,"tracking");
     GetNodeAttribute(tTrackingNode, "position", m_bPositionTracking);
@@ -85,9 +178,34 @@ void CALF::SetTrackingType(TConfigurationNode& t_tree){
 /****************************************/
 
 void CALF::UpdateKilobotStates(){
+    /* Take the snapshot of the states the experiment tracks */
+    UpdateKilobotsSnapshot();
     for(UInt16 it=0;it< m_tKilobotEntities.size();it++){
         /* Update the virtual states and actuators of the kilobot*/
-        UpdateKilobotState(*m_tKilobotEntities[it]);
+        UpdateKilobotState(*m_tKilobotEntities[it], it);
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::UpdateKilobotsSnapshot(){
+    /* One loop per state, so that each array is written sequentially */
+    if(m_bPositionTracking){
+        for(size_t i=0;i<m_vecKilobotAnchors.size();++i){
+            m_vecKilobotsX[i]=m_vecKilobotAnchors[i]->Position.GetX();
+            m_vecKilobotsY[i]=m_vecKilobotAnchors[i]->Position.GetY();
+        }
+    }
+    if(m_bOrientationTracking){
+        for(size_t i=0;i<m_vecKilobotAnchors.size();++i){
+            m_vecKilobotsYaw[i]=GetYaw(m_vecKilobotAnchors[i]->Orientation);
+        }
+    }
+    if(m_bColorTracking){
+        for(size_t i=0;i<m_tKilobotEntities.size();++i){
+            m_vecKilobotsLed[i]=GetKilobotLedColor(*m_tKilobotEntities[i]);
+        }
     }
 }
 
@@ -95,9 +213,22 @@ void CALF::UpdateKilobotStates(){
 /****************************************/
 
 void CALF::UpdateVirtualSensors(){
+    /* Give the subclass a chance to update the whole swarm at once */
+    m_tALFKilobotMessage tEmptyMessage;
+    tEmptyMessage.m_sID=ARK_EMPTY_ID;
+    tEmptyMessage.m_sType=0;
+    tEmptyMessage.m_sData=0;
+    m_vecARKPayloads.assign(m_tKilobotEntities.size(), tEmptyMessage);
+    if(UpdateVirtualSensorsBatch(m_vecARKPayloads)){
+        for(UInt16 it=0;it< m_tKilobotEntities.size();it++){
+            if(m_vecARKPayloads[it].m_sID!=ARK_EMPTY_ID)
+                QueueARKMessage(*m_tKilobotEntities[it], m_vecARKPayloads[it]);
+        }
+        return;
+    }
     for(UInt16 it=0;it< m_tKilobotEntities.size();it++){
         /* Update the virtual sensor of a kilobot based on its current state */
-        UpdateVirtualSensor(*m_tKilobotEntities[it]);
+        UpdateVirtualSensor(*m_tKilobotEntities[it], it);
     }
 }
 
@@ -108,7 +239,7 @@ void CALF::UpdateVirtualEnvironments(){
     /* Updates the virtual environments  based on the kilobots' states */
     for(UInt16 it=0;it< m_tKilobotEntities.size();it++){
         /* Let a kilobot modify the virtual environment  */
-        UpdatesVirtualEnvironmentsBasedOnKilobotState(*m_tKilobotEntities[it]);
+        UpdatesVirtualEnvironmentsBasedOnKilobotState(*m_tKilobotEntities[it], it);
     }
 }
 
@@ -126,10 +257,7 @@ CVector2 CALF::GetKilobotPosition(CKilobotEntity& c_kilobot_entity) {
 /****************************************/
 
 CRadians CALF::GetKilobotOrientation(CKilobotEntity& c_kilobot_entity) {
-    CRadians cZAngle, cYAngle, cXAngle;
-    //Calculate the orientations of the kilobot
-    c_kilobot_entity.GetEmbodiedEntity().GetOriginAnchor().Orientation.ToEulerAngles(cZAngle, cYAngle, cXAngle);
-    return cZAngle;
+    return CRadians(GetYaw(c_kilobot_entity.GetEmbodiedEntity().GetOriginAnchor().Orientation));
 }
 
 /****************************************/
@@ -149,8 +277,185 @@ CColor CALF::GetKilobotLedColor(CKilobotEntity& c_kilobot_entity) {
 /****************************************/
 /****************************************/
 
+void CALF::QueueARKMessage(CKilobotEntity& c_kilobot_entity,
+                           const m_tALFKilobotMessage& t_message){
+    m_vecARKRecipients.push_back(&c_kilobot_entity);
+    m_vecARKMessages.push_back(t_message);
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::FlushARKMessages(){
+    if(m_vecARKMessages.empty())
+        return;
+    CKilobotCommunicationMedium& cMedium = GetKilobotMedium();
+    /* Prepare an empty ARK-type message to fill the gaps in the last kilobot message */
+    m_tALFKilobotMessage tEmptyMessage;
+    tEmptyMessage.m_sID=ARK_EMPTY_ID;
+    tEmptyMessage.m_sType=0;
+    tEmptyMessage.m_sData=0;
+    message_t tMessage;
+    for(size_t i=0;i<m_vecARKMessages.size();i+=3){
+        ::memset(&tMessage, 0, sizeof(message_t));
+        m_vecARKBatch.clear();
+        /* Fill the kilobot message with up to three ARK-type messages */
+        for(UInt8 j=0;j<3;++j){
+            if(i+j<m_vecARKMessages.size()){
+                PackARKMessage(tMessage, j, m_vecARKMessages[i+j]);
+                m_vecARKBatch.push_back(m_vecARKRecipients[i+j]);
+            }
+            else{
+                PackARKMessage(tMessage, j, tEmptyMessage);
+            }
+        }
+        /* The recipients share the same message, and each reads its own slot */
+        cMedium.SendOHCMessageTo(m_vecARKBatch, &tMessage);
+    }
+    m_vecARKMessages.clear();
+    m_vecARKRecipients.clear();
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::PackARKMessage(message_t& t_message,
+                          UInt8 un_slot,
+                          const m_tALFKilobotMessage& t_ark_message){
+    t_message.data[un_slot*3] = (t_ark_message.m_sID >> 2);
+    t_message.data[1+un_slot*3] = (t_ark_message.m_sID << 6);
+    t_message.data[1+un_slot*3] = t_message.data[1+un_slot*3] | (t_ark_message.m_sType << 2);
+    t_message.data[1+un_slot*3] = t_message.data[1+un_slot*3] | (t_ark_message.m_sData >> 8);
+    t_message.data[2+un_slot*3] = t_ark_message.m_sData;
+}
+
+/****************************************/
+/****************************************/
+
 void CALF::PlotEnvironment(){
+    /* Nobody looks at the floor */
+    if(!m_bPlotEnvironment)
+        return;
+    /* With the floor raster cache, the floor needs plotting only if it changed */
+    if(m_unFloorPixelsPerMeter>0 && !m_bFloorChanged)
+        return;
     /* Update the Floor visualization of the virtual environment every m_unEnvironmentPlotUpdateFrequency ticks*/
-    if(GetSpace().GetSimulationClock()%m_unEnvironmentPlotUpdateFrequency==0)
+    if(GetSpace().GetSimulationClock()%m_unEnvironmentPlotUpdateFrequency==0){
         GetSpace().GetFloorEntity().SetChanged();
+        m_bFloorChanged=false;
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::SetupFloor(TConfigurationNode& t_tree){
+    /* By default, plot only if there is somebody to look at the plot */
+    m_bPlotEnvironment=(dynamic_cast<CDefaultVisualization*>(&GetSimulator().GetVisualization())==NULL);
+    /*
+     * The floor raster cache is off unless the loop functions ask for it:
+     * with the cache, the floor is plotted only after InvalidateFloor(),
+     * which the ALFs written before it do not call
+     */
+    TConfigurationNode& tArena=GetNode(GetSimulator().GetConfigurationRoot(), "arena");
+    m_unFloorPixelsPerMeter=0;
+    if(NodeExists(t_tree, "floor")){
+        TConfigurationNode& tFloorNode=GetNode(t_tree, "floor");
+        GetNodeAttributeOrDefault(tFloorNode, "plot", m_bPlotEnvironment, m_bPlotEnvironment);
+        GetNodeAttributeOrDefault(tFloorNode, "pixels_per_meter", m_unFloorPixelsPerMeter, m_unFloorPixelsPerMeter);
+    }
+    m_vecFloorPixels.clear();
+    m_vecFloorTileDirty.clear();
+    if(m_unFloorPixelsPerMeter==0)
+        return;
+    /* Cover the arena with the raster */
+    CVector3 cArenaCenter;
+    CVector3 cArenaSize;
+    GetNodeAttribute(tArena, "size", cArenaSize);
+    GetNodeAttributeOrDefault(tArena, "center", cArenaCenter, cArenaCenter);
+    m_cFloorOrigin.Set(cArenaCenter.GetX() - cArenaSize.GetX() * 0.5,
+                       cArenaCenter.GetY() - cArenaSize.GetY() * 0.5);
+    m_unFloorWidth=Max<UInt32>(1, Ceil(cArenaSize.GetX() * m_unFloorPixelsPerMeter));
+    m_unFloorHeight=Max<UInt32>(1, Ceil(cArenaSize.GetY() * m_unFloorPixelsPerMeter));
+    m_unFloorTilesX=(m_unFloorWidth + FLOOR_TILE_SIZE - 1) / FLOOR_TILE_SIZE;
+    m_unFloorTilesY=(m_unFloorHeight + FLOOR_TILE_SIZE - 1) / FLOOR_TILE_SIZE;
+    m_vecFloorPixels.resize(m_unFloorWidth * m_unFloorHeight);
+    m_vecFloorTileDirty.resize(m_unFloorTilesX * m_unFloorTilesY);
+    /* Nothing is drawn yet */
+    InvalidateFloor();
+}
+
+/****************************************/
+/****************************************/
+
+CColor CALF::GetFloorColor(const CVector2& c_pos_on_floor){
+    if(m_unFloorPixelsPerMeter==0)
+        return ComputeFloorColor(c_pos_on_floor);
+    Real fX=(c_pos_on_floor.GetX() - m_cFloorOrigin.GetX()) * m_unFloorPixelsPerMeter;
+    Real fY=(c_pos_on_floor.GetY() - m_cFloorOrigin.GetY()) * m_unFloorPixelsPerMeter;
+    /* Outside the raster, or not drawn yet */
+    if(fX<0.0 || fY<0.0 || fX>=m_unFloorWidth || fY>=m_unFloorHeight)
+        return ComputeFloorColor(c_pos_on_floor);
+    UInt32 unX=static_cast<UInt32>(fX);
+    UInt32 unY=static_cast<UInt32>(fY);
+    if(m_vecFloorTileDirty[(unY / FLOOR_TILE_SIZE) * m_unFloorTilesX + unX / FLOOR_TILE_SIZE])
+        return ComputeFloorColor(c_pos_on_floor);
+    return m_vecFloorPixels[unY * m_unFloorWidth + unX];
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::InvalidateFloor(){
+    m_vecFloorTileDirty.assign(m_vecFloorTileDirty.size(), true);
+    m_bFloorDirty=true;
+    m_bFloorChanged=true;
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::InvalidateFloor(const CVector2& c_min, const CVector2& c_max){
+    m_bFloorChanged=true;
+    if(m_unFloorPixelsPerMeter==0)
+        return;
+    /* Tiles that overlap the rectangle, clamped to the raster */
+    Real fTileSize=static_cast<Real>(FLOOR_TILE_SIZE) / m_unFloorPixelsPerMeter;
+    SInt32 nMinX=Max<SInt32>(0, Floor((c_min.GetX() - m_cFloorOrigin.GetX()) / fTileSize));
+    SInt32 nMinY=Max<SInt32>(0, Floor((c_min.GetY() - m_cFloorOrigin.GetY()) / fTileSize));
+    SInt32 nMaxX=Min<SInt32>(m_unFloorTilesX - 1, Floor((c_max.GetX() - m_cFloorOrigin.GetX()) / fTileSize));
+    SInt32 nMaxY=Min<SInt32>(m_unFloorTilesY - 1, Floor((c_max.GetY() - m_cFloorOrigin.GetY()) / fTileSize));
+    for(SInt32 nY=nMinY;nY<=nMaxY;++nY){
+        for(SInt32 nX=nMinX;nX<=nMaxX;++nX){
+            m_vecFloorTileDirty[nY * m_unFloorTilesX + nX]=true;
+            m_bFloorDirty=true;
+        }
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::UpdateFloorRaster(){
+    if(!m_bFloorDirty)
+        return;
+    /* Each pixel takes the color at its center */
+    Real fPixelSize=1.0 / m_unFloorPixelsPerMeter;
+    for(UInt32 unTileY=0;unTileY<m_unFloorTilesY;++unTileY){
+        for(UInt32 unTileX=0;unTileX<m_unFloorTilesX;++unTileX){
+            if(!m_vecFloorTileDirty[unTileY * m_unFloorTilesX + unTileX])
+                continue;
+            UInt32 unMaxY=Min(m_unFloorHeight, (unTileY + 1) * FLOOR_TILE_SIZE);
+            UInt32 unMaxX=Min(m_unFloorWidth, (unTileX + 1) * FLOOR_TILE_SIZE);
+            for(UInt32 unY=unTileY * FLOOR_TILE_SIZE;unY<unMaxY;++unY){
+                for(UInt32 unX=unTileX * FLOOR_TILE_SIZE;unX<unMaxX;++unX){
+                    m_vecFloorPixels[unY * m_unFloorWidth + unX]=
+                        ComputeFloorColor(CVector2(m_cFloorOrigin.GetX() + (unX + 0.5) * fPixelSize,
+                                                   m_cFloorOrigin.GetY() + (unY + 0.5) * fPixelSize));
+                }
+            }
+            m_vecFloorTileDirty[unTileY * m_unFloorTilesX + unTileX]=false;
+        }
+    }
+    m_bFloorDirty=false;
 }
@@ -121,11 +121,22 @@ public:
     /**
      * Gets a vector of all the Kilobot entities in the space
      * This function must be excuted at initialization before trying to get Kilobots states (id,position,orientation...).
+     * It also builds the tables between the index of a Kilobot in this vector and its ID.
      * @see init
      * @see SetupInitialKilobotStates
+     * @see GetKilobotIndex
      */
     void GetKilobotsEntities();
 
+    /**
+     * Gets the communication medium used to send messages to the Kilobots
+     * The medium is the one with the id given by the <tt>medium</tt> attribute of <tt>&lt;loop_functions&gt;</tt> (kilocomm by default).
+     * It is looked up once in Init().
+     * @param t_tree The <tt>&lt;loop_functions&gt;</tt> XML configuration tree.
+     * @see GetKilobotMedium
+     */
+    void SetupMedium(TConfigurationNode& t_tree);
+
     /**
      * Setups the initial state of the Kilobots in the space
      * The default implementation of this method does nothing.
@@ -141,6 +152,14 @@ public:
      */
     virtual void SetupInitialKilobotState(CKilobotEntity& c_kilobot_entity){}
 
+    /**
+     * Sets up the floor raster cache and the plotting of the virtual environment
+     * from the optional <tt>&lt;floor&gt;</tt> node of <tt>&lt;loop_functions&gt;</tt>.
+     * @param t_tree The <tt>&lt;loop_functions&gt;</tt> XML configuration tree.
+     * @see GetFloorColor
+     */
+    void SetupFloor(TConfigurationNode& t_tree);
+
     /**
      * Sets tracking type for the experiments (which kilobot states the used is interested to)
      * @param t_tree The <tt>&lt;loop_functions&gt;</tt> XML configuration tree.
@@ -163,11 +182,32 @@ public:
 
     /**
      * Gets the current state of the Kilobots
-     * The default implementation of this function go through the Kilobots and updates the state of each of them.
+     * The default implementation of this function takes a snapshot of the tracked states, then goes through the Kilobots and updates the state of each of them.
+     * @see UpdateKilobotsSnapshot
      * @see UpdateKilobotState
      */
     virtual void UpdateKilobotStates();
 
+    /**
+     * Takes a snapshot of the tracked states of all the Kilobots
+     * Only the states enabled in <tt>&lt;tracking&gt;</tt> are updated.
+     * @see m_vecKilobotsX
+     * @see SetTrackingType
+     */
+    void UpdateKilobotsSnapshot();
+
+    /**
+     * Gets the current state of a selected kilobot entity
+     * The default implementation calls UpdateKilobotState(c_kilobot_entity), so subclasses can override either.
+     * @param c_kilobot_entity A reference to the selected kilobot entity
+     * @param un_kilobot_index The index of the selected kilobot entity in m_tKilobotEntities
+     * @see UpdateKilobotStates
+     */
+    virtual void UpdateKilobotState(CKilobotEntity& c_kilobot_entity,
+                                    UInt16 un_kilobot_index){
+        UpdateKilobotState(c_kilobot_entity);
+    }
+
     /**
      * Gets the current state of a selected kilobot entity
      * @param c_kilobot_entity A reference to the selected kilobot entity
@@ -177,10 +217,24 @@ public:
 
     /**
      * Updates the virtual sensors of the Kilobots
-     * The default implementation of this function goes through the Kilobots and updates the virtual sensors of each of them.
+     * The default implementation of this function lets UpdateVirtualSensorsBatch() update the virtual sensors of all the Kilobots at once.
+     * If UpdateVirtualSensorsBatch() is not implemented, it goes through the Kilobots and updates the virtual sensors of each of them.
+     * @see UpdateVirtualSensorsBatch
      */
     virtual void UpdateVirtualSensors();
 
+    /**
+     * Updates the virtual sensor of a selected Kilobot entity according to its current state
+     * The default implementation calls UpdateVirtualSensor(c_kilobot_entity), so subclasses can override either.
+     * @param c_kilobot_entity A reference to the selected kilobot entity
+     * @param un_kilobot_index The index of the selected kilobot entity in m_tKilobotEntities
+     * @see UpdateVirtualSensors
+     */
+    virtual void UpdateVirtualSensor(CKilobotEntity& c_kilobot_entity,
+                                     UInt16 un_kilobot_index){
+        UpdateVirtualSensor(c_kilobot_entity);
+    }
+
     /**
      * Updates the virtual sensor of a selected Kilobot entity according to its current state
      * @param c_kilobot_entity A reference to the selected kilobot entity
@@ -196,6 +250,18 @@ public:
      */
     virtual void UpdateVirtualEnvironments();
 
+    /**
+     * Updates the virtual environment based on the state of selected kilobot entity
+     * The default implementation calls UpdatesVirtualEnvironmentsBasedOnKilobotState(c_kilobot_entity), so subclasses can override either.
+     * @param c_kilobot_entity A reference to the selected kilobot entity entity
+     * @param un_kilobot_index The index of the selected kilobot entity in m_tKilobotEntities
+     * @see SetupVirtualEnvironments
+     */
+    virtual void UpdatesVirtualEnvironmentsBasedOnKilobotState(CKilobotEntity& c_kilobot_entity,
+                                                               UInt16 un_kilobot_index){
+        UpdatesVirtualEnvironmentsBasedOnKilobotState(c_kilobot_entity);
+    }
+
     /**
      * Updates the virtual environment based on the state of selected kilobot entity
      * @param c_kilobot_entity A reference to the selected kilobot entity entity
@@ -217,10 +283,34 @@ public:
 
     /**
      * Get the ID of a selected Kilobot entity
+     * The ID is parsed from the id of the controller: in the Update* hooks, use the index overload instead.
      * @param c_kilobot_entity A reference to the selected kilobot entity
      */
     UInt16 GetKilobotId(CKilobotEntity& c_kilobot_entity);
 
+    /**
+     * Get the ID of the Kilobot entity with the given index
+     * @param un_kilobot_index The index of the kilobot entity in m_tKilobotEntities
+     */
+    inline UInt16 GetKilobotId(UInt16 un_kilobot_index) const {
+        return m_vecKilobotIds[un_kilobot_index];
+    }
+
+    /**
+     * Get the index in m_tKilobotEntities of the Kilobot entity with the given ID
+     * @param un_kilobot_id The ID of the kilobot entity
+     * @return The index, or NO_KILOBOT_INDEX if no Kilobot has that ID
+     */
+    inline UInt16 GetKilobotIndex(UInt16 un_kilobot_id) const {
+        return un_kilobot_id < m_vecKilobotIndices.size() ? m_vecKilobotIndices[un_kilobot_id] : NO_KILOBOT_INDEX;
+    }
+
+    /**
+     * Get the communication medium used to send messages to the Kilobots
+     * @see SetupMedium
+     */
+    CKilobotCommunicationMedium& GetKilobotMedium();
+
     /**
      * Get the LedColor of a selected Kilobot entity
      * @param c_kilobot_entity A reference to the selected kilobot entity
@@ -232,17 +322,50 @@ public:
      * This function is called if the floor entity was configured to take the loop functions
      * as source. The floor color is used by the ground sensors to calculate their readings,
      * and by the graphical visualization to create a texture to display on the arena floor.
+     * The default implementation returns ComputeFloorColor(). With the floor raster cache, enabled by
+     * <tt>&lt;floor pixels_per_meter="..."/&gt;</tt> in <tt>&lt;loop_functions&gt;</tt>, it reads the color from the cache instead.
+     * Subclasses that override this function directly should leave the cache disabled.
      * @param c_pos_on_floor The position on the floor.
      * @return The color of the floor in the specified point.
      * @see CFloorEntity
+     * @see ComputeFloorColor
      * @see PlotEnvironment
      */
-    virtual CColor GetFloorColor(const CVector2& c_pos_on_floor) {
+    virtual CColor GetFloorColor(const CVector2& c_pos_on_floor);
+
+    /**
+     * Computes the color of the virtual environment in the specified point.
+     * The result is cached in the floor raster, so this function is called again only for the regions passed to InvalidateFloor().
+     * The default implementation of this method returns white.
+     * @param c_pos_on_floor The position on the floor.
+     * @return The color of the floor in the specified point.
+     * @see InvalidateFloor
+     */
+    virtual CColor ComputeFloorColor(const CVector2& c_pos_on_floor) {
         return CColor::WHITE;
     }
 
+    /**
+     * Marks the whole floor as changed
+     * Call it when the virtual environment changes.
+     * @see ComputeFloorColor
+     */
+    void InvalidateFloor();
+
+    /**
+     * Marks a rectangle of the floor as changed
+     * Call it when the virtual environment changes in that rectangle.
+     * @param c_min The corner of the rectangle with the lowest coordinates
+     * @param c_max The corner of the rectangle with the highest coordinates
+     * @see ComputeFloorColor
+     */
+    void InvalidateFloor(const CVector2& c_min, const CVector2& c_max);
+
     /**
      * Plots the virtual environments on the arena surface
+     * Without the floor raster cache, the floor is plotted every m_unEnvironmentPlotUpdateFrequency ticks.
+     * With the cache, it is plotted again only if it was invalidated.
+     * Nothing is plotted in runs without visualization, unless <tt>&lt;floor plot="true"/&gt;</tt>.
      */
     void PlotEnvironment();
 
@@ -253,6 +376,32 @@ protected:
     typedef std::vector<CKilobotEntity*> TKilobotEntitiesVector;
     TKilobotEntitiesVector m_tKilobotEntities;
 
+    /** Index returned by GetKilobotIndex() for the IDs that no Kilobot has */
+    static const UInt16 NO_KILOBOT_INDEX = 0xFFFF;
+
+    /** ID of each Kilobot, by index in m_tKilobotEntities */
+    std::vector<UInt16> m_vecKilobotIds;
+
+    /** Index in m_tKilobotEntities of each Kilobot, by ID */
+    std::vector<UInt16> m_vecKilobotIndices;
+
+    /** Origin anchors of the Kilobots, by index in m_tKilobotEntities */
+    std::vector<const SAnchor*> m_vecKilobotAnchors;
+
+    /**
+     * Snapshot of the tracked states of the Kilobots, by index in m_tKilobotEntities
+     * The snapshot is taken at the beginning of every PreStep() by UpdateKilobotStates().
+     * The yaw is in radians, in [-pi,pi].
+     */
+    std::vector<Real> m_vecKilobotsX;
+    std::vector<Real> m_vecKilobotsY;
+    std::vector<Real> m_vecKilobotsYaw;
+    std::vector<CColor> m_vecKilobotsLed;
+
+    /** Id of the communication medium, and the medium itself (NULL if it does not exist) */
+    std::string m_strMediumId;
+    CKilobotCommunicationMedium* m_pcMedium;
+
     /** List of the messages sent by communication entities */
     typedef std::vector<message_t> TKilobotsMessagesVector;
     TKilobotsMessagesVector m_tMessages;
@@ -264,6 +413,60 @@ protected:
         UInt16 m_sData:10;
     } m_tALFKilobotMessage;
 
+    /** ID of the empty slots of a kilobot message, that no Kilobot has */
+    static const UInt16 ARK_EMPTY_ID = 1023;
+
+    /**
+     * Writes an ARK message in one of the three slots of a kilobot message
+     * @param t_message The kilobot message
+     * @param un_slot The slot (0, 1 or 2)
+     * @param t_ark_message The ARK message
+     */
+    static void PackARKMessage(message_t& t_message,
+                               UInt8 un_slot,
+                               const m_tALFKilobotMessage& t_ark_message);
+
+    /**
+     * Queues an ARK message for a selected Kilobot entity
+     * The queued messages are sent by FlushARKMessages(), three per kilobot message, as ARK does.
+     * @param c_kilobot_entity A reference to the recipient kilobot entity
+     * @param t_message The ARK message, whose ID must be the one of the recipient
+     * @see FlushARKMessages
+     */
+    void QueueARKMessage(CKilobotEntity& c_kilobot_entity,
+                         const m_tALFKilobotMessage& t_message);
+
+    /**
+     * Updates the virtual sensors of all the Kilobots at once
+     * Implement this function to compute the virtual sensors of the whole swarm from the snapshot (m_vecKilobotsX...).
+     * The messages are queued with QueueARKMessage() after the function returns.
+     * The default implementation does nothing and returns false, so that UpdateVirtualSensor() is called for each Kilobot.
+     * @param vec_messages The ARK message of each Kilobot, by index in m_tKilobotEntities.
+     * On entry, all the messages have ID ARK_EMPTY_ID; the Kilobots whose message keeps that ID get no message.
+     * @return true if the virtual sensors were updated
+     * @see UpdateVirtualSensors
+     */
+    virtual bool UpdateVirtualSensorsBatch(std::vector<m_tALFKilobotMessage>& vec_messages){
+        return false;
+    }
+
+    /** ARK messages filled by UpdateVirtualSensorsBatch(), by index in m_tKilobotEntities */
+    std::vector<m_tALFKilobotMessage> m_vecARKPayloads;
+
+    /**
+     * Packs the queued ARK messages three by three and sends them to their recipients
+     * The default implementation of PreStep() calls this function after UpdateVirtualSensors().
+     * @see QueueARKMessage
+     */
+    void FlushARKMessages();
+
+    /** ARK messages queued by QueueARKMessage() and their recipients */
+    std::vector<m_tALFKilobotMessage> m_vecARKMessages;
+    TKilobotEntitiesVector m_vecARKRecipients;
+
+    /** Recipients of the kilobot message being sent by FlushARKMessages() */
+    TKilobotEntitiesVector m_vecARKBatch;
+
     /** Tracking Flags*/
     bool m_bPositionTracking;
     bool m_bOrientationTracking;
@@ -277,6 +480,41 @@ protected:
 
     /** Virtual environment update frequency in ticks*/
     UInt16 m_unEnvironmentPlotUpdateFrequency;
+
+private:
+
+    /** Computes the colors of the floor raster in the tiles marked as changed */
+    void UpdateFloorRaster();
+
+private:
+
+    /** Side of the square tiles the floor raster is updated by, in pixels */
+    static const UInt32 FLOOR_TILE_SIZE = 32;
+
+    /** Whether the virtual environment is plotted at all */
+    bool m_bPlotEnvironment;
+
+    /** Resolution of the floor raster cache (0 if disabled) */
+    UInt32 m_unFloorPixelsPerMeter;
+
+    /** Corner of the floor raster with the lowest coordinates */
+    CVector2 m_cFloorOrigin;
+
+    /** Size of the floor raster, in pixels and in tiles */
+    UInt32 m_unFloorWidth;
+    UInt32 m_unFloorHeight;
+    UInt32 m_unFloorTilesX;
+    UInt32 m_unFloorTilesY;
+
+    /** Colors of the floor raster, row by row */
+    std::vector<CColor> m_vecFloorPixels;
+
+    /** Tiles of the floor raster to compute again */
+    std::vector<bool> m_vecFloorTileDirty;
+    bool m_bFloorDirty;
+
+    /** Whether the floor changed since it was last plotted */
+    bool m_bFloorChanged;
 };
 
 #endif
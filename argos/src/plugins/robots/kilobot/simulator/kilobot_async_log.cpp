@@ -0,0 +1,225 @@
+#include "kilobot_async_log.h"
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <argos3/core/utility/logging/argos_log.h>
+#include <cstring>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotAsyncLog::CKilobotAsyncLog() :
+      m_pcSink(NULL),
+      m_unRecordSize(0),
+      m_unCapacity(0),
+      m_ePolicy(OVERFLOW_BLOCK),
+      m_unHead(0),
+      m_unTail(0),
+      m_unDropped(0),
+      m_bWriterWaiting(false),
+      m_bProducerWaiting(false),
+      m_bStop(false),
+      m_bFailed(false) {}
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotAsyncLog::~CKilobotAsyncLog() {
+      try {
+         Stop();
+      }
+      catch(CARGoSException& ex) {
+         LOGERR << "[WARNING] " << ex.what() << std::endl;
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotAsyncLog::Start(CSink& c_sink,
+                                UInt32 un_record_size,
+                                UInt32 un_capacity,
+                                EOverflowPolicy e_policy) {
+      Stop();
+      if(un_record_size == 0) {
+         THROW_ARGOSEXCEPTION("The records of the ALF log must hold at least one value");
+      }
+      if(un_capacity == 0) {
+         THROW_ARGOSEXCEPTION("The ALF log must hold at least one record");
+      }
+      m_pcSink = &c_sink;
+      m_unRecordSize = un_record_size;
+      m_unCapacity = un_capacity;
+      m_ePolicy = e_policy;
+      m_vecRing.assign(static_cast<size_t>(un_capacity) * un_record_size, 0.0);
+      m_unHead = 0;
+      m_unTail = 0;
+      m_unDropped = 0;
+      m_bFailed = false;
+      m_strFailure.clear();
+      m_cWriter = std::thread(&CKilobotAsyncLog::WriterThread, this);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   Real* CKilobotAsyncLog::BeginRecord() {
+      if(m_pcSink == NULL) {
+         THROW_ARGOSEXCEPTION("The ALF log has not been started");
+      }
+      CheckFailure();
+      UInt64 unHead = m_unHead.load(std::memory_order_relaxed);
+      if(unHead - m_unTail.load() >= m_unCapacity) {
+         if(m_ePolicy == OVERFLOW_DROP) {
+            ++m_unDropped;
+            return NULL;
+         }
+         /* Wait for the writer thread to free a slot */
+         std::unique_lock<std::mutex> cLock(m_cMutex);
+         m_bProducerWaiting = true;
+         while(unHead - m_unTail.load() >= m_unCapacity && !m_bFailed) {
+            m_cProducerCondition.wait(cLock);
+         }
+         m_bProducerWaiting = false;
+         cLock.unlock();
+         CheckFailure();
+      }
+      return &m_vecRing[(unHead % m_unCapacity) * m_unRecordSize];
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotAsyncLog::CommitRecord() {
+      m_unHead.store(m_unHead.load(std::memory_order_relaxed) + 1);
+      /*
+       * The writer raises its flag before checking the ring, and we check
+       * the flag after publishing the record: either it sees the record, or
+       * we see that it sleeps
+       */
+      if(m_bWriterWaiting) {
+         std::lock_guard<std::mutex> cLock(m_cMutex);
+         m_cWriterCondition.notify_one();
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKilobotAsyncLog::Push(const Real* pf_record) {
+      Real* pfSlot = BeginRecord();
+      if(pfSlot == NULL) return false;
+      ::memcpy(pfSlot, pf_record, m_unRecordSize * sizeof(Real));
+      CommitRecord();
+      return true;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotAsyncLog::Flush() {
+      if(!IsRunning()) return;
+      {
+         std::unique_lock<std::mutex> cLock(m_cMutex);
+         m_bProducerWaiting = true;
+         while(m_unTail.load() != m_unHead.load(std::memory_order_relaxed) && !m_bFailed) {
+            m_cProducerCondition.wait(cLock);
+         }
+         m_bProducerWaiting = false;
+      }
+      CheckFailure();
+      /* The writer thread sleeps on an empty ring: the sink is ours */
+      m_pcSink->Flush();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotAsyncLog::Stop() {
+      if(!IsRunning()) return;
+      {
+         std::lock_guard<std::mutex> cLock(m_cMutex);
+         m_bStop = true;
+         m_cWriterCondition.notify_one();
+      }
+      /* The writer thread empties the ring before quitting */
+      m_cWriter.join();
+      m_bStop = false;
+      CSink* pcSink = m_pcSink;
+      m_pcSink = NULL;
+      if(m_unDropped > 0) {
+         LOGERR << "[WARNING] The ALF log dropped "
+                << m_unDropped
+                << " records: make it larger, or use the \"block\" overflow policy"
+                << std::endl;
+      }
+      CheckFailure();
+      pcSink->Flush();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotAsyncLog::EOverflowPolicy CKilobotAsyncLog::ParseOverflowPolicy(const std::string& str_policy) {
+      if(str_policy == "block") return OVERFLOW_BLOCK;
+      if(str_policy == "drop") return OVERFLOW_DROP;
+      THROW_ARGOSEXCEPTION("Unknown overflow policy \"" << str_policy << "\" for the ALF log, use \"block\" or \"drop\"");
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotAsyncLog::WriterThread() {
+      UInt64 unTail = m_unTail.load(std::memory_order_relaxed);
+      while(true) {
+         UInt64 unHead = m_unHead.load();
+         if(unTail == unHead) {
+            /* Sleep until a record is published or the log is stopped */
+            std::unique_lock<std::mutex> cLock(m_cMutex);
+            m_bWriterWaiting = true;
+            while(m_unHead.load() == unTail && !m_bStop) {
+               m_cWriterCondition.wait(cLock);
+            }
+            m_bWriterWaiting = false;
+            if(m_unHead.load() == unTail) return;
+            continue;
+         }
+         try {
+            for(; unTail != unHead; ++unTail) {
+               m_pcSink->Write(&m_vecRing[(unTail % m_unCapacity) * m_unRecordSize]);
+               /* Same handshake as in CommitRecord(), the other way round */
+               m_unTail.store(unTail + 1);
+               if(m_bProducerWaiting) {
+                  std::lock_guard<std::mutex> cLock(m_cMutex);
+                  m_cProducerCondition.notify_one();
+               }
+            }
+         }
+         catch(std::exception& ex) {
+            std::lock_guard<std::mutex> cLock(m_cMutex);
+            m_strFailure = ex.what();
+            m_bFailed = true;
+            m_cProducerCondition.notify_one();
+            return;
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotAsyncLog::CheckFailure() {
+      if(m_bFailed) {
+         std::string strFailure;
+         {
+            std::lock_guard<std::mutex> cLock(m_cMutex);
+            strFailure = m_strFailure;
+         }
+         THROW_ARGOSEXCEPTION("Writing the ALF log: " << strFailure);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
@@ -0,0 +1,179 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kilobot_async_log.h>
+ *
+ * @brief This file provides the asynchronous data acquisition log of the ALFs.
+ *
+ * The ALF copies fixed-size records of Reals into a single-producer,
+ * single-consumer ring buffer, and a writer thread hands them to a sink that
+ * formats and writes them. The simulation loop does not wait for the disk,
+ * unless the ring is full and the overflow policy is OVERFLOW_BLOCK.
+ *
+ * Only one thread, normally the one of the loop functions, may call the
+ * member functions of the log. The sink is called on the writer thread.
+ */
+
+#ifndef KILOBOT_ASYNC_LOG_H
+#define KILOBOT_ASYNC_LOG_H
+
+namespace argos {
+   class CKilobotAsyncLog;
+}
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace argos {
+
+   class CKilobotAsyncLog {
+
+   public:
+
+      /** What to do when a record is added to a full ring */
+      enum EOverflowPolicy {
+         /** Wait for the writer thread to make room */
+         OVERFLOW_BLOCK,
+         /** Discard the record and count it */
+         OVERFLOW_DROP
+      };
+
+      /**
+       * Formats and writes the records.
+       */
+      class CSink {
+
+      public:
+
+         virtual ~CSink() {}
+
+         /**
+          * Writes a record.
+          * Called on the writer thread. An exception stops the log, and is
+          * reported to the ALF by the next call to the log.
+          * @param pf_record The record.
+          */
+         virtual void Write(const Real* pf_record) = 0;
+
+         /**
+          * Flushes the written records to the file.
+          * Called on the thread of the ALF, when all the records have been written.
+          */
+         virtual void Flush() {}
+
+      };
+
+   public:
+
+      CKilobotAsyncLog();
+
+      /**
+       * Class destructor.
+       * Stops the log, writing the records left in the ring.
+       */
+      ~CKilobotAsyncLog();
+
+      /**
+       * Starts the writer thread.
+       * If the log is running, it is stopped first.
+       * @param c_sink The sink of the records. It must outlive the log, or the next Stop().
+       * @param un_record_size The number of Reals in a record.
+       * @param un_capacity The number of records in the ring.
+       * @param e_policy What to do when the ring is full.
+       */
+      void Start(CSink& c_sink,
+                 UInt32 un_record_size,
+                 UInt32 un_capacity = 1024,
+                 EOverflowPolicy e_policy = OVERFLOW_BLOCK);
+
+      /**
+       * Returns the slot of the next record.
+       * Fill the slot, then publish it with CommitRecord().
+       * @return The slot, or NULL if the ring is full and the record is dropped.
+       */
+      Real* BeginRecord();
+
+      /**
+       * Hands the record returned by the last BeginRecord() to the writer thread.
+       */
+      void CommitRecord();
+
+      /**
+       * Copies a record into the ring.
+       * @param pf_record The record, of the size given to Start().
+       * @return false if the record is dropped.
+       */
+      bool Push(const Real* pf_record);
+
+      /**
+       * Waits until all the records have been written, then flushes the sink.
+       * Call it before closing or reopening the file of the sink.
+       */
+      void Flush();
+
+      /**
+       * Writes the records left in the ring, flushes the sink and stops the writer thread.
+       */
+      void Stop();
+
+      inline bool IsRunning() const {
+         return m_cWriter.joinable();
+      }
+
+      /**
+       * Returns the number of records dropped since the log was started.
+       */
+      inline UInt64 GetNumDroppedRecords() const {
+         return m_unDropped;
+      }
+
+      /**
+       * Parses an overflow policy, "block" or "drop".
+       */
+      static EOverflowPolicy ParseOverflowPolicy(const std::string& str_policy);
+
+   private:
+
+      void WriterThread();
+
+      void CheckFailure();
+
+   private:
+
+      CSink* m_pcSink;
+      UInt32 m_unRecordSize;
+      UInt32 m_unCapacity;
+      EOverflowPolicy m_ePolicy;
+      /** The records, m_unCapacity slots of m_unRecordSize Reals */
+      std::vector<Real> m_vecRing;
+
+      /** Number of records published by the ALF */
+      std::atomic<UInt64> m_unHead;
+      /** Number of records written by the writer thread */
+      std::atomic<UInt64> m_unTail;
+      UInt64 m_unDropped;
+
+      /*
+       * The mutex is taken only to sleep and to wake up a sleeping thread:
+       * records go through the ring without locking
+       */
+      std::mutex m_cMutex;
+      std::condition_variable m_cWriterCondition;
+      std::condition_variable m_cProducerCondition;
+      std::atomic<bool> m_bWriterWaiting;
+      std::atomic<bool> m_bProducerWaiting;
+      /** Protected by m_cMutex */
+      bool m_bStop;
+      std::atomic<bool> m_bFailed;
+      /** Protected by m_cMutex */
+      std::string m_strFailure;
+      std::thread m_cWriter;
+
+   };
+
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "kilobot_communication_default_actuator.h"
+#include "kilobot_communication_medium.h"
 #include <argos3/core/simulator/entity/composable_entity.h>
 #include <argos3/core/simulator/simulator.h>
 
@@ -31,6 +32,10 @@ namespace argos {
    void CKilobotCommunicationDefaultActuator::SetMessage(message_t* pt_msg) {
       CCI_KilobotCommunicationActuator::SetMessage(pt_msg);
       m_pcCommEntity->SetTxStatus(CKilobotCommunicationEntity::TX_ATTEMPT);
+      /* Let the medium know, so that it need not look for transmitters */
+      if(m_pcCommEntity->HasMedium()) {
+         m_pcCommEntity->GetMedium().AddTransmitter(*m_pcCommEntity);
+      }
    }
 
    /****************************************/
@@ -45,7 +45,7 @@ namespace argos {
          /* Parse noise */
          GetNodeAttributeOrDefault(t_tree, "noise_std_dev", m_fDistanceNoiseStdDev, m_fDistanceNoiseStdDev);
          if(m_fDistanceNoiseStdDev > 0.0f)
-            m_pcRNG = CRandom::CreateRNG("argos");
+            m_pcRNG = new CKilobotRNG(m_pcRobot->GetId(), KILOBOT_RNG_COMM_SENSOR);
          /* Get Kilobot communication medium from id specified in the XML */
          std::string strMedium;
          GetNodeAttribute(t_tree, "medium", strMedium);
@@ -81,9 +81,8 @@ namespace argos {
        * OHC message processing
        */
       /* Get OHC message, if any */
-      message_t* ptOHCMsg = m_pcMedium->GetOHCMessageFor(*m_pcRobot);
-      if(ptOHCMsg != NULL) {
-         sPacket.Message = ptOHCMsg;
+      if(m_pcMedium->GetOHCMessageFor(*m_pcRobot, m_tOHCMessage)) {
+         sPacket.Message = &m_tOHCMessage;
          sPacket.Distance.low_gain = 0;
          sPacket.Distance.high_gain = 0;
          m_tPackets.push_back(sPacket);
@@ -92,10 +91,10 @@ namespace argos {
        * Kilobot messages
        */
       /* Get list of communicating RABs */
-      const CSet<CKilobotCommunicationEntity*,SEntityComparator>& setComms = m_pcMedium->GetKilobotsCommunicatingWith(*m_pcCommEntity);
+      CKilobotCommunicationMedium::SNeighbors sComms = m_pcMedium->GetKilobotsCommunicatingWith(*m_pcCommEntity);
       /* Go through communicating RABs and create packets */
-      for(CSet<CKilobotCommunicationEntity*,SEntityComparator>::iterator it = setComms.begin();
-          it != setComms.end(); ++it) {
+      for(CKilobotCommunicationMedium::TNeighborIterator it = sComms.Begin;
+          it != sComms.End; ++it) {
          /* Create a reference to the Kilobot communication entity to process */
          CKilobotCommunicationEntity& cOtherCommEntity = **it;
          /* Add ray if requested */
@@ -123,6 +122,8 @@ namespace argos {
    void CKilobotCommunicationDefaultSensor::Reset() {
       m_tPackets.clear();
       m_bMessageSent = false;
+      if(m_pcRNG)
+         m_pcRNG->Reset();
    }
 
    /****************************************/
@@ -130,6 +131,8 @@ namespace argos {
 
    void CKilobotCommunicationDefaultSensor::Destroy() {
       m_pcCommEntity->Disable();
+      delete m_pcRNG;
+      m_pcRNG = NULL;
    }
 
    /****************************************/
@@ -20,7 +20,7 @@ namespace argos {
 }
 
 #include <argos3/core/simulator/sensor.h>
-#include <argos3/core/utility/math/rng.h>
+#include <argos3/plugins/robots/kilobot/control_interface/kilobot_rng.h>
 #include <argos3/core/simulator/space/space.h>
 #include <argos3/plugins/robots/kilobot/control_interface/ci_kilobot_communication_sensor.h>
 
@@ -47,9 +47,10 @@ namespace argos {
       CKilobotCommunicationMedium* m_pcMedium;
       CControllableEntity*         m_pcControllableEntity;
       Real                         m_fDistanceNoiseStdDev;
-      CRandom::CRNG*               m_pcRNG;
+      CKilobotRNG*                 m_pcRNG;
       CSpace&                      m_cSpace;
       bool                         m_bShowRays;
+      message_t                    m_tOHCMessage;
    };
 
 }
@@ -27,7 +27,10 @@ namespace argos {
       m_fTxRange(f_range),
       m_pcEntityBody(&c_entity_body),
       m_eTxStatus(TX_NONE),
-      m_pcMedium(NULL) {
+      m_pcMedium(NULL),
+      m_nMediumIndex(-1),
+      m_bTxQueued(false),
+      m_nOHCPayload(-1) {
       Disable();
       SetInitPosition(s_anchor.Position);
       SetPosition(GetInitPosition());
@@ -49,6 +52,9 @@ namespace argos {
       if(m_eTxStatus == TX_SUCCESS) m_eTxStatus = TX_NONE;
       SetPosition(m_psAnchor->Position);
       SetOrientation(m_psAnchor->Orientation);
+      /* Keep the grid of the medium up to date */
+      if(m_nMediumIndex >= 0)
+         m_pcMedium->MoveEntity(*this);
    }
 
    /****************************************/
@@ -92,6 +92,52 @@ namespace argos {
 
       void SetMedium(CKilobotCommunicationMedium& c_medium);
 
+      /**
+       * Returns the index of this entity in the medium, or -1 if the
+       * entity is not managed by the medium.
+       */
+      inline SInt32 GetMediumIndex() const {
+         return m_nMediumIndex;
+      }
+
+      /**
+       * Sets the index of this entity in the medium.
+       * This method is meant to be called by the medium only.
+       */
+      inline void SetMediumIndex(SInt32 n_index) {
+         m_nMediumIndex = n_index;
+      }
+
+      /**
+       * Returns true if this entity is in the transmission queue of the medium.
+       */
+      inline bool IsTxQueued() const {
+         return m_bTxQueued;
+      }
+
+      /**
+       * Sets whether this entity is in the transmission queue of the medium.
+       * This method is meant to be called by the medium only.
+       */
+      inline void SetTxQueued(bool b_queued) {
+         m_bTxQueued = b_queued;
+      }
+
+      /**
+       * Returns the OHC message of this entity in the medium, or -1 if it has none.
+       */
+      inline SInt32 GetOHCPayload() const {
+         return m_nOHCPayload;
+      }
+
+      /**
+       * Sets the OHC message of this entity in the medium.
+       * This method is meant to be called by the medium only.
+       */
+      inline void SetOHCPayload(SInt32 n_payload) {
+         m_nOHCPayload = n_payload;
+      }
+
       virtual std::string GetTypeDescription() const {
          return "kilocomm";
       }
@@ -115,6 +161,15 @@ namespace argos {
 
       /** The communication medium associated to this entity */
       CKilobotCommunicationMedium* m_pcMedium;
+
+      /** The index of this entity in the medium */
+      SInt32 m_nMediumIndex;
+
+      /** Whether this entity is in the transmission queue of the medium */
+      bool m_bTxQueued;
+
+      /** The OHC message of this entity in the medium */
+      SInt32 m_nOHCPayload;
    };
 
    /****************************************/
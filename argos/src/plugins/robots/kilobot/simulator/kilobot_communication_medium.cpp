@@ -3,11 +3,10 @@
 #include <argos3/core/simulator/entity/embodied_entity.h>
 #include <argos3/core/simulator/simulator.h>
 #include <argos3/core/simulator/space/space.h>
-#include <argos3/core/simulator/space/positional_indices/grid.h>
 #include <argos3/core/utility/configuration/argos_exception.h>
 #include <argos3/core/utility/logging/argos_log.h>
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_measures.h>
-#include <unordered_map>
+#include <algorithm>
 
 namespace argos {
 
@@ -15,9 +14,16 @@ namespace argos {
    /****************************************/
 
    CKilobotCommunicationMedium::CKilobotCommunicationMedium() :
-      m_pcKilobotIndex(NULL),
-      m_pcGridUpdateOperation(NULL),
-      m_pcRNG(NULL),
+      m_bEntitiesChanged(false),
+      m_unTxQueueSize(0),
+      m_unRxUpdate(1),
+      m_fCellSize(0.0),
+      m_unGridCols(0),
+      m_unGridRows(0),
+      m_unUpdateCount(0),
+      m_unNextRegion(0),
+      m_unRegionsDone(0),
+      m_bStopWorkers(false),
       m_fRxProb(0.0),
       m_bIgnoreConflicts(false)
    {
@@ -41,22 +47,41 @@ namespace argos {
          TConfigurationNode& tArena = GetNode(CSimulator::GetInstance().GetConfigurationRoot(), "arena");
          GetNodeAttribute(tArena, "size", cArenaSize);
          GetNodeAttributeOrDefault(tArena, "center", cArenaCenter, cArenaCenter);
-         /* Create the positional index for embodied entities */
-         UInt32 unXCells = Ceil(cArenaSize.GetX() / (KILOBOT_RADIUS+KILOBOT_RADIUS));
-         UInt32 unYCells = Ceil(cArenaSize.GetY() / (KILOBOT_RADIUS+KILOBOT_RADIUS));
-         CGrid<CKilobotCommunicationEntity>* pcGrid = new CGrid<CKilobotCommunicationEntity>(
-            cArenaCenter - cArenaSize * 0.5f, cArenaCenter + cArenaSize * 0.5f,
-            unXCells, unYCells, 1);
-         m_pcGridUpdateOperation = new CKilobotCommunicationEntityGridEntityUpdater(*pcGrid);
-         pcGrid->SetUpdateEntityOperation(m_pcGridUpdateOperation);
-         m_pcKilobotIndex = pcGrid;
+         /* The grid covers the arena on the XY plane */
+         m_cArenaSize.Set(cArenaSize.GetX(), cArenaSize.GetY());
+         m_cArenaMin.Set(cArenaCenter.GetX() - cArenaSize.GetX() * 0.5,
+                         cArenaCenter.GetY() - cArenaSize.GetY() * 0.5);
          /* Set probability of receiving a message */
          GetNodeAttributeOrDefault(t_tree, "message_drop_prob", m_fRxProb, m_fRxProb);
          m_fRxProb = 1.0 - m_fRxProb;
-         /* Create random number generator */
-         m_pcRNG = CRandom::CreateRNG("argos");
          /* Whether or not to ignore conflicts due to channel congestion */
          GetNodeAttributeOrDefault(t_tree, "ignore_conflicts", m_bIgnoreConflicts, m_bIgnoreConflicts);
+         /*
+          * Split the arena in regions. The random numbers of a message come
+          * from the generator of its sender, so the deliveries do not depend
+          * on the number of regions and threads
+          */
+         UInt32 unRegions = 1;
+         GetNodeAttributeOrDefault(t_tree, "regions", unRegions, unRegions);
+         if(unRegions == 0) {
+            THROW_ARGOSEXCEPTION("The number of regions must be at least 1");
+         }
+         if(unRegions > 1) {
+            m_vecRegions.resize(unRegions);
+         }
+         /* Start the threads that update the regions */
+         UInt32 unThreads = 0;
+         GetNodeAttributeOrDefault(t_tree, "threads", unThreads, unThreads);
+         if(unThreads > 0) {
+            if(m_vecRegions.empty()) {
+               LOGERR << "[WARNING] The medium \"" << GetId() << "\" has a single region, so its threads are not started" << std::endl;
+            }
+            else {
+               for(UInt32 i = 0; i < unThreads; ++i) {
+                  m_vecWorkers.push_back(std::thread(&CKilobotCommunicationMedium::WorkerThread, this));
+               }
+            }
+         }
       }
       catch(CARGoSException& ex) {
          THROW_ARGOSEXCEPTION_NESTED("Error in initialization of the range-and-bearing medium", ex);
@@ -74,192 +99,610 @@ namespace argos {
    /****************************************/
 
    void CKilobotCommunicationMedium::Reset() {
-      /* Reset positional index of Kilobot entities */
-      m_pcKilobotIndex->Reset();
-      /* Delete adjacency matrix */
-      for(TAdjacencyMatrix::iterator it = m_tCommMatrix.begin();
-          it != m_tCommMatrix.end();
-          ++it) {
-         it->second.clear();
+      /* Empty the transmission queue */
+      for(UInt32 t = 0; t < m_unTxQueueSize; ++t) {
+         m_vecTxQueue[t]->SetTxQueued(false);
+      }
+      m_unTxQueueSize = 0;
+      /* Restart the generators, for the seed of the new run */
+      for(size_t i = 0; i < m_vecRNGs.size(); ++i) {
+         m_vecRNGs[i].Reset();
       }
+      /* Forget the deliveries */
+      ++m_unRxUpdate;
+      m_vecRxNeighbors.clear();
+      /* The robots went back to their initial positions */
+      m_bEntitiesChanged = true;
+      /* Drop the OHC messages of the last run */
+      SendOHCMessageToAll(NULL);
    }
 
    /****************************************/
    /****************************************/
 
    void CKilobotCommunicationMedium::Destroy() {
-      delete m_pcKilobotIndex;
-      if(m_pcGridUpdateOperation != NULL)
-         delete m_pcGridUpdateOperation;
+      /* Stop the worker threads */
+      {
+         std::unique_lock<std::mutex> cLock(m_cWorkersMutex);
+         m_bStopWorkers = true;
+      }
+      m_cUpdateStarted.notify_all();
+      for(size_t i = 0; i < m_vecWorkers.size(); ++i) {
+         m_vecWorkers[i].join();
+      }
+      m_vecWorkers.clear();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   /**
+    * Sorts medium indices by the id of the kilobots. The communication
+    * entities cannot be used, as they are all called "kilocomm_0".
+    */
+   struct SIndexIdComparator {
+      const std::vector<CKilobotCommunicationEntity*>& Entities;
+
+      SIndexIdComparator(const std::vector<CKilobotCommunicationEntity*>& vec_entities) :
+         Entities(vec_entities) {}
+
+      bool operator()(UInt32 un_a, UInt32 un_b) const {
+         return Entities[un_a]->GetParent().GetId() < Entities[un_b]->GetParent().GetId();
+      }
+   };
+
+   /**
+    * Sorts medium indices by their rank in the id order.
+    */
+   struct SIndexRankComparator {
+      const std::vector<UInt32>& Ranks;
+
+      SIndexRankComparator(const std::vector<UInt32>& vec_ranks) :
+         Ranks(vec_ranks) {}
+
+      bool operator()(UInt32 un_a, UInt32 un_b) const {
+         return Ranks[un_a] < Ranks[un_b];
+      }
+   };
+
+   /**
+    * The receiver of a (receiver, transmitter) delivery.
+    */
+   struct SDeliveryReceiver {
+      UInt32 operator()(const std::pair<UInt32, UInt32>& c_delivery) const {
+         return c_delivery.first;
+      }
+   };
+
+   /**
+    * The rank in the id order of the transmitter of a delivery.
+    */
+   struct SDeliveryTransmitterRank {
+      const std::vector<UInt32>& Ranks;
+
+      SDeliveryTransmitterRank(const std::vector<UInt32>& vec_ranks) :
+         Ranks(vec_ranks) {}
+
+      UInt32 operator()(const std::pair<UInt32, UInt32>& c_delivery) const {
+         return Ranks[c_delivery.second];
+      }
+   };
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::BuildGrid() {
+      UInt32 unNumEntities = m_vecEntities.size();
+      /* Copy the state of the entities */
+      Real fMaxRange = 0.0;
+      for(UInt32 i = 0; i < unNumEntities; ++i) {
+         CKilobotCommunicationEntity& cKilobot = *m_vecEntities[i];
+         m_vecX[i] = cKilobot.GetPosition().GetX();
+         m_vecY[i] = cKilobot.GetPosition().GetY();
+         m_vecTxRange[i] = cKilobot.GetTxRange();
+         if(m_vecTxRange[i] > fMaxRange) fMaxRange = m_vecTxRange[i];
+      }
+      /*
+       * With cells at least as large as the longest range, two entities in
+       * range of each other are always in the same cell or in adjacent ones.
+       * Cells are made larger when the grid would have many more cells than
+       * entities, to keep the cost of the empty cells low.
+       */
+      m_fCellSize = Max(fMaxRange,
+                        ::sqrt(m_cArenaSize.GetX() * m_cArenaSize.GetY() / (4 * unNumEntities + 1)));
+      m_unGridCols = Max<UInt32>(1, Ceil(m_cArenaSize.GetX() / m_fCellSize));
+      m_unGridRows = Max<UInt32>(1, Ceil(m_cArenaSize.GetY() / m_fCellSize));
+      /* Put the entities in their cells */
+      m_vecCells.resize(m_unGridCols * m_unGridRows);
+      for(size_t c = 0; c < m_vecCells.size(); ++c) {
+         m_vecCells[c].clear();
+      }
+      for(UInt32 i = 0; i < unNumEntities; ++i) {
+         m_vecCell[i] = GetCell(m_vecX[i], m_vecY[i]);
+         m_vecCellSlot[i] = m_vecCells[m_vecCell[i]].size();
+         m_vecCells[m_vecCell[i]].push_back(i);
+      }
+      /* The moves so far are accounted for */
+      m_vecMoved.assign(unNumEntities, 0);
+      m_vecMovedEntities.clear();
    }
 
    /****************************************/
    /****************************************/
 
-   static size_t HashKilobotPair(const std::pair<CKilobotCommunicationEntity*, CKilobotCommunicationEntity*>& c_pair) {
-      return
-         reinterpret_cast<size_t>(c_pair.first) ^
-         reinterpret_cast<size_t>(c_pair.second);
+   void CKilobotCommunicationMedium::UpdateMovedEntities() {
+      for(size_t m = 0; m < m_vecMovedEntities.size(); ++m) {
+         UInt32 i = m_vecMovedEntities[m];
+         m_vecMoved[i] = 0;
+         /* The entity may have come back to its cell */
+         UInt32 unCell = GetCell(m_vecX[i], m_vecY[i]);
+         if(unCell == m_vecCell[i]) continue;
+         /* Take the entity out of its cell, putting the last one of the cell in its place */
+         std::vector<UInt32>& vecOldCell = m_vecCells[m_vecCell[i]];
+         vecOldCell[m_vecCellSlot[i]] = vecOldCell.back();
+         m_vecCellSlot[vecOldCell.back()] = m_vecCellSlot[i];
+         vecOldCell.pop_back();
+         /* Put it in the new one */
+         m_vecCell[i] = unCell;
+         m_vecCellSlot[i] = m_vecCells[unCell].size();
+         m_vecCells[unCell].push_back(i);
+      }
+      m_vecMovedEntities.clear();
    }
 
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::MoveEntity(CKilobotCommunicationEntity& c_entity) {
+      UInt32 i = c_entity.GetMediumIndex();
+      m_vecX[i] = c_entity.GetPosition().GetX();
+      m_vecY[i] = c_entity.GetPosition().GetY();
+      /*
+       * Most of the time an entity stays in its cell, so only the others
+       * are noted, and the lock is rarely taken. Until the grid is built
+       * there are no cells.
+       */
+      if(!m_vecMoved[i] &&
+         !m_vecCells.empty() &&
+         GetCell(m_vecX[i], m_vecY[i]) != m_vecCell[i]) {
+         m_vecMoved[i] = 1;
+         std::lock_guard<std::mutex> cLock(m_cMovedMutex);
+         m_vecMovedEntities.push_back(i);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   template <class KEY>
+   void CKilobotCommunicationMedium::SortDeliveries(KEY t_key) {
+      /* Counting sort: count the deliveries of each key */
+      m_vecDeliveryOffsets.assign(m_vecEntities.size() + 1, 0);
+      for(UInt32 d = 0; d < m_vecDeliveries.size(); ++d) {
+         ++m_vecDeliveryOffsets[t_key(m_vecDeliveries[d]) + 1];
+      }
+      /* Where the deliveries of each key start */
+      for(UInt32 k = 1; k < m_vecDeliveryOffsets.size(); ++k) {
+         m_vecDeliveryOffsets[k] += m_vecDeliveryOffsets[k - 1];
+      }
+      m_vecSortedDeliveries.resize(m_vecDeliveries.size());
+      for(UInt32 d = 0; d < m_vecDeliveries.size(); ++d) {
+         m_vecSortedDeliveries[m_vecDeliveryOffsets[t_key(m_vecDeliveries[d])]++] = m_vecDeliveries[d];
+      }
+      m_vecDeliveries.swap(m_vecSortedDeliveries);
+   }
+
+   /****************************************/
+   /****************************************/
+
    void CKilobotCommunicationMedium::Update() {
       /*
-       * Update positional index of Kilobot entities
+       * The deliveries of the last update are over
+       */
+      ++m_unRxUpdate;
+      m_vecRxNeighbors.clear();
+      /*
+       * Nothing to deliver if nobody transmits
        */
-      m_pcKilobotIndex->Update();
+      if(m_unTxQueueSize == 0) return;
       /*
-       * Delete obsolete adjacency matrices
+       * Sort the entities by id, if the set of entities changed
        */
-      for(TAdjacencyMatrix::iterator it = m_tCommMatrix.begin();
-          it != m_tCommMatrix.end();
-          ++it) {
-         it->second.clear();
+      bool bBuildGrid = m_bEntitiesChanged;
+      if(m_bEntitiesChanged) {
+         m_vecIdOrder.resize(m_vecEntities.size());
+         for(UInt32 i = 0; i < m_vecIdOrder.size(); ++i) {
+            m_vecIdOrder[i] = i;
+         }
+         std::sort(m_vecIdOrder.begin(), m_vecIdOrder.end(), SIndexIdComparator(m_vecEntities));
+         m_vecIdRank.resize(m_vecIdOrder.size());
+         for(UInt32 k = 0; k < m_vecIdOrder.size(); ++k) {
+            m_vecIdRank[m_vecIdOrder[k]] = k;
+         }
+         m_bEntitiesChanged = false;
       }
-      m_tTxNeighbors.clear();
       /*
-       * Construct the adjacency matrix of transmitting robots
+       * Take the transmitters from the queue. Their ranges may have changed,
+       * and the grid is built again if they do not fit in the cells anymore
        */
-      /* Buffer for the communicating entities */
-      CSet<CKilobotCommunicationEntity*,SEntityComparator> cOtherKilobots;
-      /* This map contains the pairs that have already been checked */
-      unordered_map<size_t, std::pair<CKilobotCommunicationEntity*, CKilobotCommunicationEntity*> > mapPairsAlreadyChecked;
-      /* Iterator for the above structure */
-      unordered_map<size_t, std::pair<CKilobotCommunicationEntity*, CKilobotCommunicationEntity*> >::iterator itPair;
-      /* Used as test key */
-      std::pair<CKilobotCommunicationEntity*, CKilobotCommunicationEntity*> cTestKey;
-      /* Used as hash for the test key */
-      size_t unTestHash;
-      /* The square distance between two Kilobots */
-      Real fSqDistance;
-      /* Go through the Kilobot entities */
-      for(TAdjacencyMatrix::iterator it = m_tCommMatrix.begin();
-          it != m_tCommMatrix.end();
-          ++it) {
-         /* Get a reference to the current Kilobot entity */
-         CKilobotCommunicationEntity& cKilobot = *reinterpret_cast<CKilobotCommunicationEntity*>(GetSpace().GetEntityVector()[it->first]);
-         /* Is this robot trying to transmit? */
+      m_vecTransmitters.resize(m_unTxQueueSize);
+      for(UInt32 t = 0; t < m_vecTransmitters.size(); ++t) {
+         UInt32 i = m_vecTxQueue[t]->GetMediumIndex();
+         m_vecTransmitters[t] = i;
+         m_vecTxAttempt[i] = 1;
+         m_vecTxRange[i] = m_vecTxQueue[t]->GetTxRange();
+         if(m_vecTxRange[i] > m_fCellSize) bBuildGrid = true;
+      }
+      if(bBuildGrid) {
+         BuildGrid();
+      }
+      else {
+         UpdateMovedEntities();
+      }
+      /*
+       * Sort the transmitters by id, which does not depend on the order in
+       * which the actuators queued them. When many robots transmit, picking
+       * them from the id order is cheaper than sorting
+       */
+      if(m_vecTransmitters.size() * 16 < m_vecIdOrder.size()) {
+         std::sort(m_vecTransmitters.begin(), m_vecTransmitters.end(), SIndexRankComparator(m_vecIdRank));
+      }
+      else {
+         UInt32 unTransmitters = 0;
+         for(UInt32 k = 0; k < m_vecIdOrder.size(); ++k) {
+            if(m_vecTxAttempt[m_vecIdOrder[k]]) m_vecTransmitters[unTransmitters++] = m_vecIdOrder[k];
+         }
+      }
+      m_vecDeliveries.clear();
+      if(m_vecRegions.empty()) {
+         /*
+          * Update the medium as a whole
+          */
+         UpdateWhole();
+      }
+      else {
+         /*
+          * Update the regions, possibly in parallel
+          */
+         for(size_t r = 0; r < m_vecRegions.size(); ++r) {
+            m_vecRegions[r].Transmitters.clear();
+            m_vecRegions[r].Deliveries.clear();
+         }
+         /* Assign the transmitters to the bands of rows that contain them */
+         for(UInt32 t = 0; t < m_vecTransmitters.size(); ++t) {
+            UInt32 i = m_vecTransmitters[t];
+            UInt32 unRow = m_vecCell[i] / m_unGridCols;
+            m_vecRegions[unRow * m_vecRegions.size() / m_unGridRows].Transmitters.push_back(i);
+         }
+         if(m_vecWorkers.empty()) {
+            m_unNextRegion = 0;
+            UpdateRegions();
+         }
+         else {
+            /* Wake up the workers and help them */
+            {
+               std::unique_lock<std::mutex> cLock(m_cWorkersMutex);
+               m_unNextRegion = 0;
+               m_unRegionsDone = 0;
+               ++m_unUpdateCount;
+            }
+            m_cUpdateStarted.notify_all();
+            UpdateRegions();
+            std::unique_lock<std::mutex> cLock(m_cWorkersMutex);
+            while(m_unRegionsDone < m_vecRegions.size()) {
+               m_cUpdateDone.wait(cLock);
+            }
+         }
+         for(size_t r = 0; r < m_vecRegions.size(); ++r) {
+            m_vecDeliveries.insert(m_vecDeliveries.end(),
+                                   m_vecRegions[r].Deliveries.begin(),
+                                   m_vecRegions[r].Deliveries.end());
+         }
+         /* Each region is in transmitter order, the whole is not */
+         SortDeliveries(SDeliveryTransmitterRank(m_vecIdRank));
+      }
+      for(UInt32 t = 0; t < m_vecTransmitters.size(); ++t) {
+         m_vecTxAttempt[m_vecTransmitters[t]] = 0;
+      }
+      /*
+       * Group the deliveries by receiver. They are in transmitter order, so
+       * the senders of each receiver stay sorted by id
+       */
+      SortDeliveries(SDeliveryReceiver());
+      m_vecRxNeighbors.resize(m_vecDeliveries.size());
+      for(UInt32 d = 0; d < m_vecDeliveries.size(); ++d) {
+         SRxRange& sRange = m_vecRxRanges[m_vecDeliveries[d].first];
+         if(sRange.Update != m_unRxUpdate) {
+            sRange.Update = m_unRxUpdate;
+            sRange.Begin = d;
+         }
+         sRange.End = d + 1;
+         m_vecRxNeighbors[d] = m_vecEntities[m_vecDeliveries[d].second];
+      }
+      /*
+       * The transmitters that lost a conflict try again at the next step
+       */
+      UInt32 unTxQueueSize = 0;
+      for(UInt32 t = 0; t < m_unTxQueueSize; ++t) {
+         CKilobotCommunicationEntity& cKilobot = *m_vecTxQueue[t];
          if(cKilobot.GetTxStatus() == CKilobotCommunicationEntity::TX_ATTEMPT) {
-            /* Yes, add it to the list of transmitting robots */
-            m_tTxNeighbors[cKilobot.GetIndex()];
-            /* Get the list of Kilobots in range */
-            cOtherKilobots.clear();
-            m_pcKilobotIndex->GetEntitiesAt(cOtherKilobots, cKilobot.GetPosition());
-            /* Go through the Kilobots in range */
-            for(CSet<CKilobotCommunicationEntity*,SEntityComparator>::iterator it2 = cOtherKilobots.begin();
-                it2 != cOtherKilobots.end();
-                ++it2) {
-               /* Get a reference to the neighboring Kilobot */
-               CKilobotCommunicationEntity& cOtherKilobot = **it2;
-               /* First, make sure the entities are not the same and
-                  that they are both transmitting */
-               if(&cKilobot != &cOtherKilobot &&
-                  cOtherKilobot.GetTxStatus() == CKilobotCommunicationEntity::TX_ATTEMPT) {
-                  /* Proceed if the pair has not been checked already */
-                  if(&cKilobot < &cOtherKilobot) {
-                     cTestKey.first = &cKilobot;
-                     cTestKey.second = &cOtherKilobot;
-                  }
-                  else {
-                     cTestKey.first = &cOtherKilobot;
-                     cTestKey.second = &cKilobot;
-                  }
-                  unTestHash = HashKilobotPair(cTestKey);
-                  itPair = mapPairsAlreadyChecked.find(unTestHash);
-                  if(itPair == mapPairsAlreadyChecked.end() ||   /* Pair does not exist */
-                     itPair->second.first != cTestKey.first ||   /* Pair exists, but first Kilobot involved is different */
-                     itPair->second.second != cTestKey.second) { /* Pair exists, but second Kilobot involved is different */
-                     /* Mark this pair as already checked */
-                     mapPairsAlreadyChecked[unTestHash] = cTestKey;
-                     /* Calculate square distance */
-                     fSqDistance = SquareDistance(cKilobot.GetPosition(),
-                                                  cOtherKilobot.GetPosition());
-                     if(fSqDistance < Square(cOtherKilobot.GetTxRange())) {
-                        /* cKilobot receives cOtherKilobot's message */
-                        m_tTxNeighbors[cKilobot.GetIndex()].insert(&cOtherKilobot);
-                     }
-                     if(fSqDistance < Square(cKilobot.GetTxRange())) {
-                        /* cOtherKilobot receives cKilobot's message */
-                        m_tTxNeighbors[cOtherKilobot.GetIndex()].insert(&cKilobot);
-                     }
-                  } /* pair check */
-               } /* entity identity + transmit check */
-            } /* neighbors loop */
-         } /* transmission check */
-      } /* robot loop */
+            m_vecTxQueue[unTxQueueSize++] = &cKilobot;
+         }
+         else {
+            cKilobot.SetTxQueued(false);
+         }
+      }
+      m_unTxQueueSize = unTxQueueSize;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::UpdateWhole() {
+      /*
+       * Count the transmitting neighbors of each transmitting robot
+       */
+      for(UInt32 t = 0; t < m_vecTransmitters.size(); ++t) {
+         m_vecTxNeighbors[m_vecTransmitters[t]] = 0;
+      }
+      /*
+       * Each pair of transmitters is checked once: a transmitter is paired
+       * with the ones after it in its cell and with the ones in the four
+       * neighbor cells that come after its cell, so the pairs need not be
+       * remembered
+       */
+      static const SInt32 NEXT_CELLS[4][2] = { { 1, -1 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+      for(UInt32 t = 0; t < m_vecTransmitters.size(); ++t) {
+         UInt32 i = m_vecTransmitters[t];
+         SInt32 nCol = m_vecCell[i] % m_unGridCols;
+         SInt32 nRow = m_vecCell[i] / m_unGridCols;
+         /* Pairs in the same cell */
+         const std::vector<UInt32>& vecCell = m_vecCells[m_vecCell[i]];
+         for(size_t b = m_vecCellSlot[i] + 1; b < vecCell.size(); ++b) {
+            UInt32 j = vecCell[b];
+            if(m_vecTxAttempt[j]) CheckTxPair(i, j);
+         }
+         /* Pairs with the following cells */
+         for(UInt32 n = 0; n < 4; ++n) {
+            SInt32 nOtherCol = nCol + NEXT_CELLS[n][0];
+            SInt32 nOtherRow = nRow + NEXT_CELLS[n][1];
+            if(nOtherCol < 0 || nOtherCol >= static_cast<SInt32>(m_unGridCols) ||
+               nOtherRow < 0 || nOtherRow >= static_cast<SInt32>(m_unGridRows)) continue;
+            const std::vector<UInt32>& vecOtherCell = m_vecCells[nOtherRow * m_unGridCols + nOtherCol];
+            for(size_t b = 0; b < vecOtherCell.size(); ++b) {
+               UInt32 j = vecOtherCell[b];
+               if(m_vecTxAttempt[j]) CheckTxPair(i, j);
+            }
+         }
+      }
       /*
        * Go through transmitting robots and broadcast messages
        */
-      /* Buffer to store the intersection data */
-      SEmbodiedEntityIntersectionItem sIntersectionItem;
-      /* Loop over transmitting robots */
-      for(TAdjacencyMatrix::iterator it = m_tTxNeighbors.begin();
-          it != m_tTxNeighbors.end();
-          ++it) {
-         /* Is this robot conflicting? */
-         if(m_bIgnoreConflicts ||
-            it->second.empty() ||
-            m_pcRNG->Uniform(CRange<UInt32>(0, it->second.size() + 1)) == 0) {
-            /* The robot can transmit */
-            /* Get a reference to the current Kilobot entity */
-            CKilobotCommunicationEntity& cKilobot = *reinterpret_cast<CKilobotCommunicationEntity*>(GetSpace().GetEntityVector()[it->first]);
-            /* Change its transmission status */
-            cKilobot.SetTxStatus(CKilobotCommunicationEntity::TX_SUCCESS);
-            /* Go through its neighbors */
-            cOtherKilobots.clear();
-            m_pcKilobotIndex->GetEntitiesAt(cOtherKilobots, cKilobot.GetPosition());
-            for(CSet<CKilobotCommunicationEntity*,SEntityComparator>::iterator it2 = cOtherKilobots.begin();
-                it2 != cOtherKilobots.end();
-                ++it2) {
-               /* Get a reference to the neighboring Kilobot entity */
-               CKilobotCommunicationEntity& cOtherKilobot = **it2;
-               /* Make sure the robots are different */
-               if(&cKilobot != &cOtherKilobot) {
-                  /* Calculate distance */
-                  fSqDistance = SquareDistance(cKilobot.GetPosition(),
-                                               cOtherKilobot.GetPosition());
-                  /* If robots are within transmission range and transmission succeeds... */
-                  if(fSqDistance < Square(cKilobot.GetTxRange()) &&
-                     m_pcRNG->Bernoulli(m_fRxProb)) {
-                     /* cOtherKilobot receives cKilobot's message */
-                     m_tCommMatrix[cOtherKilobot.GetIndex()].insert(&cKilobot);
+      for(UInt32 t = 0; t < m_vecTransmitters.size(); ++t) {
+         UInt32 i = m_vecTransmitters[t];
+         Transmit(i, m_vecTxNeighbors[i], m_vecDeliveries);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CKilobotCommunicationMedium::CountTxNeighbors(UInt32 un_i) const {
+      UInt32 unTxNeighbors = 0;
+      SInt32 nCol = m_vecCell[un_i] % m_unGridCols;
+      SInt32 nRow = m_vecCell[un_i] / m_unGridCols;
+      for(SInt32 nOtherRow = Max<SInt32>(nRow - 1, 0);
+          nOtherRow <= Min<SInt32>(nRow + 1, m_unGridRows - 1);
+          ++nOtherRow) {
+         for(SInt32 nOtherCol = Max<SInt32>(nCol - 1, 0);
+             nOtherCol <= Min<SInt32>(nCol + 1, m_unGridCols - 1);
+             ++nOtherCol) {
+            const std::vector<UInt32>& vecOtherCell = m_vecCells[nOtherRow * m_unGridCols + nOtherCol];
+            for(size_t b = 0; b < vecOtherCell.size(); ++b) {
+               UInt32 j = vecOtherCell[b];
+               if(j != un_i &&
+                  m_vecTxAttempt[j] &&
+                  Square(m_vecX[un_i] - m_vecX[j]) + Square(m_vecY[un_i] - m_vecY[j]) < Square(m_vecTxRange[j])) {
+                  /* i receives j's message */
+                  ++unTxNeighbors;
+               }
+            }
+         }
+      }
+      return unTxNeighbors;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::Transmit(UInt32 un_i,
+                                              UInt32 un_tx_neighbors,
+                                              std::vector<std::pair<UInt32, UInt32> >& vec_deliveries) {
+      CKilobotRNG& cRNG = m_vecRNGs[un_i];
+      /* Is this robot conflicting? */
+      if(m_bIgnoreConflicts ||
+         un_tx_neighbors == 0 ||
+         cRNG.Uniform(CRange<UInt32>(0, un_tx_neighbors + 1)) == 0) {
+         /* The robot can transmit */
+         m_vecEntities[un_i]->SetTxStatus(CKilobotCommunicationEntity::TX_SUCCESS);
+         /*
+          * The order of the robots in a cell depends on how they moved, so
+          * the drop of each message is decided by the draw of the
+          * transmitter and the id of the receiver, not by the order
+          */
+         UInt64 unDraw = cRNG.Next();
+         /* Look for the robots in range in its cell and in the adjacent ones */
+         SInt32 nCol = m_vecCell[un_i] % m_unGridCols;
+         SInt32 nRow = m_vecCell[un_i] / m_unGridCols;
+         for(SInt32 nOtherRow = Max<SInt32>(nRow - 1, 0);
+             nOtherRow <= Min<SInt32>(nRow + 1, m_unGridRows - 1);
+             ++nOtherRow) {
+            for(SInt32 nOtherCol = Max<SInt32>(nCol - 1, 0);
+                nOtherCol <= Min<SInt32>(nCol + 1, m_unGridCols - 1);
+                ++nOtherCol) {
+               const std::vector<UInt32>& vecOtherCell = m_vecCells[nOtherRow * m_unGridCols + nOtherCol];
+               for(size_t b = 0; b < vecOtherCell.size(); ++b) {
+                  UInt32 j = vecOtherCell[b];
+                  /* Make sure the robots are different and within transmission range */
+                  if(j != un_i &&
+                     Square(m_vecX[un_i] - m_vecX[j]) + Square(m_vecY[un_i] - m_vecY[j]) < Square(m_vecTxRange[un_i]) &&
+                     /* If transmission succeeds, the other robot receives the message */
+                     CKilobotRNG::Bernoulli(m_fRxProb, unDraw, m_vecRNGs[j].GetIdHash())) {
+                     vec_deliveries.push_back(std::make_pair(j, un_i));
                   }
-               } /* identity check */
-            } /* neighbor loop */
-         } /* conflict check */
-      } /* transmitters loop */
+               } /* neighbor loop */
+            }
+         }
+      } /* conflict check */
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::UpdateRegions() {
+      UInt32 unRegionsDone = 0;
+      UInt32 unRegion;
+      while((unRegion = m_unNextRegion++) < m_vecRegions.size()) {
+         SRegion& sRegion = m_vecRegions[unRegion];
+         /*
+          * The regions share no state but the positions, so the
+          * transmitting neighbors are counted by each transmitter alone
+          */
+         for(size_t t = 0; t < sRegion.Transmitters.size(); ++t) {
+            UInt32 i = sRegion.Transmitters[t];
+            Transmit(i, CountTxNeighbors(i), sRegion.Deliveries);
+         }
+         ++unRegionsDone;
+      }
+      if(!m_vecWorkers.empty()) {
+         std::unique_lock<std::mutex> cLock(m_cWorkersMutex);
+         m_unRegionsDone += unRegionsDone;
+         if(m_unRegionsDone == m_vecRegions.size()) {
+            m_cUpdateDone.notify_one();
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::WorkerThread() {
+      UInt64 unLastUpdate = 0;
+      while(true) {
+         {
+            std::unique_lock<std::mutex> cLock(m_cWorkersMutex);
+            while(!m_bStopWorkers && m_unUpdateCount == unLastUpdate) {
+               m_cUpdateStarted.wait(cLock);
+            }
+            if(m_bStopWorkers) return;
+            unLastUpdate = m_unUpdateCount;
+         }
+         UpdateRegions();
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   /**
+    * Removes an element from a vector, putting the last element in its place.
+    */
+   template<class T> static void RemoveAt(std::vector<T>& vec_elements,
+                                          UInt32 un_index) {
+      vec_elements[un_index] = vec_elements.back();
+      vec_elements.pop_back();
    }
 
    /****************************************/
    /****************************************/
 
    void CKilobotCommunicationMedium::AddEntity(CKilobotCommunicationEntity& c_entity) {
-      m_tCommMatrix.insert(
-         std::make_pair<ssize_t, CSet<CKilobotCommunicationEntity*,SEntityComparator> >(
-            c_entity.GetIndex(), CSet<CKilobotCommunicationEntity*,SEntityComparator>()));
-      m_pcKilobotIndex->AddEntity(c_entity);
+      if(c_entity.GetMediumIndex() >= 0) return;
+      c_entity.SetMediumIndex(m_vecEntities.size());
+      m_vecEntities.push_back(&c_entity);
+      m_vecRNGs.push_back(CKilobotRNG(c_entity.GetParent().GetId(), KILOBOT_RNG_MEDIUM));
+      m_vecTxQueue.resize(m_vecEntities.size());
+      m_vecX.push_back(c_entity.GetPosition().GetX());
+      m_vecY.push_back(c_entity.GetPosition().GetY());
+      m_vecTxRange.push_back(c_entity.GetTxRange());
+      m_vecTxAttempt.push_back(0);
+      m_vecTxNeighbors.push_back(0);
+      m_vecCell.push_back(0);
+      m_vecCellSlot.push_back(0);
+      m_vecMoved.push_back(0);
+      m_vecRxRanges.push_back(SRxRange());
+      m_bEntitiesChanged = true;
    }
 
    /****************************************/
    /****************************************/
 
-   void CKilobotCommunicationMedium::RemoveEntity(CKilobotCommunicationEntity& c_entity) {
-      m_pcKilobotIndex->RemoveEntity(c_entity);
-      TAdjacencyMatrix::iterator it = m_tCommMatrix.find(c_entity.GetIndex());
-      if(it != m_tCommMatrix.end())
-         m_tCommMatrix.erase(it);
+   void CKilobotCommunicationMedium::AddTransmitter(CKilobotCommunicationEntity& c_entity) {
+      if(c_entity.IsTxQueued() || c_entity.GetMediumIndex() < 0) return;
+      c_entity.SetTxQueued(true);
+      m_vecTxQueue[m_unTxQueueSize++] = &c_entity;
    }
 
    /****************************************/
    /****************************************/
 
-   const CSet<CKilobotCommunicationEntity*,SEntityComparator>& CKilobotCommunicationMedium::GetKilobotsCommunicatingWith(CKilobotCommunicationEntity& c_entity) const {
-      TAdjacencyMatrix::const_iterator it = m_tCommMatrix.find(c_entity.GetIndex());
-      if(it != m_tCommMatrix.end()) {
-         return it->second;
+   void CKilobotCommunicationMedium::RemoveEntity(CKilobotCommunicationEntity& c_entity) {
+      SInt32 nIndex = c_entity.GetMediumIndex();
+      if(nIndex < 0) return;
+      /* Take the entity out of the transmission queue */
+      if(c_entity.IsTxQueued()) {
+         UInt32 unTxQueueSize = 0;
+         for(UInt32 t = 0; t < m_unTxQueueSize; ++t) {
+            if(m_vecTxQueue[t] != &c_entity) {
+               m_vecTxQueue[unTxQueueSize++] = m_vecTxQueue[t];
+            }
+         }
+         m_unTxQueueSize = unTxQueueSize;
+         c_entity.SetTxQueued(false);
       }
-      else {
+      /* Drop its OHC message */
+      ReleaseOHCPayload(c_entity.GetOHCPayload());
+      c_entity.SetOHCPayload(-1);
+      /* Move the last entity in place of the removed one */
+      RemoveAt(m_vecRNGs, nIndex);
+      RemoveAt(m_vecEntities, nIndex);
+      if(static_cast<UInt32>(nIndex) < m_vecEntities.size()) {
+         m_vecEntities[nIndex]->SetMediumIndex(nIndex);
+      }
+      RemoveAt(m_vecX, nIndex);
+      RemoveAt(m_vecY, nIndex);
+      RemoveAt(m_vecTxRange, nIndex);
+      RemoveAt(m_vecTxAttempt, nIndex);
+      RemoveAt(m_vecTxNeighbors, nIndex);
+      RemoveAt(m_vecCell, nIndex);
+      RemoveAt(m_vecCellSlot, nIndex);
+      RemoveAt(m_vecMoved, nIndex);
+      RemoveAt(m_vecRxRanges, nIndex);
+      m_vecTxQueue.resize(m_vecEntities.size());
+      c_entity.SetMediumIndex(-1);
+      /* The grid is built again at the next update */
+      m_bEntitiesChanged = true;
+      /* The deliveries may refer to the removed entity */
+      ++m_unRxUpdate;
+      m_vecRxNeighbors.clear();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotCommunicationMedium::SNeighbors CKilobotCommunicationMedium::GetKilobotsCommunicatingWith(CKilobotCommunicationEntity& c_entity) const {
+      SInt32 nIndex = c_entity.GetMediumIndex();
+      if(nIndex < 0 || m_vecEntities[nIndex] != &c_entity) {
          THROW_ARGOSEXCEPTION("Kilobot entity \"" << c_entity.GetId() << "\" is not managed by the Kilobot medium \"" << GetId() << "\"");
       }
+      SNeighbors sNeighbors;
+      /* The entities that received nothing have no range for the last update */
+      const SRxRange& sRange = m_vecRxRanges[nIndex];
+      if(sRange.Update == m_unRxUpdate) {
+         sNeighbors.Begin = m_vecRxNeighbors.data() + sRange.Begin;
+         sNeighbors.End   = m_vecRxNeighbors.data() + sRange.End;
+      }
+      return sNeighbors;
    }
 
    /****************************************/
@@ -267,21 +710,8 @@ namespace argos {
 
    void CKilobotCommunicationMedium::SendOHCMessageTo(CKilobotEntity& c_robot,
                                                       message_t* pt_message) {
-      /*
-       * old   | new   | action
-       * ------+-------+---------------------
-       * ~null | ~null | delete old, copy new
-       * ~null |  null | delete old, set null
-       *  null | ~null | copy new
-       *  null |  null | nothing to do
-       */
-      /* Get old message and delete it if necessary */
-      message_t* ptOldMsg = GetOHCMessageFor(c_robot);
-      if(ptOldMsg != NULL) delete ptOldMsg;
-      /* Set message */
-      m_mapOHCMessages[c_robot.GetIndex()] = NULL;
-      if(pt_message != NULL)
-         m_mapOHCMessages[c_robot.GetIndex()] = new message_t(*pt_message);
+      SetOHCPayload(c_robot,
+                    (pt_message != NULL) ? NewOHCPayload(*pt_message, 1) : -1);
    }
 
    /****************************************/
@@ -289,33 +719,86 @@ namespace argos {
 
    void CKilobotCommunicationMedium::SendOHCMessageTo(std::vector<CKilobotEntity*>& vec_robots,
                                                       message_t* pt_message) {
+      /* All the robots share one copy of the message */
+      SInt32 nPayload = -1;
+      if(pt_message != NULL && !vec_robots.empty()) {
+         nPayload = NewOHCPayload(*pt_message, vec_robots.size());
+      }
       for(size_t i = 0; i < vec_robots.size(); ++i) {
-         /*
-          * old   | new   | action
-          * ------+-------+---------------------
-          * ~null | ~null | delete old, copy new
-          * ~null |  null | delete old, set null
-          *  null | ~null | copy new
-          *  null |  null | nothing to do
-          */
-         /* Get old message and delete it if necessary */
-         message_t* ptOldMsg = GetOHCMessageFor(*vec_robots[i]);
-         if(ptOldMsg != NULL) delete ptOldMsg;
-         /* Set message */
-         m_mapOHCMessages[vec_robots[i]->GetIndex()] = NULL;
-         if(pt_message != NULL)
-            m_mapOHCMessages[vec_robots[i]->GetIndex()] = new message_t(*pt_message);
+         SetOHCPayload(*vec_robots[i], nPayload);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::SendOHCMessageToAll(message_t* pt_message) {
+      /* The old messages are all dropped, so the pool can start over */
+      m_vecOHCPayloads.clear();
+      m_vecOHCFreePayloads.clear();
+      SInt32 nPayload = -1;
+      if(pt_message != NULL && !m_vecEntities.empty()) {
+         nPayload = NewOHCPayload(*pt_message, m_vecEntities.size());
+      }
+      for(size_t i = 0; i < m_vecEntities.size(); ++i) {
+         m_vecEntities[i]->SetOHCPayload(nPayload);
       }
    }
 
    /****************************************/
    /****************************************/
 
-   message_t* CKilobotCommunicationMedium::GetOHCMessageFor(CKilobotEntity& c_robot) {
-      /* Look for robot in map */
-      std::unordered_map<ssize_t, message_t*>::iterator it = m_mapOHCMessages.find(c_robot.GetIndex());
-      /* Return entry if robot found, NULL otherwise */
-      return (it == m_mapOHCMessages.end()) ? NULL : (it->second);
+   bool CKilobotCommunicationMedium::GetOHCMessageFor(CKilobotEntity& c_robot,
+                                                      message_t& t_message) const {
+      SInt32 nPayload = c_robot.GetKilobotCommunicationEntity().GetOHCPayload();
+      if(nPayload < 0) return false;
+      t_message = m_vecOHCPayloads[nPayload].Message;
+      return true;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   SInt32 CKilobotCommunicationMedium::NewOHCPayload(const message_t& t_message,
+                                                     UInt32 un_references) {
+      SInt32 nPayload;
+      if(!m_vecOHCFreePayloads.empty()) {
+         nPayload = m_vecOHCFreePayloads.back();
+         m_vecOHCFreePayloads.pop_back();
+      }
+      else {
+         /* Each robot has at most one payload, so the pool stops growing soon */
+         nPayload = m_vecOHCPayloads.size();
+         m_vecOHCPayloads.push_back(SOHCPayload());
+      }
+      m_vecOHCPayloads[nPayload].Message = t_message;
+      m_vecOHCPayloads[nPayload].References = un_references;
+      return nPayload;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::SetOHCPayload(CKilobotEntity& c_robot,
+                                                   SInt32 n_payload) {
+      CKilobotCommunicationEntity& cCommEntity = c_robot.GetKilobotCommunicationEntity();
+      if(cCommEntity.GetMediumIndex() < 0) {
+         /* The robot cannot receive messages */
+         ReleaseOHCPayload(n_payload);
+         return;
+      }
+      ReleaseOHCPayload(cCommEntity.GetOHCPayload());
+      cCommEntity.SetOHCPayload(n_payload);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::ReleaseOHCPayload(SInt32 n_payload) {
+      if(n_payload >= 0 &&
+         --m_vecOHCPayloads[n_payload].References == 0) {
+         m_vecOHCFreePayloads.push_back(n_payload);
+      }
    }
 
    /****************************************/
@@ -350,6 +833,15 @@ namespace argos {
                    "random choice. If you don't want conflicts to be simulated, set the flag\n"
                    "'ignore_conflicts' to 'true':\n\n"
                    "<kilobot_communication id=\"kbc\" ignore_conflicts=\"true\" />\n"
+                   "\n"
+                   "In large swarms, the medium can be updated in parallel. The arena is split in\n"
+                   "bands along the Y axis. The attribute 'regions' sets the number of bands, and\n"
+                   "'threads' the number of threads that update them together with the main thread.\n"
+                   "The random numbers of a message come from a generator of its sender, seeded from\n"
+                   "the experiment seed and the robot id, so the results depend neither on the\n"
+                   "number of regions nor on the number of threads. With a single region (the\n"
+                   "default) the medium is updated as a whole and 'threads' has no effect:\n\n"
+                   "<kilobot_communication id=\"kbc\" regions=\"64\" threads=\"15\" />\n"
                    ,
                    "Under development"
       );
@@ -7,11 +7,14 @@ namespace argos {
    class CKilobotEntity;
 }
 
-#include <argos3/core/utility/math/rng.h>
+#include <argos3/plugins/robots/kilobot/control_interface/kilobot_rng.h>
+#include <argos3/core/utility/math/vector2.h>
 #include <argos3/core/simulator/medium/medium.h>
-#include <argos3/core/simulator/space/positional_indices/positional_index.h>
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_communication_entity.h>
-#include <unordered_map>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 
 namespace argos {
@@ -20,8 +23,28 @@ namespace argos {
 
    public:
 
-      /** Defines the adjacency matrix */
-      typedef unordered_map<ssize_t, CSet<CKilobotCommunicationEntity*, SEntityComparator> > TAdjacencyMatrix;
+      /** Iterator over the entities that communicate with an entity */
+      typedef CKilobotCommunicationEntity* const* TNeighborIterator;
+
+      /**
+       * The entities that communicate with an entity, sorted by the id of their kilobot.
+       * The view points into the medium, and it is valid until the next
+       * call to Update().
+       */
+      struct SNeighbors {
+         TNeighborIterator Begin;
+         TNeighborIterator End;
+
+         SNeighbors() : Begin(NULL), End(NULL) {}
+
+         inline size_t Size() const {
+            return End - Begin;
+         }
+
+         inline bool Empty() const {
+            return Begin == End;
+         }
+      };
 
    public:
 
@@ -54,20 +77,29 @@ namespace argos {
       void RemoveEntity(CKilobotCommunicationEntity& c_entity);
 
       /**
-       * Returns an immutable vector of entities that can communicate with the given entity.
-       * @param c_entity The wanted entity.
-       * @return An immutable vector of entities that can communicate with the given entity.       
-       * @throws CARGoSException If the passed entity is not managed by this medium.
+       * Queues the specified entity for transmission at the next update.
+       * The entity stays in the queue until its transmission succeeds.
+       * This method can be called by several threads at once, as long as
+       * each entity is queued by one thread only.
+       * @param c_entity The transmitting entity.
        */
-      const CSet<CKilobotCommunicationEntity*,SEntityComparator>& GetKilobotsCommunicatingWith(CKilobotCommunicationEntity& c_entity) const;
+      void AddTransmitter(CKilobotCommunicationEntity& c_entity);
 
       /**
-       * Returns a reference to the adjacency matrix.
-       * @return A reference to the adjacency matrix.
+       * Takes note of the new position of the specified entity.
+       * This method is meant to be called by the entity, at every update.
+       * It can be called by several threads at once, for different entities.
+       * @param c_entity The entity that moved.
        */
-      TAdjacencyMatrix& GetCommMatrix(){
-          return m_tCommMatrix;
-      }
+      void MoveEntity(CKilobotCommunicationEntity& c_entity);
+
+      /**
+       * Returns the entities that can communicate with the given entity.
+       * @param c_entity The wanted entity.
+       * @return A view on the entities that can communicate with the given entity.
+       * @throws CARGoSException If the passed entity is not managed by this medium.
+       */
+      SNeighbors GetKilobotsCommunicatingWith(CKilobotCommunicationEntity& c_entity) const;
 
       /**
        * Sends a message to the given robot, as if it were done by the overhead controller.
@@ -92,30 +124,281 @@ namespace argos {
                             message_t* Message);
 
       /**
-       * Returns the OHC message for the given Kilobot.
-       * @returns the OHC message payload (or NULL if no message is associated to the given robot)
+       * Sends a message to all the robots, as if it were done by the overhead controller.
+       * The medium stores a single copy of the message, shared by all the robots.
+       * Once set, a message stays until explicitly erased.
+       * To erase a message, set it to NULL. The medium does so when it is reset.
+       * @param pt_message The message payload.
+       */
+      void SendOHCMessageToAll(message_t* pt_message);
+
+      /**
+       * Copies the OHC message for the given Kilobot.
+       * @param c_robot The robot.
+       * @param t_message The buffer for the message.
+       * @returns true if a message is associated to the given robot
+       */
+      bool GetOHCMessageFor(CKilobotEntity& c_robot,
+                            message_t& t_message) const;
+
+   private:
+
+      /** A message sent through SendOHCMessageTo(), shared by its recipients */
+      struct SOHCPayload {
+         /** The message */
+         message_t Message;
+         /** The number of robots that have this message */
+         UInt32 References;
+      };
+
+   private:
+
+      /** A band of grid rows, updated independently of the others */
+      struct SRegion {
+         /** The transmitting entities in the region, sorted by id */
+         std::vector<UInt32> Transmitters;
+         /** The messages delivered by the transmitters, as (receiver, transmitter) medium indices */
+         std::vector<std::pair<UInt32, UInt32> > Deliveries;
+      };
+
+      /** The entities that received a message during the last update */
+      struct SRxRange {
+         /** The update the range belongs to; the range is empty if it is not the last one */
+         UInt64 Update;
+         /** The senders are m_vecRxNeighbors[Begin] ... m_vecRxNeighbors[End-1] */
+         UInt32 Begin;
+         UInt32 End;
+
+         SRxRange() : Update(0), Begin(0), End(0) {}
+      };
+
+   private:
+
+      /**
+       * Returns the grid cell of a point.
+       * The points out of the arena are in the border cells.
+       */
+      inline UInt32 GetCell(Real f_x,
+                            Real f_y) const {
+         SInt32 nCol = Floor((f_x - m_cArenaMin.GetX()) / m_fCellSize);
+         SInt32 nRow = Floor((f_y - m_cArenaMin.GetY()) / m_fCellSize);
+         nCol = Min<SInt32>(Max<SInt32>(nCol, 0), m_unGridCols - 1);
+         nRow = Min<SInt32>(Max<SInt32>(nRow, 0), m_unGridRows - 1);
+         return nRow * m_unGridCols + nCol;
+      }
+
+      /**
+       * Sizes the grid for the managed entities and puts each of them in
+       * its cell. This takes a pass over all the entities, so it is done
+       * only when the entities change or a range exceeds the cells.
+       */
+      void BuildGrid();
+
+      /**
+       * Moves the entities that changed cell since the last update.
+       */
+      void UpdateMovedEntities();
+
+      /**
+       * Counts the transmitting neighbors of two transmitting entities.
+       * @param un_i The position of the first entity in m_vecEntities.
+       * @param un_j The position of the second entity in m_vecEntities.
+       */
+      inline void CheckTxPair(UInt32 un_i, UInt32 un_j) {
+         Real fSqDistance = Square(m_vecX[un_i] - m_vecX[un_j]) + Square(m_vecY[un_i] - m_vecY[un_j]);
+         /* i receives j's message */
+         if(fSqDistance < Square(m_vecTxRange[un_j])) ++m_vecTxNeighbors[un_i];
+         /* j receives i's message */
+         if(fSqDistance < Square(m_vecTxRange[un_i])) ++m_vecTxNeighbors[un_j];
+      }
+
+      /**
+       * Updates the medium on the calling thread, as a single region.
+       */
+      void UpdateWhole();
+
+      /**
+       * Returns the number of transmitting entities whose message reaches the given one.
+       * @param un_i The position of the entity in m_vecEntities.
+       */
+      UInt32 CountTxNeighbors(UInt32 un_i) const;
+
+      /**
+       * Resolves the conflicts of a transmitting entity and, if it can
+       * transmit, delivers its message to the entities in range.
+       * @param un_i The position of the transmitting entity in m_vecEntities.
+       * @param un_tx_neighbors The number of transmitting entities that conflict with it.
+       * @param vec_deliveries The list to which the deliveries are appended.
        */
-      message_t* GetOHCMessageFor(CKilobotEntity& c_robot);
+      void Transmit(UInt32 un_i,
+                    UInt32 un_tx_neighbors,
+                    std::vector<std::pair<UInt32, UInt32> >& vec_deliveries);
+
+      /**
+       * Sorts m_vecDeliveries by a key in [0, number of entities), keeping
+       * the order of the deliveries with the same key.
+       * @param t_key Returns the key of a delivery.
+       */
+      template <class KEY>
+      void SortDeliveries(KEY t_key);
+
+      /**
+       * Stores a copy of a message in the OHC payload pool.
+       * @param t_message The message to store.
+       * @param un_references The number of robots that will have the message.
+       * @return The index of the payload in the pool.
+       */
+      SInt32 NewOHCPayload(const message_t& t_message,
+                           UInt32 un_references);
+
+      /**
+       * Sets the OHC message of a robot, releasing its previous message.
+       * The reference to the new payload must be already counted.
+       * @param c_robot The robot.
+       * @param n_payload The index of the payload, or -1.
+       */
+      void SetOHCPayload(CKilobotEntity& c_robot,
+                         SInt32 n_payload);
+
+      /**
+       * Releases a reference to an OHC payload, giving it back to the pool if unused.
+       * @param n_payload The index of the payload, or -1.
+       */
+      void ReleaseOHCPayload(SInt32 n_payload);
+
+      /**
+       * Updates the regions that are not taken yet by other threads.
+       */
+      void UpdateRegions();
+
+      /**
+       * The main function of the worker threads.
+       */
+      void WorkerThread();
 
    private:
 
-      /** The adjacency matrix, that associates each entity with the entities that communicate with it */
-      TAdjacencyMatrix m_tCommMatrix;
+      /** The managed entities, by medium index */
+      std::vector<CKilobotCommunicationEntity*> m_vecEntities;
+
+      /** The medium indices of the managed entities, sorted by the id of their kilobot */
+      std::vector<UInt32> m_vecIdOrder;
+
+      /** Whether entities were added or removed since the last update */
+      bool m_bEntitiesChanged;
+
+      /** The entities queued for transmission by AddTransmitter(), as many as m_vecEntities */
+      std::vector<CKilobotCommunicationEntity*> m_vecTxQueue;
+
+      /** The number of entities in m_vecTxQueue */
+      std::atomic<UInt32> m_unTxQueueSize;
+
+      /** The medium indices of the transmitting entities during Update(), sorted by id */
+      std::vector<UInt32> m_vecTransmitters;
+
+      /*
+       * The senders of the messages delivered during the last update,
+       * grouped by receiver. The senders of the entity of medium index i
+       * are given by m_vecRxRanges[i], if it belongs to the last update.
+       */
+      std::vector<SRxRange> m_vecRxRanges;
+      std::vector<CKilobotCommunicationEntity*> m_vecRxNeighbors;
+
+      /** The number of updates so far, which tells the current ranges apart */
+      UInt64 m_unRxUpdate;
 
-      /** The adjacency matrix of neighbors of a transmitting robot who are also transmitting */
-      TAdjacencyMatrix m_tTxNeighbors;
+      /** The messages delivered during Update(), as (receiver, transmitter) medium indices */
+      std::vector<std::pair<UInt32, UInt32> > m_vecDeliveries;
 
-      /** A positional index for the kilobot communication entities */
-      CPositionalIndex<CKilobotCommunicationEntity>* m_pcKilobotIndex;
+      /** The positions of the managed entities, by medium index, kept by MoveEntity() */
+      std::vector<Real> m_vecX;
+      std::vector<Real> m_vecY;
 
-      /** The update operation for the grid positional index */
-      CKilobotCommunicationEntityGridEntityUpdater* m_pcGridUpdateOperation;
+      /** The transmission ranges, up to date for the transmitters only */
+      std::vector<Real> m_vecTxRange;
+
+      /** Whether each entity transmits, set during Update() only */
+      std::vector<UInt8> m_vecTxAttempt;
+
+      /** The number of transmitting neighbors of each transmitting entity */
+      std::vector<UInt32> m_vecTxNeighbors;
+
+      /** The grid cell of each entity */
+      std::vector<UInt32> m_vecCell;
+
+      /** The position of each entity in the list of its cell */
+      std::vector<UInt32> m_vecCellSlot;
+
+      /** The entities in each grid cell, in no particular order */
+      std::vector<std::vector<UInt32> > m_vecCells;
+
+      /** Whether each entity is in m_vecMovedEntities */
+      std::vector<UInt8> m_vecMoved;
+
+      /** The entities that left their cell since the last update */
+      std::vector<UInt32> m_vecMovedEntities;
+
+      /** Protects m_vecMovedEntities */
+      std::mutex m_cMovedMutex;
+
+      /** Buffers of SortDeliveries() */
+      std::vector<std::pair<UInt32, UInt32> > m_vecSortedDeliveries;
+      std::vector<UInt32> m_vecDeliveryOffsets;
+
+      /** Corner of the arena with the lowest coordinates */
+      CVector2 m_cArenaMin;
+
+      /** Size of the arena */
+      CVector2 m_cArenaSize;
+
+      /** Side of a grid cell, never shorter than the longest transmission range */
+      Real m_fCellSize;
+
+      /** Number of grid cells along X and Y */
+      UInt32 m_unGridCols;
+      UInt32 m_unGridRows;
+
+      /** The rank of each entity when sorted by id, by medium index */
+      std::vector<UInt32> m_vecIdRank;
+
+      /** The regions; empty when the medium is updated as a whole */
+      std::vector<SRegion> m_vecRegions;
+
+      /** The worker threads that update the regions */
+      std::vector<std::thread> m_vecWorkers;
+
+      /** Protects the state of the worker threads */
+      std::mutex m_cWorkersMutex;
+
+      /** Signals the workers that an update started */
+      std::condition_variable m_cUpdateStarted;
+
+      /** Signals the main thread that all the regions are updated */
+      std::condition_variable m_cUpdateDone;
+
+      /** The number of updates started, used to wake up the workers */
+      UInt64 m_unUpdateCount;
+
+      /** The next region to update */
+      std::atomic<UInt32> m_unNextRegion;
+
+      /** The number of regions updated so far */
+      UInt32 m_unRegionsDone;
+
+      /** Whether the worker threads must exit */
+      bool m_bStopWorkers;
+
+      /**
+       * The payloads of the messages set through SendOHCMessageTo(). The
+       * communication entity of each robot holds the index of its payload.
+       */
+      std::vector<SOHCPayload> m_vecOHCPayloads;
 
-      /** A list of messages set through SendOHCMessageTo() */
-      std::unordered_map<ssize_t, message_t*> m_mapOHCMessages;
+      /** The unused payloads in m_vecOHCPayloads */
+      std::vector<SInt32> m_vecOHCFreePayloads;
 
-      /** Random number generator */
-      CRandom::CRNG* m_pcRNG;
+      /** The random number generator of each entity, by medium index */
+      std::vector<CKilobotRNG> m_vecRNGs;
 
       /** Probability of receiving a message */
       Real m_fRxProb;
@@ -10,6 +10,7 @@
 #include <argos3/plugins/simulator/entities/light_entity.h>
 #include <argos3/plugins/simulator/entities/light_sensor_equipped_entity.h>
 
+
 #include "kilobot_measures.h"
 #include "kilobot_light_rotzonly_sensor.h"
 
@@ -79,7 +80,7 @@ namespace argos {
          else if(fNoiseLevel > 0.0f) {
             m_bAddNoise = true;
             m_cNoiseRange.Set(-fNoiseLevel*SENSOR_RANGE.GetMax(), fNoiseLevel*SENSOR_RANGE.GetMax());
-            m_pcRNG = CRandom::CreateRNG("argos");
+            m_pcRNG = new CKilobotRNG(m_pcControllableEntity->GetParent().GetId(), KILOBOT_RNG_LIGHT_SENSOR);
          }
       }
       catch(CARGoSException& ex) {
@@ -168,6 +169,16 @@ namespace argos {
 
    void CKilobotLightRotZOnlySensor::Reset() {
       m_nReading = 0;
+      if(m_pcRNG)
+         m_pcRNG->Reset();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotLightRotZOnlySensor::Destroy() {
+      delete m_pcRNG;
+      m_pcRNG = NULL;
    }
 
    /****************************************/
@@ -18,7 +18,7 @@ namespace argos {
 
 #include <argos3/plugins/robots/kilobot/control_interface/ci_kilobot_light_sensor.h>
 #include <argos3/core/utility/math/range.h>
-#include <argos3/core/utility/math/rng.h>
+#include <argos3/plugins/robots/kilobot/control_interface/kilobot_rng.h>
 #include <argos3/core/simulator/space/space.h>
 #include <argos3/core/simulator/sensor.h>
 
@@ -41,6 +41,8 @@ namespace argos {
 
       virtual void Reset();
 
+      virtual void Destroy();
+
    protected:
 
       /** Reference to embodied entity associated to this sensor */
@@ -55,8 +57,8 @@ namespace argos {
       /** Flag to show rays in the simulator */
       bool m_bShowRays;
 
-      /** Random number generator */
-      CRandom::CRNG* m_pcRNG;
+      /** Random number generator of the noise of this robot */
+      CKilobotRNG* m_pcRNG;
 
       /** Whether to add noise or not */
       bool m_bAddNoise;
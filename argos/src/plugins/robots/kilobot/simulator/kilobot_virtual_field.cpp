@@ -0,0 +1,329 @@
+#include "kilobot_virtual_field.h"
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotVirtualField::CKilobotVirtualField() :
+      m_eType(TYPE_RADIAL),
+      m_fInvLength(1.0),
+      m_unGridCols(0),
+      m_unGridRows(0),
+      m_fInvCellWidth(0.0),
+      m_fInvCellHeight(0.0) {}
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotVirtualField::Init(TConfigurationNode& t_node,
+                                   const CVector2& c_arena_center,
+                                   const CVector2& c_arena_size) {
+      try {
+         std::string strType("radial");
+         GetNodeAttributeOrDefault(t_node, "type", strType, strType);
+         if(strType == "radial") {
+            CVector2 cCenter;
+            Real fRadius;
+            GetNodeAttributeOrDefault(t_node, "center", cCenter, cCenter);
+            GetNodeAttribute(t_node, "radius", fRadius);
+            SetRadial(cCenter, fRadius);
+         }
+         else if(strType == "linear") {
+            CVector2 cOrigin, cDirection;
+            Real fLength;
+            GetNodeAttribute(t_node, "origin", cOrigin);
+            GetNodeAttribute(t_node, "direction", cDirection);
+            GetNodeAttribute(t_node, "length", fLength);
+            SetLinear(cOrigin, cDirection, fLength);
+         }
+         else if(strType == "sources") {
+            std::vector<SSource> vecSources;
+            TConfigurationNodeIterator itSource("source");
+            for(itSource = itSource.begin(&t_node);
+                itSource != itSource.end();
+                ++itSource) {
+               CVector2 cCenter;
+               Real fRadius;
+               GetNodeAttribute(*itSource, "center", cCenter);
+               GetNodeAttribute(*itSource, "radius", fRadius);
+               vecSources.push_back(SSource(cCenter, fRadius));
+            }
+            SetSources(vecSources);
+         }
+         else if(strType == "grid") {
+            std::string strFileName;
+            CVector2 cCenter(c_arena_center);
+            CVector2 cSize(c_arena_size);
+            GetNodeAttribute(t_node, "file", strFileName);
+            GetNodeAttributeOrDefault(t_node, "center", cCenter, cCenter);
+            GetNodeAttributeOrDefault(t_node, "size", cSize, cSize);
+            LoadGrid(strFileName, cCenter, cSize);
+         }
+         else {
+            THROW_ARGOSEXCEPTION("Unknown field type \"" << strType << "\", use \"radial\", \"linear\", \"sources\" or \"grid\"");
+         }
+         /*
+          * The analytic fields can be sampled on a grid that covers the arena.
+          * The sources field is sampled by default, as its value costs a loop
+          * over the sources; resolution="0" keeps it exact.
+          */
+         Real fResolution = (m_eType == TYPE_SOURCES) ? 0.005 : 0.0;
+         GetNodeAttributeOrDefault(t_node, "resolution", fResolution, fResolution);
+         if(fResolution < 0.0) {
+            THROW_ARGOSEXCEPTION("The resolution of the field must be positive, not " << fResolution);
+         }
+         if(fResolution > 0.0 && m_eType != TYPE_GRID) {
+            Sample(fResolution, c_arena_center, c_arena_size);
+         }
+      }
+      catch(CARGoSException& ex) {
+         THROW_ARGOSEXCEPTION_NESTED("Error initializing the virtual field", ex);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotVirtualField::SetRadial(const CVector2& c_center,
+                                        Real f_radius) {
+      if(f_radius <= 0.0) {
+         THROW_ARGOSEXCEPTION("The radius of a radial field must be positive, not " << f_radius);
+      }
+      m_eType = TYPE_RADIAL;
+      m_cCenter = c_center;
+      m_fInvLength = 1.0 / f_radius;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotVirtualField::SetLinear(const CVector2& c_origin,
+                                        const CVector2& c_direction,
+                                        Real f_length) {
+      if(f_length <= 0.0) {
+         THROW_ARGOSEXCEPTION("The length of a linear field must be positive, not " << f_length);
+      }
+      if(c_direction.SquareLength() == 0.0) {
+         THROW_ARGOSEXCEPTION("The direction of a linear field can't be null");
+      }
+      m_eType = TYPE_LINEAR;
+      m_cCenter = c_origin;
+      m_cDirection = c_direction;
+      m_cDirection.Normalize();
+      m_fInvLength = 1.0 / f_length;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotVirtualField::SetSources(const std::vector<SSource>& vec_sources) {
+      if(vec_sources.empty()) {
+         THROW_ARGOSEXCEPTION("A sources field needs at least one <source>");
+      }
+      for(size_t i = 0; i < vec_sources.size(); ++i) {
+         if(vec_sources[i].Radius <= 0.0) {
+            THROW_ARGOSEXCEPTION("The radius of source " << i << " must be positive, not " << vec_sources[i].Radius);
+         }
+      }
+      m_eType = TYPE_SOURCES;
+      m_vecSources = vec_sources;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   Real CKilobotVirtualField::GetSourcesValue(Real f_x,
+                                              Real f_y) const {
+      Real fValue = std::numeric_limits<Real>::max();
+      for(size_t i = 0; i < m_vecSources.size(); ++i) {
+         Real fSourceValue = ::sqrt(Square(f_x - m_vecSources[i].Center.GetX()) +
+                                    Square(f_y - m_vecSources[i].Center.GetY())) / m_vecSources[i].Radius;
+         if(fSourceValue < fValue) fValue = fSourceValue;
+      }
+      return fValue;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotVirtualField::SetGridGeometry(UInt32 un_cols,
+                                              UInt32 un_rows,
+                                              const CVector2& c_center,
+                                              const CVector2& c_size) {
+      if(c_size.GetX() <= 0.0 || c_size.GetY() <= 0.0) {
+         THROW_ARGOSEXCEPTION("The size of a grid field must be positive, not " << c_size);
+      }
+      m_unGridCols = un_cols;
+      m_unGridRows = un_rows;
+      m_cGridMin = c_center - c_size * 0.5;
+      m_fInvCellWidth = un_cols / c_size.GetX();
+      m_fInvCellHeight = un_rows / c_size.GetY();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotVirtualField::Sample(Real f_resolution,
+                                     const CVector2& c_center,
+                                     const CVector2& c_size) {
+      UInt32 unCols = Max<UInt32>(1, Ceil(c_size.GetX() / f_resolution));
+      UInt32 unRows = Max<UInt32>(1, Ceil(c_size.GetY() / f_resolution));
+      Real fCellWidth = c_size.GetX() / unCols;
+      Real fCellHeight = c_size.GetY() / unRows;
+      CVector2 cMin = c_center - c_size * 0.5;
+      /* The field is evaluated before it becomes a grid */
+      std::vector<Real> vecGrid(unCols * unRows);
+      for(UInt32 r = 0; r < unRows; ++r) {
+         Real fY = cMin.GetY() + (unRows - r - 0.5) * fCellHeight;
+         for(UInt32 c = 0; c < unCols; ++c) {
+            vecGrid[r * unCols + c] = GetValue(cMin.GetX() + (c + 0.5) * fCellWidth, fY);
+         }
+      }
+      SetGridGeometry(unCols, unRows, c_center, c_size);
+      m_vecGrid.swap(vecGrid);
+      m_vecSources.clear();
+      m_eType = TYPE_GRID;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotVirtualField::LoadGrid(const std::string& str_file_name,
+                                       const CVector2& c_center,
+                                       const CVector2& c_size) {
+      std::ifstream cStream(str_file_name.c_str(), std::ios::binary);
+      if(!cStream) {
+         THROW_ARGOSEXCEPTION("Can't open the field file \"" << str_file_name << "\"");
+      }
+      /* The images start with the magic number of the PGM format */
+      char pchMagic[2] = { 0, 0 };
+      cStream.read(pchMagic, 2);
+      cStream.clear();
+      cStream.seekg(0);
+      if(pchMagic[0] == 'P' && (pchMagic[1] == '2' || pchMagic[1] == '5')) {
+         LoadPGM(cStream, str_file_name, c_center, c_size);
+      }
+      else {
+         LoadText(cStream, str_file_name, c_center, c_size);
+      }
+      m_vecSources.clear();
+      m_eType = TYPE_GRID;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   /**
+    * Reads a number of the header of a PGM image, skipping the comments.
+    */
+   static UInt32 ReadPGMHeaderValue(std::istream& c_stream,
+                                    const std::string& str_file_name) {
+      c_stream >> std::ws;
+      while(c_stream.peek() == '#') {
+         c_stream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+         c_stream >> std::ws;
+      }
+      UInt32 unValue;
+      if(!(c_stream >> unValue)) {
+         THROW_ARGOSEXCEPTION("Bad header in the PGM image \"" << str_file_name << "\"");
+      }
+      return unValue;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotVirtualField::LoadPGM(std::istream& c_stream,
+                                      const std::string& str_file_name,
+                                      const CVector2& c_center,
+                                      const CVector2& c_size) {
+      char pchMagic[2];
+      c_stream.read(pchMagic, 2);
+      bool bBinary = (pchMagic[1] == '5');
+      UInt32 unCols = ReadPGMHeaderValue(c_stream, str_file_name);
+      UInt32 unRows = ReadPGMHeaderValue(c_stream, str_file_name);
+      UInt32 unMaxValue = ReadPGMHeaderValue(c_stream, str_file_name);
+      if(unCols == 0 || unRows == 0 || unMaxValue == 0 || unMaxValue > 65535) {
+         THROW_ARGOSEXCEPTION("Bad header in the PGM image \"" << str_file_name << "\"");
+      }
+      std::vector<Real> vecGrid(unCols * unRows);
+      Real fScale = 1.0 / unMaxValue;
+      if(bBinary) {
+         /* A single whitespace separates the header from the pixels */
+         c_stream.get();
+         UInt32 unBytes = (unMaxValue < 256) ? 1 : 2;
+         std::vector<unsigned char> vecPixels(vecGrid.size() * unBytes);
+         c_stream.read(reinterpret_cast<char*>(vecPixels.data()), vecPixels.size());
+         if(static_cast<size_t>(c_stream.gcount()) != vecPixels.size()) {
+            THROW_ARGOSEXCEPTION("The PGM image \"" << str_file_name << "\" is truncated");
+         }
+         for(size_t i = 0; i < vecGrid.size(); ++i) {
+            /* The 16-bit pixels are big endian */
+            UInt32 unPixel = (unBytes == 1) ?
+               vecPixels[i] :
+               (static_cast<UInt32>(vecPixels[2 * i]) << 8) | vecPixels[2 * i + 1];
+            vecGrid[i] = unPixel * fScale;
+         }
+      }
+      else {
+         for(size_t i = 0; i < vecGrid.size(); ++i) {
+            UInt32 unPixel;
+            if(!(c_stream >> unPixel)) {
+               THROW_ARGOSEXCEPTION("The PGM image \"" << str_file_name << "\" is truncated");
+            }
+            vecGrid[i] = unPixel * fScale;
+         }
+      }
+      SetGridGeometry(unCols, unRows, c_center, c_size);
+      m_vecGrid.swap(vecGrid);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotVirtualField::LoadText(std::istream& c_stream,
+                                       const std::string& str_file_name,
+                                       const CVector2& c_center,
+                                       const CVector2& c_size) {
+      std::vector<Real> vecGrid;
+      UInt32 unCols = 0;
+      UInt32 unRows = 0;
+      std::string strLine;
+      while(std::getline(c_stream, strLine)) {
+         /* Skip the empty lines and the comments */
+         size_t unStart = strLine.find_first_not_of(" \t\r");
+         if(unStart == std::string::npos || strLine[unStart] == '#') continue;
+         std::istringstream cLine(strLine);
+         UInt32 unLineCols = 0;
+         Real fValue;
+         while(cLine >> fValue) {
+            vecGrid.push_back(fValue);
+            ++unLineCols;
+         }
+         if(!cLine.eof()) {
+            THROW_ARGOSEXCEPTION("Bad value in row " << unRows << " of the field file \"" << str_file_name << "\"");
+         }
+         if(unRows == 0) {
+            unCols = unLineCols;
+         }
+         else if(unLineCols != unCols) {
+            THROW_ARGOSEXCEPTION("Row " << unRows << " of the field file \"" << str_file_name << "\" has " << unLineCols << " values instead of " << unCols);
+         }
+         ++unRows;
+      }
+      if(unRows == 0 || unCols == 0) {
+         THROW_ARGOSEXCEPTION("The field file \"" << str_file_name << "\" has no values");
+      }
+      SetGridGeometry(unCols, unRows, c_center, c_size);
+      m_vecGrid.swap(vecGrid);
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
@@ -0,0 +1,218 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kilobot_virtual_field.h>
+ *
+ * @brief This file provides the scalar fields of the virtual environments of the ALFs.
+ *
+ * A field gives a value to every point of the arena, 0 where the robots
+ * are meant to go and increasing away from it. It is one of:
+ *
+ *    radial   the distance from a center, divided by a radius
+ *    linear   the distance from an origin along a direction, divided by a
+ *             length, and 0 behind the origin
+ *    sources  the smallest of the radial fields of several sources
+ *    grid     sampled on a grid, read from a PGM image (P2 or P5, the
+ *             value is the gray level, 0 for black and 1 for white) or from
+ *             a text file of numbers, one line per row
+ *
+ * The grids cover a rectangle, with their first row at the top (the
+ * largest Y) as in images, and give the value of the nearest cell. Any
+ * field can be sampled on a grid, so that the value of many sources costs
+ * a single lookup.
+ *
+ * The field is configured by an XML node, such as:
+ *
+ *    <gradient_field type="radial" center="0,0" radius="0.5" />
+ *    <gradient_field type="linear" origin="-0.5,0" direction="1,0" length="1" />
+ *    <gradient_field type="sources">
+ *       <source center="-0.25,0" radius="0.3" />
+ *       <source center="0.25,0.25" radius="0.2" />
+ *    </gradient_field>
+ *    <gradient_field type="grid" file="field.pgm" center="0,0" size="1,1" />
+ *
+ * A grid file covers the arena, unless its "center" and "size" are given.
+ * With "resolution", the side of a cell in meters, the other fields are
+ * sampled on a grid that covers the arena. The sources field is sampled
+ * every 5 mm unless told otherwise, since its exact value takes a loop over
+ * all the sources at every query; resolution="0" keeps it exact.
+ */
+
+#ifndef KILOBOT_VIRTUAL_FIELD_H
+#define KILOBOT_VIRTUAL_FIELD_H
+
+namespace argos {
+   class CKilobotVirtualField;
+}
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+#include <argos3/core/utility/configuration/argos_configuration.h>
+#include <argos3/core/utility/math/general.h>
+#include <argos3/core/utility/math/vector2.h>
+#include <cmath>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace argos {
+
+   class CKilobotVirtualField {
+
+   public:
+
+      enum EType {
+         TYPE_RADIAL,
+         TYPE_LINEAR,
+         TYPE_SOURCES,
+         TYPE_GRID
+      };
+
+      /** A source of the radial fields */
+      struct SSource {
+         CVector2 Center;
+         Real Radius;
+
+         SSource(const CVector2& c_center,
+                 Real f_radius) :
+            Center(c_center),
+            Radius(f_radius) {}
+      };
+
+   public:
+
+      /**
+       * Class constructor.
+       * The field is radial, centered in the origin, with a radius of 1.
+       */
+      CKilobotVirtualField();
+
+      /**
+       * Configures the field from an XML node.
+       * @param t_node The node.
+       * @param c_arena_center The center of the arena, where the grids are centered by default.
+       * @param c_arena_size The size of the arena, which the grids cover by default.
+       */
+      void Init(TConfigurationNode& t_node,
+                const CVector2& c_arena_center,
+                const CVector2& c_arena_size);
+
+      void SetRadial(const CVector2& c_center,
+                     Real f_radius);
+
+      void SetLinear(const CVector2& c_origin,
+                     const CVector2& c_direction,
+                     Real f_length);
+
+      void SetSources(const std::vector<SSource>& vec_sources);
+
+      /**
+       * Reads the grid of the field from a file.
+       * @param str_file_name A PGM image or a text file.
+       * @param c_center The center of the rectangle the grid covers.
+       * @param c_size The size of the rectangle the grid covers.
+       */
+      void LoadGrid(const std::string& str_file_name,
+                    const CVector2& c_center,
+                    const CVector2& c_size);
+
+      /**
+       * Replaces the field with its samples at the centers of the cells of a grid.
+       * @param f_resolution The side of the cells.
+       * @param c_center The center of the rectangle the grid covers.
+       * @param c_size The size of the rectangle the grid covers.
+       */
+      void Sample(Real f_resolution,
+                  const CVector2& c_center,
+                  const CVector2& c_size);
+
+      inline EType GetType() const {
+         return m_eType;
+      }
+
+      /**
+       * Returns the value of the field at a point.
+       */
+      inline Real GetValue(Real f_x,
+                           Real f_y) const {
+         switch(m_eType) {
+            case TYPE_RADIAL:
+               return ::sqrt(Square(f_x - m_cCenter.GetX()) + Square(f_y - m_cCenter.GetY())) * m_fInvLength;
+            case TYPE_LINEAR: {
+               Real fValue = ((f_x - m_cCenter.GetX()) * m_cDirection.GetX() +
+                              (f_y - m_cCenter.GetY()) * m_cDirection.GetY()) * m_fInvLength;
+               return (fValue > 0.0) ? fValue : 0.0;
+            }
+            case TYPE_SOURCES:
+               return GetSourcesValue(f_x, f_y);
+            case TYPE_GRID:
+            default:
+               return m_vecGrid[GetCell(f_x, f_y)];
+         }
+      }
+
+      inline Real GetValue(const CVector2& c_position) const {
+         return GetValue(c_position.GetX(), c_position.GetY());
+      }
+
+   private:
+
+      /** Returns the value of the sources field, in O(number of sources): Init() samples it on a grid by default */
+      Real GetSourcesValue(Real f_x,
+                           Real f_y) const;
+
+      /** Returns the index in m_vecGrid of the cell nearest to a point */
+      inline UInt32 GetCell(Real f_x,
+                            Real f_y) const {
+         SInt32 nCol = static_cast<SInt32>(::floor((f_x - m_cGridMin.GetX()) * m_fInvCellWidth));
+         SInt32 nRow = static_cast<SInt32>(m_unGridRows) - 1 -
+            static_cast<SInt32>(::floor((f_y - m_cGridMin.GetY()) * m_fInvCellHeight));
+         nCol = (nCol < 0) ? 0 : ((nCol >= static_cast<SInt32>(m_unGridCols)) ? m_unGridCols - 1 : nCol);
+         nRow = (nRow < 0) ? 0 : ((nRow >= static_cast<SInt32>(m_unGridRows)) ? m_unGridRows - 1 : nRow);
+         return nRow * m_unGridCols + nCol;
+      }
+
+      /** Sets the rectangle covered by a grid of the given number of cells */
+      void SetGridGeometry(UInt32 un_cols,
+                           UInt32 un_rows,
+                           const CVector2& c_center,
+                           const CVector2& c_size);
+
+      /** Reads a PGM image into m_vecGrid */
+      void LoadPGM(std::istream& c_stream,
+                   const std::string& str_file_name,
+                   const CVector2& c_center,
+                   const CVector2& c_size);
+
+      /** Reads a text file of numbers into m_vecGrid */
+      void LoadText(std::istream& c_stream,
+                    const std::string& str_file_name,
+                    const CVector2& c_center,
+                    const CVector2& c_size);
+
+   private:
+
+      EType m_eType;
+
+      /** Center of the radial field, or origin of the linear one */
+      CVector2 m_cCenter;
+
+      /** Unit direction of the linear field */
+      CVector2 m_cDirection;
+
+      /** Inverse of the radius, or of the length */
+      Real m_fInvLength;
+
+      /** Sources of the sources field */
+      std::vector<SSource> m_vecSources;
+
+      /** Values of the grid, row by row from the top */
+      std::vector<Real> m_vecGrid;
+      UInt32 m_unGridCols;
+      UInt32 m_unGridRows;
+      CVector2 m_cGridMin;
+      Real m_fInvCellWidth;
+      Real m_fInvCellHeight;
+
+   };
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include "kilobot_wall_proximity.h"
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <argos3/core/utility/math/general.h>
+#include <cmath>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   const UInt32 CKilobotWallProximity::MAX_SECTORS;
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotRoundedRectangleBoundary::CKilobotRoundedRectangleBoundary() :
+      m_fCornerRadius(0.0) {}
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotRoundedRectangleBoundary::CKilobotRoundedRectangleBoundary(const CVector2& c_center,
+                                                                      const CVector2& c_size,
+                                                                      Real f_corner_radius) {
+      Set(c_center, c_size, f_corner_radius);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotRoundedRectangleBoundary::Set(const CVector2& c_center,
+                                              const CVector2& c_size,
+                                              Real f_corner_radius) {
+      m_cCenter = c_center;
+      m_cHalfSize = c_size * 0.5;
+      m_fCornerRadius = Min(f_corner_radius, Min(m_cHalfSize.GetX(), m_cHalfSize.GetY()));
+   }
+
+   /****************************************/
+   /****************************************/
+
+   Real CKilobotRoundedRectangleBoundary::GetWallDistance(const CVector2& c_position,
+                                                          Real& f_inward_normal) const {
+      /* Work in the first quadrant, and mirror the normal back */
+      Real fX = c_position.GetX() - m_cCenter.GetX();
+      Real fY = c_position.GetY() - m_cCenter.GetY();
+      Real fAbsX = Abs(fX);
+      Real fAbsY = Abs(fY);
+      /* Center of the corner arc */
+      Real fArcX = m_cHalfSize.GetX() - m_fCornerRadius;
+      Real fArcY = m_cHalfSize.GetY() - m_fCornerRadius;
+      if(m_fCornerRadius > 0.0 && fAbsX > fArcX && fAbsY > fArcY) {
+         /* Along a corner: the normal points to the center of the arc */
+         Real fDX = fAbsX - fArcX;
+         Real fDY = fAbsY - fArcY;
+         f_inward_normal = ::atan2(fY < 0.0 ? fDY : -fDY,
+                                   fX < 0.0 ? fDX : -fDX);
+         return m_fCornerRadius - ::sqrt(fDX * fDX + fDY * fDY);
+      }
+      /* Along a side */
+      Real fDistX = m_cHalfSize.GetX() - fAbsX;
+      Real fDistY = m_cHalfSize.GetY() - fAbsY;
+      if(fDistX <= fDistY) {
+         f_inward_normal = (fX > 0.0) ? ARGOS_PI : 0.0;
+         return fDistX;
+      }
+      f_inward_normal = (fY > 0.0) ? -ARGOS_PI * 0.5 : ARGOS_PI * 0.5;
+      return fDistY;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotWallProximity::CKilobotWallProximity(UInt32 un_sectors,
+                                                UInt32 un_bins) :
+      m_unSectors(un_sectors),
+      m_fBinsPerRadian(un_bins / (2.0 * ARGOS_PI)),
+      m_vecMasks(un_bins, 0) {
+      if(un_sectors == 0 || un_sectors > MAX_SECTORS) {
+         THROW_ARGOSEXCEPTION("The wall proximity sensor must have between 1 and " << MAX_SECTORS << " sectors, not " << un_sectors);
+      }
+      if(un_bins == 0) {
+         THROW_ARGOSEXCEPTION("The wall proximity sensor needs at least one table entry");
+      }
+      /* The sectors span the half plane in front of the robot */
+      Real fSector = ARGOS_PI / un_sectors;
+      for(UInt32 unBin = 0; unBin < un_bins; ++unBin) {
+         /* Angle of the inward normal with respect to the robot, at the center of the bin */
+         Real fNormal = (unBin + 0.5) / m_fBinsPerRadian;
+         UInt32 unMask = 0;
+         for(UInt32 i = 0; i < un_sectors; ++i) {
+            /*
+             * The sector is blocked if both its edges point against the
+             * inward normal, that is, towards the wall
+             */
+            Real fStart = ARGOS_PI * 0.5 - i * fSector;
+            Real fEnd = fStart - fSector;
+            unMask <<= 1;
+            if(::cos(fStart - fNormal) < 0.0 && ::cos(fEnd - fNormal) < 0.0) {
+               unMask |= 1;
+            }
+         }
+         m_vecMasks[unBin] = unMask;
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
@@ -0,0 +1,157 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kilobot_wall_proximity.h>
+ *
+ * @brief This file provides the simulated wall proximity sensor of the ALFs.
+ *
+ * The sensor divides the half plane in front of the robot in sectors, and
+ * reports as blocked the sectors that face the nearest wall entirely. The
+ * reading depends only on the angle between the inward normal of the wall
+ * and the orientation of the robot, so it is precomputed in a table.
+ *
+ * The shape of the arena is given by a CKilobotArenaBoundary, which finds
+ * the nearest wall of a point.
+ */
+
+#ifndef KILOBOT_WALL_PROXIMITY_H
+#define KILOBOT_WALL_PROXIMITY_H
+
+namespace argos {
+   class CKilobotArenaBoundary;
+   class CKilobotRoundedRectangleBoundary;
+   class CKilobotWallProximity;
+}
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+#include <argos3/core/utility/math/vector2.h>
+#include <cmath>
+#include <vector>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   class CKilobotArenaBoundary {
+
+   public:
+
+      virtual ~CKilobotArenaBoundary() {}
+
+      /**
+       * Returns the distance of a point from the nearest wall.
+       * @param c_position The point, inside the arena.
+       * @param f_inward_normal Set to the angle of the normal of the nearest
+       * wall that points inside the arena, in radians.
+       */
+      virtual Real GetWallDistance(const CVector2& c_position,
+                                   Real& f_inward_normal) const = 0;
+
+   };
+
+   /****************************************/
+   /****************************************/
+
+   /**
+    * A rectangular arena with rounded corners.
+    * A radius of zero gives a plain rectangle, and a square with a radius of
+    * half its side gives a circle.
+    */
+   class CKilobotRoundedRectangleBoundary : public CKilobotArenaBoundary {
+
+   public:
+
+      CKilobotRoundedRectangleBoundary();
+
+      CKilobotRoundedRectangleBoundary(const CVector2& c_center,
+                                       const CVector2& c_size,
+                                       Real f_corner_radius);
+
+      virtual ~CKilobotRoundedRectangleBoundary() {}
+
+      void Set(const CVector2& c_center,
+               const CVector2& c_size,
+               Real f_corner_radius);
+
+      virtual Real GetWallDistance(const CVector2& c_position,
+                                   Real& f_inward_normal) const;
+
+   private:
+
+      CVector2 m_cCenter;
+      CVector2 m_cHalfSize;
+      Real m_fCornerRadius;
+
+   };
+
+   /****************************************/
+   /****************************************/
+
+   class CKilobotWallProximity {
+
+   public:
+
+      /** Maximum number of sectors */
+      static const UInt32 MAX_SECTORS = 32;
+
+   public:
+
+      /**
+       * Class constructor.
+       * @param un_sectors The number of sectors, at most MAX_SECTORS.
+       * @param un_bins The number of angles in the table.
+       */
+      CKilobotWallProximity(UInt32 un_sectors = 8,
+                            UInt32 un_bins = 1024);
+
+      /**
+       * Returns the sectors that face a wall.
+       * Bit i, counting from the most significant, is set if sector i is
+       * blocked. Sector 0 starts on the left of the robot, and the sectors
+       * go clockwise to its right.
+       * @param f_inward_normal The angle of the inward normal of the wall, in radians.
+       * @param f_orientation The orientation of the robot, in radians.
+       */
+      inline UInt32 GetMask(Real f_inward_normal,
+                            Real f_orientation) const {
+         SInt32 nBin = static_cast<SInt32>(::floor((f_inward_normal - f_orientation) * m_fBinsPerRadian)) %
+            static_cast<SInt32>(m_vecMasks.size());
+         if(nBin < 0) nBin += m_vecMasks.size();
+         return m_vecMasks[nBin];
+      }
+
+      /**
+       * Returns the sectors that face the nearest wall, if it is closer than the given range.
+       * @param c_boundary The shape of the arena.
+       * @param c_position The position of the robot.
+       * @param f_orientation The orientation of the robot, in radians.
+       * @param f_range The range of the sensor.
+       * @return The sectors that face the wall, or 0 if the wall is out of range.
+       * @see GetMask
+       */
+      inline UInt32 GetMask(const CKilobotArenaBoundary& c_boundary,
+                            const CVector2& c_position,
+                            Real f_orientation,
+                            Real f_range) const {
+         Real fInwardNormal;
+         if(c_boundary.GetWallDistance(c_position, fInwardNormal) >= f_range) return 0;
+         return GetMask(fInwardNormal, f_orientation);
+      }
+
+      inline UInt32 GetNumSectors() const {
+         return m_unSectors;
+      }
+
+   private:
+
+      UInt32 m_unSectors;
+      Real m_fBinsPerRadian;
+      std::vector<UInt32> m_vecMasks;
+
+   };
+
+   /****************************************/
+   /****************************************/
+
+}
+
+#endif